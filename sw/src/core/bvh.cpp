@@ -0,0 +1,291 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+static void combine(const vec3d& a_min, const vec3d& a_max, const vec3d& b_min, const vec3d& b_max, vec3d* min, vec3d* max) {
+    *min = {std::min(a_min.x, b_min.x), std::min(a_min.y, b_min.y), std::min(a_min.z, b_min.z), 1.0f};
+    *max = {std::max(a_max.x, b_max.x), std::max(a_max.y, b_max.y), std::max(a_max.z, b_max.z), 1.0f};
+}
+
+static float area(const vec3d& min, const vec3d& max) {
+    float dx = max.x - min.x;
+    float dy = max.y - min.y;
+    float dz = max.z - min.z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static float combined_area(const vec3d& a_min, const vec3d& a_max, const vec3d& b_min, const vec3d& b_max) {
+    vec3d min, max;
+    combine(a_min, a_max, b_min, b_max, &min, &max);
+    return area(min, max);
+}
+
+static bool contains(const vec3d& outer_min, const vec3d& outer_max, const vec3d& min, const vec3d& max) {
+    return outer_min.x <= min.x && outer_min.y <= min.y && outer_min.z <= min.z &&
+           max.x <= outer_max.x && max.y <= outer_max.y && max.z <= outer_max.z;
+}
+
+BVH::BVH(float margin) : m_margin(margin) {
+}
+
+int BVH::allocate_node() {
+    int node;
+    if (m_free_list != NULL_NODE) {
+        node = m_free_list;
+        m_free_list = m_nodes[node].parent;
+    } else {
+        node = (int)m_nodes.size();
+        m_nodes.emplace_back();
+    }
+
+    Node& n = m_nodes[node];
+    n.user_data = nullptr;
+    n.parent = NULL_NODE;
+    n.child1 = NULL_NODE;
+    n.child2 = NULL_NODE;
+    n.height = 0;
+    return node;
+}
+
+void BVH::free_node(int node) {
+    m_nodes[node].parent = m_free_list;
+    m_nodes[node].height = -1;
+    m_free_list = node;
+}
+
+int BVH::insert(const vec3d& min, const vec3d& max, void* user_data) {
+    int proxy = allocate_node();
+    Node& n = m_nodes[proxy];
+    n.min = {min.x - m_margin, min.y - m_margin, min.z - m_margin, 1.0f};
+    n.max = {max.x + m_margin, max.y + m_margin, max.z + m_margin, 1.0f};
+    n.user_data = user_data;
+    insert_leaf(proxy);
+    return proxy;
+}
+
+void BVH::remove(int proxy) {
+    remove_leaf(proxy);
+    free_node(proxy);
+}
+
+bool BVH::move(int proxy, const vec3d& min, const vec3d& max) {
+    Node& n = m_nodes[proxy];
+    if (contains(n.min, n.max, min, max))
+        return false;
+
+    remove_leaf(proxy);
+    n.min = {min.x - m_margin, min.y - m_margin, min.z - m_margin, 1.0f};
+    n.max = {max.x + m_margin, max.y + m_margin, max.z + m_margin, 1.0f};
+    insert_leaf(proxy);
+    return true;
+}
+
+void BVH::refit(int node) {
+    Node& n = m_nodes[node];
+    const Node& c1 = m_nodes[n.child1];
+    const Node& c2 = m_nodes[n.child2];
+    combine(c1.min, c1.max, c2.min, c2.max, &n.min, &n.max);
+    n.height = 1 + std::max(c1.height, c2.height);
+}
+
+void BVH::insert_leaf(int leaf) {
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[m_root].parent = NULL_NODE;
+        return;
+    }
+
+    // find the best sibling by descending the tree along the smallest area increase
+    vec3d leaf_min = m_nodes[leaf].min;
+    vec3d leaf_max = m_nodes[leaf].max;
+    int index = m_root;
+    while (!m_nodes[index].is_leaf()) {
+        const Node& node = m_nodes[index];
+        float a = area(node.min, node.max);
+        float ca = combined_area(node.min, node.max, leaf_min, leaf_max);
+
+        // cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * ca;
+
+        // minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2.0f * (ca - a);
+
+        float cost1 = inheritance_cost;
+        const Node& c1 = m_nodes[node.child1];
+        cost1 += combined_area(c1.min, c1.max, leaf_min, leaf_max) - (c1.is_leaf() ? 0.0f : area(c1.min, c1.max));
+
+        float cost2 = inheritance_cost;
+        const Node& c2 = m_nodes[node.child2];
+        cost2 += combined_area(c2.min, c2.max, leaf_min, leaf_max) - (c2.is_leaf() ? 0.0f : area(c2.min, c2.max));
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = (cost1 < cost2) ? node.child1 : node.child2;
+    }
+
+    int sibling = index;
+
+    // create a new parent
+    int new_parent = allocate_node();
+    int old_parent = m_nodes[sibling].parent;
+    Node& p = m_nodes[new_parent];
+    p.parent = old_parent;
+    combine(leaf_min, leaf_max, m_nodes[sibling].min, m_nodes[sibling].max, &p.min, &p.max);
+    p.height = m_nodes[sibling].height + 1;
+    p.child1 = sibling;
+    p.child2 = leaf;
+    m_nodes[sibling].parent = new_parent;
+    m_nodes[leaf].parent = new_parent;
+
+    if (old_parent != NULL_NODE) {
+        if (m_nodes[old_parent].child1 == sibling)
+            m_nodes[old_parent].child1 = new_parent;
+        else
+            m_nodes[old_parent].child2 = new_parent;
+    } else {
+        m_root = new_parent;
+    }
+
+    // walk back up the tree fixing heights and boxes
+    index = m_nodes[leaf].parent;
+    while (index != NULL_NODE) {
+        index = balance(index);
+        refit(index);
+        index = m_nodes[index].parent;
+    }
+}
+
+void BVH::remove_leaf(int leaf) {
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    int parent = m_nodes[leaf].parent;
+    int grand_parent = m_nodes[parent].parent;
+    int sibling = (m_nodes[parent].child1 == leaf) ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    if (grand_parent != NULL_NODE) {
+        // destroy the parent and connect the sibling to the grand parent
+        if (m_nodes[grand_parent].child1 == parent)
+            m_nodes[grand_parent].child1 = sibling;
+        else
+            m_nodes[grand_parent].child2 = sibling;
+        m_nodes[sibling].parent = grand_parent;
+        free_node(parent);
+
+        int index = grand_parent;
+        while (index != NULL_NODE) {
+            index = balance(index);
+            refit(index);
+            index = m_nodes[index].parent;
+        }
+    } else {
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+        free_node(parent);
+    }
+}
+
+// Perform a left or right rotation if node A is imbalanced, returns the new root index of the subtree
+int BVH::balance(int iA) {
+    Node& A = m_nodes[iA];
+    if (A.is_leaf() || A.height < 2)
+        return iA;
+
+    int iB = A.child1;
+    int iC = A.child2;
+    Node& B = m_nodes[iB];
+    Node& C = m_nodes[iC];
+
+    int balance = C.height - B.height;
+
+    // rotate C up
+    if (balance > 1) {
+        int iF = C.child1;
+        int iG = C.child2;
+        Node& F = m_nodes[iF];
+        Node& G = m_nodes[iG];
+
+        // swap A and C
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        // A's old parent should point to C
+        if (C.parent != NULL_NODE) {
+            if (m_nodes[C.parent].child1 == iA)
+                m_nodes[C.parent].child1 = iC;
+            else
+                m_nodes[C.parent].child2 = iC;
+        } else {
+            m_root = iC;
+        }
+
+        if (F.height > G.height) {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            combine(B.min, B.max, G.min, G.max, &A.min, &A.max);
+            combine(A.min, A.max, F.min, F.max, &C.min, &C.max);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        } else {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            combine(B.min, B.max, F.min, F.max, &A.min, &A.max);
+            combine(A.min, A.max, G.min, G.max, &C.min, &C.max);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+
+        return iC;
+    }
+
+    // rotate B up
+    if (balance < -1) {
+        int iD = B.child1;
+        int iE = B.child2;
+        Node& D = m_nodes[iD];
+        Node& E = m_nodes[iE];
+
+        // swap A and B
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        // A's old parent should point to B
+        if (B.parent != NULL_NODE) {
+            if (m_nodes[B.parent].child1 == iA)
+                m_nodes[B.parent].child1 = iB;
+            else
+                m_nodes[B.parent].child2 = iB;
+        } else {
+            m_root = iB;
+        }
+
+        if (D.height > E.height) {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            combine(C.min, C.max, E.min, E.max, &A.min, &A.max);
+            combine(A.min, A.max, D.min, D.max, &B.min, &B.max);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        } else {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            combine(C.min, C.max, D.min, D.max, &A.min, &A.max);
+            combine(A.min, A.max, E.min, E.max, &B.min, &B.max);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
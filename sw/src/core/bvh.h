@@ -0,0 +1,97 @@
+#pragma once
+
+extern "C" {
+    #include "graphite.h"
+}
+
+#include <vector>
+
+// Dynamic bounding volume hierarchy of axis-aligned boxes.
+// Leaves store enlarged ("fat") boxes so that small moves do not touch the tree,
+// and the tree is kept balanced with rotations on insertion and removal.
+// Ref.: E. Catto, Box2D b2DynamicTree
+
+class BVH {
+
+public:
+    BVH(float margin = 1.0f);
+
+    // returns the proxy identifying the leaf
+    int insert(const vec3d& min, const vec3d& max, void* user_data);
+    void remove(int proxy);
+
+    // returns true if the leaf had to be reinserted
+    bool move(int proxy, const vec3d& min, const vec3d& max);
+
+    // calls callback(user_data, inside) for each leaf intersecting the frustum,
+    // inside is true when the leaf box is entirely within the frustum
+    template <typename F>
+    void query(const frustum_t* frustum, F callback) const;
+
+    int get_height() const { return (m_root == NULL_NODE) ? 0 : m_nodes[m_root].height; }
+
+private:
+    static const int NULL_NODE = -1;
+
+    struct Node {
+        vec3d min, max;
+        void* user_data;
+        int parent;         // next free node when the node is in the free list
+        int child1, child2;
+        int height;         // 0 for leaves, -1 for free nodes
+
+        bool is_leaf() const { return child1 == NULL_NODE; }
+    };
+
+    int allocate_node();
+    void free_node(int node);
+    void insert_leaf(int leaf);
+    void remove_leaf(int leaf);
+    int balance(int node);
+    void refit(int node);
+
+    float m_margin;
+    std::vector<Node> m_nodes;
+    int m_root = NULL_NODE;
+    int m_free_list = NULL_NODE;
+    mutable std::vector<int> m_stack;
+};
+
+template <typename F>
+void BVH::query(const frustum_t* frustum, F callback) const {
+    if (m_root == NULL_NODE)
+        return;
+
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty()) {
+        int index = m_stack.back();
+        m_stack.pop_back();
+        const Node& node = m_nodes[index];
+
+        frustum_test_t test = frustum_test_aabb(frustum, &node.min, &node.max);
+        if (test == FRUSTUM_OUTSIDE)
+            continue;
+
+        if (test == FRUSTUM_INSIDE) {
+            // report the whole subtree without testing it
+            size_t base = m_stack.size();
+            m_stack.push_back(index);
+            while (m_stack.size() > base) {
+                const Node& n = m_nodes[m_stack.back()];
+                m_stack.pop_back();
+                if (n.is_leaf()) {
+                    callback(n.user_data, true);
+                } else {
+                    m_stack.push_back(n.child1);
+                    m_stack.push_back(n.child2);
+                }
+            }
+        } else if (node.is_leaf()) {
+            callback(node.user_data, false);
+        } else {
+            m_stack.push_back(node.child1);
+            m_stack.push_back(node.child2);
+        }
+    }
+}
@@ -37,7 +37,11 @@ void Camera::begin_drawing()
     mat4x4 mat_camera = matrix_point_at(&m_position, &m_target, &m_up);
 
     // make view matrix from camera
-    m_mat_view = matrix_quick_inverse(&mat_camera);    
+    m_mat_view = matrix_quick_inverse(&mat_camera);
+
+    // entities combine it with their world matrix to transform straight to clip space
+    m_mat_view_proj = matrix_multiply_matrix(&m_mat_view, &m_mat_proj);
+    m_frustum = frustum_from_matrix(&m_mat_view_proj);
 }
 
 void Camera::end_drawing()
@@ -31,4 +31,6 @@ public:
     vec3d m_up;
 
     mat4x4 m_mat_view;
+    mat4x4 m_mat_view_proj;     // view then projection, updated by begin_drawing()
+    frustum_t m_frustum;        // world space view frustum, updated by begin_drawing()
 };
\ No newline at end of file
@@ -12,11 +12,19 @@ Entity::Entity(const char* model_path, const char* texture_path)
     m_transform_normal = matrix_make_identity();
 }
 
-void Entity::draw(const vec3d* camera_pos, const mat4x4* camera_mat_proj, const mat4x4* camera_mat_view, const light_t* lights, size_t nb_lights)
+void Entity::update_bounds()
+{
+    aabb_transform(&m_model.mesh.aabb_min, &m_model.mesh.aabb_max, &m_transform, &m_aabb_min, &m_aabb_max);
+    m_sphere_center = matrix_multiply_vector(&m_transform, &m_model.mesh.sphere_center);
+    m_sphere_radius = m_model.mesh.sphere_radius * matrix_max_scale(&m_transform);
+}
+
+void Entity::draw(const mat4x4* camera_mat_view_proj, const light_t* lights, size_t nb_lights)
 {
     if (m_visible) {
         int fb_width, fb_height;
         get_fb_dimensions(&fb_width, &fb_height);
-        draw_model(fb_width, fb_height, camera_pos, &m_model, &m_transform, &m_transform_normal, camera_mat_proj, camera_mat_view, lights, nb_lights, &m_texture, false, false, true);
+        mat4x4 mat_clip = matrix_multiply_matrix(&m_transform, camera_mat_view_proj);
+        draw_model(fb_width, fb_height, &m_model, &m_transform, &m_transform_normal, &mat_clip, lights, nb_lights, &m_texture, false, false, true);
     }
 }
\ No newline at end of file
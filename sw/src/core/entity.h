@@ -8,10 +8,19 @@ class Entity
 {
 public:
     Entity(const char* model_path, const char* texture_path);
-    void draw(const vec3d* camera_pos, const mat4x4* camera_mat_proj, const mat4x4* camera_mat_view, const light_t* lights, size_t nb_lights);
+    void draw(const mat4x4* camera_mat_view_proj, const light_t* lights, size_t nb_lights);
+
+    // update the world space bounding volumes from the model bounds and the current transform
+    void update_bounds();
 
     mat4x4 m_transform, m_transform_normal;
 
+    vec3d m_aabb_min, m_aabb_max;
+    vec3d m_sphere_center;
+    float m_sphere_radius = 0.0f;
+
+    int m_bvh_proxy = -1;       // leaf of the entity in the scene spatial index
+
     bool m_visible = true;
 
 private:
@@ -1,11 +1,33 @@
 #include "glib.h"
 
+#include <assert.h>
 #include <string.h>
 
-#define MAX_NB_TRIANGLES    16      // maximum number of triangles produced by the clipping
+#ifndef GUARD_BAND
+#define GUARD_BAND  64.0f   // pixels around the viewport where triangles are scissored by the rasterizer instead of clipped
+#endif
 
 #define Z_NEAR  0.3     // near clipping plane
 
+#ifndef Z_FAR
+#define Z_FAR   1000.0  // far clipping plane, geometry beyond is dropped
+#endif
+
+// The clipping planes, in the order of the outcode bits
+enum { CLIP_LEFT, CLIP_RIGHT, CLIP_BOTTOM, CLIP_TOP, CLIP_NEAR, CLIP_FAR, NB_CLIP_PLANES };
+
+#define MAX_CLIP_VERTICES   (MAX_CLIPPED_TRIANGLES + 2)
+
+// minimum work given to a slice of the geometry stage, below that the synchronization costs more than it saves
+#define MIN_VERTICES_PER_SLICE  512
+#define MIN_FACES_PER_SLICE     128
+
+typedef struct {
+    vec3d p;
+    vec2d t;
+    vec3d c;
+} clip_vertex_t;
+
 void draw_triangle(vec3d p[3], vec2d t[3], vec3d c[3], const texture_t* texture, bool clamp_s, bool clamp_t, bool depth_test, bool perspective_correct);
 
 vec3d matrix_multiply_vector(const mat4x4* m, const vec3d* i) {
@@ -73,191 +95,71 @@ vec3d vector_clamp(const vec3d* v) {
     return r;
 }
 
-static vec3d vector_intersect_plane(const vec3d* plane_p, const vec3d* plane_n, const vec3d* line_start, const vec3d* line_end, float* t) {
-    float plane_d = -vector_dot_product(plane_n, plane_p);
-    float ad = vector_dot_product(line_start, plane_n);
-    float bd = vector_dot_product(line_end, plane_n);
-    *t = (-plane_d - ad) / (bd - ad);
-    vec3d line_start_to_end = vector_sub(line_end, line_start);
-    vec3d line_to_intersect = vector_mul(&line_start_to_end, *t);
-    return vector_add(line_start, &line_to_intersect);
-}
-
-// return signed shortest distance from point to plane, plane normal must be normalized
-static float dist_point_to_plane(const vec3d* plane_p, const vec3d* plane_n, const vec3d* p) {
-    return (plane_n->x * p->x + plane_n->y * p->y + plane_n->z * p->z -
-            vector_dot_product(plane_n, plane_p));
-}
-
-static int triangle_clip_against_plane(const vec3d* plane_p, const vec3d* plane_n, triangle_t* in_tri, triangle_t* out_tri1,
-                                triangle_t* out_tri2) {
-    // create two temporary storage arrays to classify points either side of the plane
-    // if distance sign is positive, point lies on the inside of plane
-    vec3d* inside_points[3];
-    int nb_inside_points = 0;
-    vec3d* outside_points[3];
-    int nb_outside_points = 0;
-    vec2d* inside_texcoords[3];
-    int nb_inside_texcoords = 0;
-    vec2d* outside_texcoords[3];
-    int nb_outside_texcoords = 0;
-    vec3d* inside_colors[3];
-    int nb_inside_colors = 0;
-    vec3d* outside_colors[3];
-    int nb_outside_colors = 0;
-    vec3d* inside_normals[3];
-    int nb_inside_normals = 0;
-    vec3d* outside_normals[3];
-    int nb_outside_normals = 0;
-
-    // get signed distance of each point in triangle to plane
-    float d0 = dist_point_to_plane(plane_p, plane_n, &in_tri->p[0]);
-    float d1 = dist_point_to_plane(plane_p, plane_n, &in_tri->p[1]);
-    float d2 = dist_point_to_plane(plane_p, plane_n, &in_tri->p[2]);
-
-    if (d0 >= 0.0f) {
-        inside_points[nb_inside_points++] = &in_tri->p[0];
-        inside_texcoords[nb_inside_texcoords++] = &in_tri->t[0];
-        inside_colors[nb_inside_colors++] = &in_tri->c[0];
-        inside_normals[nb_inside_normals++] = &in_tri->n[0];
-    } else {
-        outside_points[nb_outside_points++] = &in_tri->p[0];
-        outside_texcoords[nb_outside_texcoords++] = &in_tri->t[0];
-        outside_colors[nb_outside_colors++] = &in_tri->c[0];
-        outside_normals[nb_outside_normals++] = &in_tri->n[0];
-    }
-    if (d1 >= 0.0f) {
-        inside_points[nb_inside_points++] = &in_tri->p[1];
-        inside_texcoords[nb_inside_texcoords++] = &in_tri->t[1];
-        inside_colors[nb_inside_colors++] = &in_tri->c[1];
-        inside_normals[nb_inside_normals++] = &in_tri->n[1];
-    } else {
-        outside_points[nb_outside_points++] = &in_tri->p[1];
-        outside_texcoords[nb_outside_texcoords++] = &in_tri->t[1];
-        outside_colors[nb_outside_colors++] = &in_tri->c[1];
-        outside_normals[nb_outside_normals++] = &in_tri->n[1];
-    }
-    if (d2 >= 0.0f) {
-        inside_points[nb_inside_points++] = &in_tri->p[2];
-        inside_texcoords[nb_inside_texcoords++] = &in_tri->t[2];
-        inside_colors[nb_inside_colors++] = &in_tri->c[2];
-        inside_normals[nb_inside_normals++] = &in_tri->n[2];
-    } else {
-        outside_points[nb_outside_points++] = &in_tri->p[2];
-        outside_texcoords[nb_outside_texcoords] = &in_tri->t[2];
-        outside_colors[nb_outside_colors++] = &in_tri->c[2];
-        outside_normals[nb_outside_normals++] = &in_tri->n[2];
-    }
-
-    // classify triangle points and break the input triangle into smaller output triangles if required
-
-    if (nb_inside_points == 0) {
-        // all points lie on the outside of the plane, so clip whole triangle
-        return 0;  // no returned triangles are valid
-    }
+// Clip space plane (a, b, c, d), the vertices with a * x + b * y + c * z + d * w >= 0 are inside
+static float clip_distance(const vec3d* plane, const vec3d* p) {
+    return plane->x * p->x + plane->y * p->y + plane->z * p->z + plane->w * p->w;
+}
 
-    if (nb_inside_points == 3) {
-        // all points lie in the inside of plane, so do nothing and allow the triangle to simply pass through
-        *out_tri1 = *in_tri;
+static int clip_outcode(const vec3d* planes, int nb_planes, const vec3d* p) {
+    int outcode = 0;
+    for (int i = 0; i < nb_planes; ++i)
+        if (clip_distance(&planes[i], p) < 0.0f)
+            outcode |= 1 << i;
+    return outcode;
+}
 
-        return 1;  // just the one returned original triangle is valid
-    }
+static clip_vertex_t clip_vertex_lerp(const clip_vertex_t* a, const clip_vertex_t* b, float t) {
+    clip_vertex_t r;
+    r.p.x = a->p.x + (b->p.x - a->p.x) * t;
+    r.p.y = a->p.y + (b->p.y - a->p.y) * t;
+    r.p.z = a->p.z + (b->p.z - a->p.z) * t;
+    r.p.w = a->p.w + (b->p.w - a->p.w) * t;
+    r.t.u = a->t.u + (b->t.u - a->t.u) * t;
+    r.t.v = a->t.v + (b->t.v - a->t.v) * t;
+    r.t.w = a->t.w + (b->t.w - a->t.w) * t;
+    r.c.x = a->c.x + (b->c.x - a->c.x) * t;
+    r.c.y = a->c.y + (b->c.y - a->c.y) * t;
+    r.c.z = a->c.z + (b->c.z - a->c.z) * t;
+    r.c.w = a->c.w + (b->c.w - a->c.w) * t;
+    return r;
+}
 
-    if (nb_inside_points == 1 && nb_outside_points == 2) {
-        // Triangle should be clipped. As two points lie outside the plane, the triangle simply becomes a smaller
-        // triangle.
-
-        // the inside point is valid, so keep that
-        out_tri1->p[0] = *inside_points[0];
-        out_tri1->t[0] = *inside_texcoords[0];
-        out_tri1->c[0] = *inside_colors[0];
-        out_tri1->n[0] = *inside_normals[0];
-
-        // but the two new points are at the location where the original sides of the triangle (lines) intersect with
-        // the plane
-        float t;
-        out_tri1->p[1] = vector_intersect_plane(plane_p, plane_n, inside_points[0], outside_points[0], &t);
-        out_tri1->t[1].u = t * (outside_texcoords[0]->u - inside_texcoords[0]->u) + inside_texcoords[0]->u;
-        out_tri1->t[1].v = t * (outside_texcoords[0]->v - inside_texcoords[0]->v) + inside_texcoords[0]->v;
-        out_tri1->t[1].w = t * (outside_texcoords[0]->w - inside_texcoords[0]->w) + inside_texcoords[0]->w;
-        out_tri1->c[1].x = t * (outside_colors[0]->x - inside_colors[0]->x) + inside_colors[0]->x;
-        out_tri1->c[1].y = t * (outside_colors[0]->y - inside_colors[0]->y) + inside_colors[0]->y;
-        out_tri1->c[1].z = t * (outside_colors[0]->z - inside_colors[0]->z) + inside_colors[0]->z;
-        out_tri1->c[1].w = t * (outside_colors[0]->w - inside_colors[0]->w) + inside_colors[0]->w;
-        out_tri1->n[1].x = t * (outside_normals[0]->x - inside_normals[0]->x) + inside_normals[0]->x;
-        out_tri1->n[1].y = t * (outside_normals[0]->y - inside_normals[0]->y) + inside_normals[0]->y;
-        out_tri1->n[1].z = t * (outside_normals[0]->z - inside_normals[0]->z) + inside_normals[0]->z;
-        out_tri1->n[1].w = t * (outside_normals[0]->w - inside_normals[0]->w) + inside_normals[0]->w;
-
-        out_tri1->p[2] = vector_intersect_plane(plane_p, plane_n, inside_points[0], outside_points[1], &t);
-        out_tri1->t[2].u = t * (outside_texcoords[1]->u - inside_texcoords[0]->u) + inside_texcoords[0]->u;
-        out_tri1->t[2].v = t * (outside_texcoords[1]->v - inside_texcoords[0]->v) + inside_texcoords[0]->v;
-        out_tri1->t[2].w = t * (outside_texcoords[1]->w - inside_texcoords[0]->w) + inside_texcoords[0]->w;
-        out_tri1->c[2].x = t * (outside_colors[1]->x - inside_colors[0]->x) + inside_colors[0]->x;
-        out_tri1->c[2].y = t * (outside_colors[1]->y - inside_colors[0]->y) + inside_colors[0]->y;
-        out_tri1->c[2].z = t * (outside_colors[1]->z - inside_colors[0]->z) + inside_colors[0]->z;
-        out_tri1->c[2].w = t * (outside_colors[1]->w - inside_colors[0]->w) + inside_colors[0]->w;
-        out_tri1->n[2].x = t * (outside_normals[1]->x - inside_normals[0]->x) + inside_normals[0]->x;
-        out_tri1->n[2].y = t * (outside_normals[1]->y - inside_normals[0]->y) + inside_normals[0]->y;
-        out_tri1->n[2].z = t * (outside_normals[1]->z - inside_normals[0]->z) + inside_normals[0]->z;
-        out_tri1->n[2].w = t * (outside_normals[1]->w - inside_normals[0]->w) + inside_normals[0]->w;
-
-        return 1;  // return the newly formed single triangle
-    }
+// Sutherland-Hodgman clipping of a convex polygon against the planes selected by the mask,
+// the vertices are ping-ponged between the two buffers, returns the number of vertices left.
+// The rounding of the intersections can leave a polygon slightly concave so that a later plane crosses it
+// more than twice, such a polygon would overflow the buffers and is dropped
+static int clip_polygon(const vec3d* planes, int mask, clip_vertex_t polygons[2][MAX_CLIP_VERTICES], int* current, int nb_vertices) {
+    for (int i = 0; mask != 0 && nb_vertices > 0; ++i, mask >>= 1) {
+        if (!(mask & 1))
+            continue;
+
+        const clip_vertex_t* in = polygons[*current];
+        clip_vertex_t* out = polygons[1 - *current];
+        int nb_out = 0;
+
+        const clip_vertex_t* a = &in[nb_vertices - 1];
+        float da = clip_distance(&planes[i], &a->p);
+        for (int j = 0; j < nb_vertices; ++j) {
+            const clip_vertex_t* b = &in[j];
+            float db = clip_distance(&planes[i], &b->p);
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                if (nb_out == MAX_CLIP_VERTICES)
+                    return 0;
+                out[nb_out++] = clip_vertex_lerp(a, b, da / (da - db));
+            }
+            if (db >= 0.0f) {
+                if (nb_out == MAX_CLIP_VERTICES)
+                    return 0;
+                out[nb_out++] = *b;
+            }
+            a = b;
+            da = db;
+        }
 
-    if (nb_inside_points == 2 && nb_outside_points == 1) {
-        // Triangle should be clipped. As two points lie inside the plane, the clipped triangle becomes a "quad".
-        // Fortunately, we can represent a quad with two new triangles.
-
-        float t;
-
-        // The first triangle consists of the two inside points and a new point determined by the location where one
-        // side of the triangle intersects with the plane
-        out_tri1->p[0] = *inside_points[0];
-        out_tri1->t[0] = *inside_texcoords[0];
-        out_tri1->c[0] = *inside_colors[0];
-        out_tri1->p[1] = *inside_points[1];
-        out_tri1->t[1] = *inside_texcoords[1];
-        out_tri1->c[1] = *inside_colors[1];
-        out_tri1->p[2] = vector_intersect_plane(plane_p, plane_n, inside_points[0], outside_points[0], &t);
-        out_tri1->t[2].u = t * (outside_texcoords[0]->u - inside_texcoords[0]->u) + inside_texcoords[0]->u;
-        out_tri1->t[2].v = t * (outside_texcoords[0]->v - inside_texcoords[0]->v) + inside_texcoords[0]->v;
-        out_tri1->t[2].w = t * (outside_texcoords[0]->w - inside_texcoords[0]->w) + inside_texcoords[0]->w;
-        out_tri1->c[2].x = t * (outside_colors[0]->x - inside_colors[0]->x) + inside_colors[0]->x;
-        out_tri1->c[2].y = t * (outside_colors[0]->y - inside_colors[0]->y) + inside_colors[0]->y;
-        out_tri1->c[2].z = t * (outside_colors[0]->z - inside_colors[0]->z) + inside_colors[0]->z;
-        out_tri1->c[2].w = t * (outside_colors[0]->w - inside_colors[0]->w) + inside_colors[0]->w;
-        out_tri1->n[2].x = t * (outside_normals[0]->x - inside_normals[0]->x) + inside_normals[0]->x;
-        out_tri1->n[2].y = t * (outside_normals[0]->y - inside_normals[0]->y) + inside_normals[0]->y;
-        out_tri1->n[2].z = t * (outside_normals[0]->z - inside_normals[0]->z) + inside_normals[0]->z;
-        out_tri1->n[2].w = t * (outside_normals[0]->w - inside_normals[0]->w) + inside_normals[0]->w;
-
-        // The second triangle is composed of one the the inside points, a new point determined by the intersection
-        // of the other side of the triangle and the plane, and the newly created point above
-        out_tri2->p[0] = *inside_points[1];
-        out_tri2->t[0] = *inside_texcoords[1];
-        out_tri2->c[0] = *inside_colors[1];
-        out_tri2->p[1] = vector_intersect_plane(plane_p, plane_n, inside_points[1], outside_points[0], &t);
-        out_tri2->t[1].u = t * (outside_texcoords[0]->u - inside_texcoords[1]->u) + inside_texcoords[1]->u;
-        out_tri2->t[1].v = t * (outside_texcoords[0]->v - inside_texcoords[1]->v) + inside_texcoords[1]->v;
-        out_tri2->t[1].w = t * (outside_texcoords[0]->w - inside_texcoords[1]->w) + inside_texcoords[1]->w;
-        out_tri2->c[1].x = t * (outside_colors[0]->x - inside_colors[1]->x) + inside_colors[1]->x;
-        out_tri2->c[1].y = t * (outside_colors[0]->y - inside_colors[1]->y) + inside_colors[1]->y;
-        out_tri2->c[1].z = t * (outside_colors[0]->z - inside_colors[1]->z) + inside_colors[1]->z;
-        out_tri2->c[1].w = t * (outside_colors[0]->w - inside_colors[1]->w) + inside_colors[1]->w;
-        out_tri2->n[1].x = t * (outside_normals[0]->x - inside_normals[1]->x) + inside_normals[1]->x;
-        out_tri2->n[1].y = t * (outside_normals[0]->y - inside_normals[1]->y) + inside_normals[1]->y;
-        out_tri2->n[1].z = t * (outside_normals[0]->z - inside_normals[1]->z) + inside_normals[1]->z;
-        out_tri2->n[1].w = t * (outside_normals[0]->w - inside_normals[1]->w) + inside_normals[1]->w;
-        out_tri2->p[2] = out_tri1->p[2];
-        out_tri2->t[2] = out_tri1->t[2];
-        out_tri2->c[2] = out_tri1->c[2];
-        out_tri2->n[2] = out_tri1->n[2];
-
-        return 2;  // return two newly formed triangles which form a quad
+        *current = 1 - *current;
+        nb_vertices = nb_out;
     }
-
-    return 0;  // should not happen
+    return nb_vertices;
 }
 
 mat4x4 matrix_make_identity(void) {
@@ -275,7 +177,7 @@ mat4x4 matrix_make_projection(int viewport_width, int viewport_height, float fov
 
     // projection matrix
     float near = Z_NEAR;
-    float far = 1000.0f;
+    float far = Z_FAR;
     float aspect_ratio = (float)viewport_height / (float)viewport_width;
     float fov_rad = 1.0f / tanf(fov * 0.5f / 180.0f * 3.14159f);
 
@@ -362,7 +264,7 @@ mat4x4 matrix_make_scale(float x, float y, float z) {
     return mat;
 }
 
-mat4x4 matrix_multiply_matrix(mat4x4* m1, mat4x4* m2) {
+mat4x4 matrix_multiply_matrix(const mat4x4* m1, const mat4x4* m2) {
     mat4x4 mat;
     for (int c = 0; c < 4; ++c)
         for (int r = 0; r < 4; ++r)
@@ -427,6 +329,140 @@ mat4x4 matrix_quick_inverse(mat4x4* m) {
     return mat;
 }
 
+void mesh_compute_face_planes(mesh_t* mesh) {
+    for (size_t i = 0; i < mesh->nb_faces; ++i) {
+        const face_t* face = &mesh->faces[i];
+        const vec3d* v0 = &mesh->vertices[face->indices[0]];
+        const vec3d* v1 = &mesh->vertices[face->indices[1]];
+        const vec3d* v2 = &mesh->vertices[face->indices[2]];
+        vec3d line1 = vector_sub(v1, v0);
+        vec3d line2 = vector_sub(v2, v0);
+        vec3d n = vector_cross_product(&line1, &line2);
+        n.w = -vector_dot_product(&n, v0);
+        mesh->face_planes[i] = n;
+    }
+}
+
+void mesh_compute_bounds(mesh_t* mesh) {
+    if (mesh->nb_vertices == 0) {
+        mesh->aabb_min = mesh->aabb_max = mesh->sphere_center = (vec3d){0.0f, 0.0f, 0.0f, 1.0f};
+        mesh->sphere_radius = 0.0f;
+        return;
+    }
+
+    vec3d min = mesh->vertices[0];
+    vec3d max = mesh->vertices[0];
+    for (size_t i = 1; i < mesh->nb_vertices; ++i) {
+        const vec3d* v = &mesh->vertices[i];
+        min.x = fminf(min.x, v->x);
+        min.y = fminf(min.y, v->y);
+        min.z = fminf(min.z, v->z);
+        max.x = fmaxf(max.x, v->x);
+        max.y = fmaxf(max.y, v->y);
+        max.z = fmaxf(max.z, v->z);
+    }
+    mesh->aabb_min = min;
+    mesh->aabb_max = max;
+
+    // sphere centered on the box, enclosing all the vertices
+    vec3d center = vector_add(&min, &max);
+    center = vector_mul(&center, 0.5f);
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < mesh->nb_vertices; ++i) {
+        vec3d d = vector_sub(&mesh->vertices[i], &center);
+        radius2 = fmaxf(radius2, vector_dot_product(&d, &d));
+    }
+    mesh->sphere_center = center;
+    mesh->sphere_radius = sqrtf(radius2);
+}
+
+// Ref.: J. Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems, 1990
+void aabb_transform(const vec3d* min, const vec3d* max, const mat4x4* m, vec3d* out_min, vec3d* out_max) {
+    float in_min[3] = {min->x, min->y, min->z};
+    float in_max[3] = {max->x, max->y, max->z};
+    float r_min[3], r_max[3];
+
+    for (int j = 0; j < 3; ++j) {
+        r_min[j] = r_max[j] = m->m[3][j];
+        for (int i = 0; i < 3; ++i) {
+            float a = m->m[i][j] * in_min[i];
+            float b = m->m[i][j] * in_max[i];
+            r_min[j] += fminf(a, b);
+            r_max[j] += fmaxf(a, b);
+        }
+    }
+
+    *out_min = (vec3d){r_min[0], r_min[1], r_min[2], 1.0f};
+    *out_max = (vec3d){r_max[0], r_max[1], r_max[2], 1.0f};
+}
+
+// largest scaling factor applied by the matrix along an axis, to scale a bounding sphere radius
+float matrix_max_scale(const mat4x4* m) {
+    float s = 0.0f;
+    for (int i = 0; i < 3; ++i)
+        s = fmaxf(s, m->m[i][0] * m->m[i][0] + m->m[i][1] * m->m[i][1] + m->m[i][2] * m->m[i][2]);
+    return sqrtf(s);
+}
+
+// Ref.: G. Gribb, K. Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+frustum_t frustum_from_matrix(const mat4x4* m) {
+    frustum_t frustum;
+
+    // column j of the matrix gives the j clip coordinate
+    vec3d c[4];
+    for (int j = 0; j < 4; ++j)
+        c[j] = (vec3d){m->m[0][j], m->m[1][j], m->m[2][j], m->m[3][j]};
+
+    // -w <= x <= w, -w <= y <= w, 0 <= z <= w
+    frustum.planes[0] = (vec3d){c[3].x + c[0].x, c[3].y + c[0].y, c[3].z + c[0].z, c[3].w + c[0].w};
+    frustum.planes[1] = (vec3d){c[3].x - c[0].x, c[3].y - c[0].y, c[3].z - c[0].z, c[3].w - c[0].w};
+    frustum.planes[2] = (vec3d){c[3].x + c[1].x, c[3].y + c[1].y, c[3].z + c[1].z, c[3].w + c[1].w};
+    frustum.planes[3] = (vec3d){c[3].x - c[1].x, c[3].y - c[1].y, c[3].z - c[1].z, c[3].w - c[1].w};
+    frustum.planes[4] = c[2];
+    frustum.planes[5] = (vec3d){c[3].x - c[2].x, c[3].y - c[2].y, c[3].z - c[2].z, c[3].w - c[2].w};
+
+    for (int i = 0; i < 6; ++i) {
+        float l = vector_length(&frustum.planes[i]);
+        if (l > 0.0f) {
+            frustum.planes[i].x /= l;
+            frustum.planes[i].y /= l;
+            frustum.planes[i].z /= l;
+            frustum.planes[i].w /= l;
+        }
+    }
+
+    return frustum;
+}
+
+frustum_test_t frustum_test_sphere(const frustum_t* frustum, const vec3d* center, float radius) {
+    frustum_test_t result = FRUSTUM_INSIDE;
+    for (int i = 0; i < 6; ++i) {
+        float d = vector_dot_product(&frustum->planes[i], center) + frustum->planes[i].w;
+        if (d < -radius)
+            return FRUSTUM_OUTSIDE;
+        if (d < radius)
+            result = FRUSTUM_INTERSECT;
+    }
+    return result;
+}
+
+frustum_test_t frustum_test_aabb(const frustum_t* frustum, const vec3d* min, const vec3d* max) {
+    frustum_test_t result = FRUSTUM_INSIDE;
+    for (int i = 0; i < 6; ++i) {
+        const vec3d* p = &frustum->planes[i];
+
+        // corners the farthest along and against the plane normal
+        vec3d pos = {p->x >= 0.0f ? max->x : min->x, p->y >= 0.0f ? max->y : min->y, p->z >= 0.0f ? max->z : min->z, 1.0f};
+        vec3d neg = {p->x >= 0.0f ? min->x : max->x, p->y >= 0.0f ? min->y : max->y, p->z >= 0.0f ? min->z : max->z, 1.0f};
+
+        if (vector_dot_product(p, &pos) + p->w < 0.0f)
+            return FRUSTUM_OUTSIDE;
+        if (vector_dot_product(p, &neg) + p->w < 0.0f)
+            result = FRUSTUM_INTERSECT;
+    }
+    return result;
+}
+
 quaternion quaternion_make_identity(void) {
     quaternion quat = { 0.0f, 0.0f, 0.0f, 1.0f };
     return quat;
@@ -545,331 +581,380 @@ vec3d vector_rotate_by_quaternion(const vec3d* v, const quaternion* q) {
     return vec;
 }
 
+static float det3(float a0, float a1, float a2, float b0, float b1, float b2, float c0, float c1, float c2) {
+    return a0 * (b1 * c2 - b2 * c1) - a1 * (b0 * c2 - b2 * c0) + a2 * (b0 * c1 - b1 * c0);
+}
+
+// Homogeneous model space position of the camera, the point sent to x = y = w = 0 by the clip matrix.
+// Its coordinates are the signed minors of the (x, y, w) columns of the matrix, so that the determinant of the
+// (x, y, w) clip coordinates of a face is -(n . camera.xyz + d * camera.w) for the face plane (n, d).
+static vec3d camera_position(const mat4x4* m) {
+    vec3d c;
+    c.x = -det3(m->m[1][0], m->m[1][1], m->m[1][3], m->m[2][0], m->m[2][1], m->m[2][3], m->m[3][0], m->m[3][1], m->m[3][3]);
+    c.y = det3(m->m[0][0], m->m[0][1], m->m[0][3], m->m[2][0], m->m[2][1], m->m[2][3], m->m[3][0], m->m[3][1], m->m[3][3]);
+    c.z = -det3(m->m[0][0], m->m[0][1], m->m[0][3], m->m[1][0], m->m[1][1], m->m[1][3], m->m[3][0], m->m[3][1], m->m[3][3]);
+    c.w = det3(m->m[0][0], m->m[0][1], m->m[0][3], m->m[1][0], m->m[1][1], m->m[1][3], m->m[2][0], m->m[2][1], m->m[2][3]);
+    return c;
+}
+
+// Ambient color plus the diffuse color of each directional light for the normal n, clamped
+static vec3d light_color(const light_t* lights, size_t nb_lights, const vec3d* ambient_color, const vec3d* n) {
+    vec3d color = *ambient_color;
+    for (size_t light_index = 0; light_index < nb_lights; ++light_index) {
+        // how "aligned" are light direction and surface normal?
+        float dp = -vector_dot_product(&lights[light_index].direction, n);
+        if (dp < 0.0f) dp = 0.0f;
+
+        const vec3d* diffuse_color = &lights[light_index].diffuse_color;
+        color.x += diffuse_color->x * dp;
+        color.y += diffuse_color->y * dp;
+        color.z += diffuse_color->z * dp;
+    }
+    return vector_clamp(&color);
+}
+
 static float clamp(float x) {
     if (x < 0.0f) return 0.0f;
     if (x > 1.0f) return 1.0f;
     return x;
 }
 
-void draw_model(int viewport_width, int viewport_height, const vec3d* vec_camera, const model_t* model, const mat4x4* mat_world,
-    const mat4x4* mat_normal, const mat4x4* mat_projection, const mat4x4* mat_view, const light_t* lights, size_t nb_lights, const texture_t* texture,
-    bool clamp_s, bool clamp_t, bool perspective_correct) {
-    size_t triangle_to_raster_index = 0;
-
-    // draw faces
-    for (size_t i = 0; i < model->mesh.nb_faces; ++i) {
-        face_t* face = &model->mesh.faces[i];
-        triangle_t tri;
-        tri.p[0] = model->mesh.vertices[face->indices[0]];
-        tri.p[1] = model->mesh.vertices[face->indices[1]];
-        tri.p[2] = model->mesh.vertices[face->indices[2]];
-        if (model->mesh.nb_texcoords > 0) {
-            tri.t[0] = model->mesh.texcoords[face->tex_indices[0]];
-            tri.t[1] = model->mesh.texcoords[face->tex_indices[1]];
-            tri.t[2] = model->mesh.texcoords[face->tex_indices[2]];
-        } else {
-            tri.t[0] = (vec2d){0.0f, 0.0f};
-            tri.t[1] = (vec2d){0.0f, 0.0f};
-            tri.t[2] = (vec2d){0.0f, 0.0f};
+typedef struct {
+    const model_t* model;
+    const mat4x4* mat_clip;
+    const light_t* lights;
+    size_t nb_lights;
+    bool gouraud_shading;
+    bool perspective_correct;
+    vec3d ambient_color;
+    vec3d cofactors[3];
+    vec3d cull_planes[NB_CLIP_PLANES];
+    vec3d clip_planes[NB_CLIP_PLANES];
+    float half_width, half_height;
+    size_t nb_front_faces;
+    size_t nb_triangles[MAX_NB_SLICES];     // triangles stored by each slice of the front faces
+} geometry_context_t;
+
+// Parallel execution of the geometry stage, see set_parallel_run()
+static parallel_run_fn_t g_parallel_run;
+static int g_nb_slices = 1;
+
+void set_parallel_run(parallel_run_fn_t run, int nb_slices) {
+    g_parallel_run = run;
+    g_nb_slices = (nb_slices < 1) ? 1 : (nb_slices > MAX_NB_SLICES) ? MAX_NB_SLICES : nb_slices;
+}
+
+static size_t slice_begin(size_t count, int slice, int nb_slices) {
+    return count * (size_t)slice / (size_t)nb_slices;
+}
+
+// Split count items into slices of at least min_count items, run the task on them and return the number of slices
+static int run_slices(parallel_task_fn_t task, void* context, size_t count, size_t min_count) {
+    size_t nb_slices = count / min_count;
+    if (nb_slices > (size_t)g_nb_slices)
+        nb_slices = (size_t)g_nb_slices;
+    if (nb_slices <= 1 || g_parallel_run == NULL) {
+        task(context, 0, 1);
+        return 1;
+    }
+    g_parallel_run(task, context, (int)nb_slices);
+    return (int)nb_slices;
+}
+
+// Transform the used vertices of a slice once, straight to clip space, a run of consecutive vertices at a time,
+// faces index into the transformed vertices
+static void transform_vertices(void* context, int slice, int nb_slices) {
+    const geometry_context_t* ctx = (const geometry_context_t*)context;
+    const model_t* model = ctx->model;
+    const mesh_t* mesh = &model->mesh;
+    size_t begin = slice_begin(mesh->nb_vertices, slice, nb_slices);
+    size_t end = slice_begin(mesh->nb_vertices, slice + 1, nb_slices);
+
+    for (size_t start = begin; start < end;) {
+        if (!model->used_vertices[start]) {
+            start++;
+            continue;
         }
-        if (model->mesh.nb_colors > 0) {
-            tri.c[0] = model->mesh.colors[face->col_indices[0]];
-            tri.c[1] = model->mesh.colors[face->col_indices[1]];
-            tri.c[2] = model->mesh.colors[face->col_indices[2]];
+        size_t run_end = start + 1;
+        while (run_end < end && model->used_vertices[run_end])
+            run_end++;
+        matrix_multiply_vectors(ctx->mat_clip, &mesh->vertices[start], &model->clip_vertices[start], run_end - start);
+        start = run_end;
+    }
+}
+
+// Light, clip and project the front faces of a slice. The triangles are stored in the slice's own part of
+// triangles_to_raster, so that their order does not depend on the number of slices.
+static void process_faces(void* context, int slice, int nb_slices) {
+    geometry_context_t* ctx = (geometry_context_t*)context;
+    const model_t* model = ctx->model;
+    const mesh_t* mesh = &model->mesh;
+    const light_t* lights = ctx->lights;
+    size_t nb_lights = ctx->nb_lights;
+    bool gouraud_shading = ctx->gouraud_shading;
+    size_t begin = slice_begin(ctx->nb_front_faces, slice, nb_slices);
+    size_t end = slice_begin(ctx->nb_front_faces, slice + 1, nb_slices);
+    size_t triangle_index = begin * MAX_CLIPPED_TRIANGLES;
+
+    for (size_t i = begin; i < end; ++i) {
+        size_t face_index = model->front_faces[i];
+        face_t* face = &mesh->faces[face_index];
+        triangle_t tri_clip;
+
+        tri_clip.p[0] = model->clip_vertices[face->indices[0]];
+        tri_clip.p[1] = model->clip_vertices[face->indices[1]];
+        tri_clip.p[2] = model->clip_vertices[face->indices[2]];
+
+        if (mesh->nb_texcoords > 0) {
+            tri_clip.t[0] = mesh->texcoords[face->tex_indices[0]];
+            tri_clip.t[1] = mesh->texcoords[face->tex_indices[1]];
+            tri_clip.t[2] = mesh->texcoords[face->tex_indices[2]];
         } else {
-            tri.c[0] = (vec3d){1.0f, 1.0f, 1.0f, 1.0f};
-            tri.c[1] = (vec3d){1.0f, 1.0f, 1.0f, 1.0f};
-            tri.c[2] = (vec3d){1.0f, 1.0f, 1.0f, 1.0f};
+            tri_clip.t[0] = (vec2d){0.0f, 0.0f};
+            tri_clip.t[1] = (vec2d){0.0f, 0.0f};
+            tri_clip.t[2] = (vec2d){0.0f, 0.0f};
         }
-        if (model->mesh.nb_normals > 0) {
-            tri.n[0] = model->mesh.normals[face->norm_indices[0]];
-            tri.n[1] = model->mesh.normals[face->norm_indices[1]];
-            tri.n[2] = model->mesh.normals[face->norm_indices[2]];
+        if (mesh->nb_colors > 0) {
+            tri_clip.c[0] = mesh->colors[face->col_indices[0]];
+            tri_clip.c[1] = mesh->colors[face->col_indices[1]];
+            tri_clip.c[2] = mesh->colors[face->col_indices[2]];
         } else {
-            tri.n[0] = (vec3d){0.0f, 0.0f, 0.0f, 0.0f};
-            tri.n[1] = (vec3d){0.0f, 0.0f, 0.0f, 0.0f};
-            tri.n[2] = (vec3d){0.0f, 0.0f, 0.0f, 0.0f};
+            tri_clip.c[0] = (vec3d){1.0f, 1.0f, 1.0f, 1.0f};
+            tri_clip.c[1] = (vec3d){1.0f, 1.0f, 1.0f, 1.0f};
+            tri_clip.c[2] = (vec3d){1.0f, 1.0f, 1.0f, 1.0f};
         }
 
-        triangle_t tri_viewed, tri_projected, tri_transformed;
-
-        tri_transformed.p[0] = matrix_multiply_vector(mat_world, &tri.p[0]);
-        tri_transformed.p[1] = matrix_multiply_vector(mat_world, &tri.p[1]);
-        tri_transformed.p[2] = matrix_multiply_vector(mat_world, &tri.p[2]);
-        tri_transformed.t[0] = tri.t[0];
-        tri_transformed.t[1] = tri.t[1];
-        tri_transformed.t[2] = tri.t[2];
-        tri_transformed.c[0] = tri.c[0];
-        tri_transformed.c[1] = tri.c[1];
-        tri_transformed.c[2] = tri.c[2];
-        if (mat_normal != NULL) {
-            tri_transformed.n[0] = matrix_multiply_vector(mat_normal, &tri.n[0]);
-            tri_transformed.n[1] = matrix_multiply_vector(mat_normal, &tri.n[1]);
-            tri_transformed.n[2] = matrix_multiply_vector(mat_normal, &tri.n[2]);
+        // illumination
+        if (nb_lights > 0) {
+            const vec3d* color[3];
+            vec3d face_color;
+            if (gouraud_shading) {
+                color[0] = &model->normal_colors[face->norm_indices[0]];
+                color[1] = &model->normal_colors[face->norm_indices[1]];
+                color[2] = &model->normal_colors[face->norm_indices[2]];
+            } else {
+                const vec3d* n = &mesh->face_planes[face_index];
+                vec3d normal = {
+                    n->x * ctx->cofactors[0].x + n->y * ctx->cofactors[1].x + n->z * ctx->cofactors[2].x,
+                    n->x * ctx->cofactors[0].y + n->y * ctx->cofactors[1].y + n->z * ctx->cofactors[2].y,
+                    n->x * ctx->cofactors[0].z + n->y * ctx->cofactors[1].z + n->z * ctx->cofactors[2].z, 0.0f};
+                normal = vector_normalize(&normal);
+                face_color = light_color(lights, nb_lights, &ctx->ambient_color, &normal);
+                color[0] = color[1] = color[2] = &face_color;
+            }
+
+            for (int j = 0; j < 3; ++j) {
+                tri_clip.c[j].x = tri_clip.c[j].x * color[j]->x;
+                tri_clip.c[j].y = tri_clip.c[j].y * color[j]->y;
+                tri_clip.c[j].z = tri_clip.c[j].z * color[j]->z;
+            }
         }
 
-        // calculate the normal
-        vec3d normal, line1, line2;
-        line1.x = tri_transformed.p[1].x - tri_transformed.p[0].x;
-        line1.y = tri_transformed.p[1].y - tri_transformed.p[0].y;
-        line1.z = tri_transformed.p[1].z - tri_transformed.p[0].z;
-
-        line2.x = tri_transformed.p[2].x - tri_transformed.p[0].x;
-        line2.y = tri_transformed.p[2].y - tri_transformed.p[0].y;
-        line2.z = tri_transformed.p[2].z - tri_transformed.p[0].z;
-
-        // take the cross product of lines to get normal to triangle surface
-        normal = vector_cross_product(&line1, &line2);
-
-        // get ray from triangle to camera
-        vec3d vec_camera_ray = vector_sub(&tri_transformed.p[0], vec_camera);
-
-        // if ray is aligned with normal, then triangle is visible
-        if (vector_dot_product(&normal, &vec_camera_ray) < 0.0f) {
-    
-            // illumination
-            vec3d color[3] = {
-                {0.0f, 0.0f, 0.0f, 1.0f},
-                {0.0f, 0.0f, 0.0f, 1.0f},
-                {0.0f, 0.0f, 0.0f, 1.0f}
-            };
-
-            for (size_t light_index = 0; light_index < nb_lights; ++light_index) {
-                vec3d light_direction = lights[light_index].direction;
-                float diffuse_intensity[3];
-
-                if ((model->mesh.nb_normals > 0) && (mat_normal != NULL)) {
-
-                    //
-                    // Gouraud shading
-                    //
-
-                    for (int j = 0; j < 3; ++j) {
-                        vec3d n = tri_transformed.n[j];
-                        float dp = -vector_dot_product(&light_direction, &n);
-                        if (dp < 0.0f) dp = 0.0f;
-                        diffuse_intensity[j] = dp;
-                    }
-
-                } else {
-
-                    //
-                    // Flat shading
-                    //
-
-                    // how "aligned" are light direction and triangle surface normal?
-                    vec3d n = normal;
-                    n = vector_normalize(&n);
-                    float dp = -vector_dot_product(&light_direction, &n);
-
-                    if (dp < 0.0f) dp = 0.0f;
-
-                    // note: alpha is currently forced to 1 here
-                    diffuse_intensity[0] = dp;
-                    diffuse_intensity[1] = dp;
-                    diffuse_intensity[2] = dp;
-                }
+        // trivially reject the triangles outside of the viewport or beyond the near and far planes
+        int cull_outcodes[3];
+        int clip_outcodes[3];
+        for (int j = 0; j < 3; ++j) {
+            cull_outcodes[j] = clip_outcode(ctx->cull_planes, NB_CLIP_PLANES, &tri_clip.p[j]);
+            clip_outcodes[j] = clip_outcode(ctx->clip_planes, NB_CLIP_PLANES, &tri_clip.p[j]);
+        }
+        if (cull_outcodes[0] & cull_outcodes[1] & cull_outcodes[2])
+            continue;
+
+        clip_vertex_t polygons[2][MAX_CLIP_VERTICES];
+        int current = 0;
+        int nb_vertices = 3;
+        for (int j = 0; j < 3; ++j) {
+            polygons[current][j].p = tri_clip.p[j];
+            polygons[current][j].t = tri_clip.t[j];
+            polygons[current][j].c = tri_clip.c[j];
+        }
 
-                // apply light color
-                vec3d ambient_color = lights[light_index].ambient_color;
-                for (int j = 0; j < 3; ++j) {
-                    vec3d diffuse_color = lights[light_index].diffuse_color;
-                    diffuse_color = vector_mul(&diffuse_color, diffuse_intensity[j]);
-                    color[j] = vector_add(&color[j], &ambient_color);
-                    color[j] = vector_add(&color[j], &diffuse_color);
-                }
-            } // for each light
-
-            if (nb_lights > 0) {
-                for (int j = 0; j < 3; ++j) {
-                    color[j] = vector_clamp(&color[j]);
-                    tri_transformed.c[j].x = tri_transformed.c[j].x * color[j].x;
-                    tri_transformed.c[j].y = tri_transformed.c[j].y * color[j].y;
-                    tri_transformed.c[j].z = tri_transformed.c[j].z * color[j].z;
-                }
+        // clip against the planes crossed by the triangle, the guard band is used instead of the viewport edges
+        // since the rasterizers scissor to the viewport
+        int clip_mask = clip_outcodes[0] | clip_outcodes[1] | clip_outcodes[2];
+        if (clip_mask)
+            nb_vertices = clip_polygon(ctx->clip_planes, clip_mask, polygons, &current, nb_vertices);
+
+        // project the polygon from 3D to 2D
+        clip_vertex_t* polygon = polygons[current];
+        for (int j = 0; j < nb_vertices; ++j) {
+            clip_vertex_t* v = &polygon[j];
+            float recip_w = 1.0f / v->p.w;
+
+            if (ctx->perspective_correct) {
+                v->t.u = v->t.u * recip_w;
+                v->t.v = v->t.v * recip_w;
+                v->c.x = v->c.x * recip_w;
+                v->c.y = v->c.y * recip_w;
+                v->c.z = v->c.z * recip_w;
+                v->c.w = v->c.w * recip_w;
             }
+            v->t.w = recip_w;
 
-            // convert world space to view space
-            tri_viewed.p[0] = matrix_multiply_vector(mat_view, &tri_transformed.p[0]);
-            tri_viewed.p[1] = matrix_multiply_vector(mat_view, &tri_transformed.p[1]);
-            tri_viewed.p[2] = matrix_multiply_vector(mat_view, &tri_transformed.p[2]);
-            tri_viewed.t[0] = tri_transformed.t[0];
-            tri_viewed.t[1] = tri_transformed.t[1];
-            tri_viewed.t[2] = tri_transformed.t[2];
-            tri_viewed.c[0] = tri_transformed.c[0];
-            tri_viewed.c[1] = tri_transformed.c[1];
-            tri_viewed.c[2] = tri_transformed.c[2];
-
-            // clip viewed triangle against near plane, this could form two additional triangles
-            int nb_clipped_triangles = 0;
-            triangle_t clipped[2];
-            vec3d plane_p = {0.0f, 0.0f, Z_NEAR, 1.0f};
-            vec3d plane_n = {0.0f, 0.0f, 1.0f, 1.0f};
-            nb_clipped_triangles = triangle_clip_against_plane(&plane_p, &plane_n, &tri_viewed, &clipped[0], &clipped[1]);
-
-            for (int n = 0; n < nb_clipped_triangles; ++n) {
-                // project triangles from 3D to 2D
-                tri_projected.p[0] = matrix_multiply_vector(mat_projection, &clipped[n].p[0]);
-                tri_projected.p[1] = matrix_multiply_vector(mat_projection, &clipped[n].p[1]);
-                tri_projected.p[2] = matrix_multiply_vector(mat_projection, &clipped[n].p[2]);
-                tri_projected.t[0] = clipped[n].t[0];
-                tri_projected.t[1] = clipped[n].t[1];
-                tri_projected.t[2] = clipped[n].t[2];
-                tri_projected.c[0] = clipped[n].c[0];
-                tri_projected.c[1] = clipped[n].c[1];
-                tri_projected.c[2] = clipped[n].c[2];
-
-                float recip_w[3] = {
-                    1.0f / tri_projected.p[0].w,
-                    1.0f / tri_projected.p[1].w,
-                    1.0f / tri_projected.p[2].w
-                };
-
-                if (perspective_correct) {
-                    tri_projected.t[0].u = tri_projected.t[0].u * recip_w[0];
-                    tri_projected.t[1].u = tri_projected.t[1].u * recip_w[1];
-                    tri_projected.t[2].u = tri_projected.t[2].u * recip_w[2];
-
-                    tri_projected.t[0].v = tri_projected.t[0].v * recip_w[0];
-                    tri_projected.t[1].v = tri_projected.t[1].v * recip_w[1];
-                    tri_projected.t[2].v = tri_projected.t[2].v * recip_w[2];
-
-                    tri_projected.c[0].x = tri_projected.c[0].x * recip_w[0];
-                    tri_projected.c[1].x = tri_projected.c[1].x * recip_w[1];
-                    tri_projected.c[2].x = tri_projected.c[2].x * recip_w[2];
-
-                    tri_projected.c[0].y = tri_projected.c[0].y * recip_w[0];
-                    tri_projected.c[1].y = tri_projected.c[1].y * recip_w[1];
-                    tri_projected.c[2].y = tri_projected.c[2].y * recip_w[2];
-
-                    tri_projected.c[0].z = tri_projected.c[0].z * recip_w[0];
-                    tri_projected.c[1].z = tri_projected.c[1].z * recip_w[1];
-                    tri_projected.c[2].z = tri_projected.c[2].z * recip_w[2];
-
-                    tri_projected.c[0].w = tri_projected.c[0].w * recip_w[0];
-                    tri_projected.c[1].w = tri_projected.c[1].w * recip_w[1];
-                    tri_projected.c[2].w = tri_projected.c[2].w * recip_w[2];
-                }
+            // scale into view, inverting y to account for flipped screen y coordinate
+            v->p.x = (v->p.x * recip_w + 1.0f) * ctx->half_width;
+            v->p.y = (-v->p.y * recip_w + 1.0f) * ctx->half_height;
+            v->p.z = v->p.z * recip_w;
+            v->p.w = 1.0f;
+        }
 
-                tri_projected.t[0].w = recip_w[0];
-                tri_projected.t[1].w = recip_w[1];
-                tri_projected.t[2].w = recip_w[2];
-
-                // scale into view
-                tri_projected.p[0] = vector_mul(&tri_projected.p[0], recip_w[0]);
-                tri_projected.p[1] = vector_mul(&tri_projected.p[1], recip_w[1]);
-                tri_projected.p[2] = vector_mul(&tri_projected.p[2], recip_w[2]);
-
-                // Invert the y values to account for flipped screen y coordinate
-                tri_projected.p[0].y = -tri_projected.p[0].y;
-                tri_projected.p[1].y = -tri_projected.p[1].y;
-                tri_projected.p[2].y = -tri_projected.p[2].y;
-
-                // offset vertices into visible normalized space
-                vec3d vec_offset_view = {1.0f, 1.0f, 0.0f, 1.0f};
-                tri_projected.p[0] = vector_add(&tri_projected.p[0], &vec_offset_view);
-                tri_projected.p[1] = vector_add(&tri_projected.p[1], &vec_offset_view);
-                tri_projected.p[2] = vector_add(&tri_projected.p[2], &vec_offset_view);
-
-                float w = (float)viewport_width / 2.0f;
-                float h = (float)viewport_height / 2.0f;
-                tri_projected.p[0].x = tri_projected.p[0].x * w;
-                tri_projected.p[0].y = tri_projected.p[0].y * h;
-                tri_projected.p[1].x = tri_projected.p[1].x * w;
-                tri_projected.p[1].y = tri_projected.p[1].y * h;
-                tri_projected.p[2].x = tri_projected.p[2].x * w;
-                tri_projected.p[2].y = tri_projected.p[2].y * h;
-
-                // store triangle for sorting
-                model->triangles_to_raster[triangle_to_raster_index] = tri_projected;
-                triangle_to_raster_index++;
+        // fan the polygon into triangles and store them for sorting
+        assert(nb_vertices - 2 <= MAX_CLIPPED_TRIANGLES);
+        for (int j = 1; j < nb_vertices - 1; ++j) {
+            const clip_vertex_t* v0 = &polygon[0];
+            const clip_vertex_t* v1 = &polygon[j];
+            const clip_vertex_t* v2 = &polygon[j + 1];
+
+            // make the screen space orientation of the triangle the one expected by the rasterizers
+            float normal_z = (v1->p.x - v0->p.x) * (v2->p.y - v0->p.y) - (v1->p.y - v0->p.y) * (v2->p.x - v0->p.x);
+            if (normal_z > 0.0f) {
+                const clip_vertex_t* v = v0;
+                v0 = v1;
+                v1 = v;
             }
+
+            triangle_t* tri_projected = &model->triangles_to_raster[triangle_index];
+            tri_projected->p[0] = v0->p;
+            tri_projected->t[0] = v0->t;
+            tri_projected->c[0] = v0->c;
+            tri_projected->p[1] = v1->p;
+            tri_projected->t[1] = v1->t;
+            tri_projected->c[1] = v1->c;
+            tri_projected->p[2] = v2->p;
+            tri_projected->t[2] = v2->t;
+            tri_projected->c[2] = v2->c;
+            triangle_index++;
         }
     }
 
-    for (size_t i = 0; i < triangle_to_raster_index; ++i) {
-        triangle_t tri_to_raster = model->triangles_to_raster[triangle_to_raster_index - i - 1];
-
-        // clip triangles against all four screen edges, this could yield a bunch of triangles
-        triangle_t clipped[2];
-        triangle_t triangles[MAX_NB_TRIANGLES];
-        int nb_triangles = 0;
-        triangles[nb_triangles++] = tri_to_raster;
-
-        int nb_new_triangles = 1;
-
-        for (int p = 0; p < 4; ++p) {
-            int nb_tris_to_add = 0;
-            while (nb_new_triangles > 0) {
-                // pop front
-                triangle_t test = triangles[0];
-                for (int j = 1; j < nb_triangles; ++j) triangles[j - 1] = triangles[j];
-                nb_triangles--;
-
-                nb_new_triangles--;
-
-                switch (p) {
-                    case 0: {
-                        vec3d p = {0.0f, 0.0f, 0.0f, 1.0f};
-                        vec3d n = {0.0f, 1.0f, 0.0f, 1.0f};
-                        nb_tris_to_add = triangle_clip_against_plane(&p, &n, &test, &clipped[0], &clipped[1]);
-                        break;
-                    }
-                    case 1: {
-                        vec3d p = {0.0f, (float)(viewport_height - 1), 0.0f, 1.0f};
-                        vec3d n = {0.0f, -1.0f, 0.0f, 1.0f};
-                        nb_tris_to_add = triangle_clip_against_plane(&p, &n, &test, &clipped[0], &clipped[1]);
-                        break;
-                    }
-                    case 2: {
-                        vec3d p = {0.0f, 0.0f, 0.0f, 1.0f};
-                        vec3d n = {1.0f, 0.0f, 0.0f, 1.0f};
-                        nb_tris_to_add = triangle_clip_against_plane(&p, &n, &test, &clipped[0], &clipped[1]);
-                        break;
-                    }
-                    case 3: {
-                        vec3d p = {(float)(viewport_width - 1), 0.0f, 0.0f, 1.0f};
-                        vec3d n = {-1.0f, 0.0f, 0.0f, 1.0f};
-                        nb_tris_to_add = triangle_clip_against_plane(&p, &n, &test, &clipped[0], &clipped[1]);
-                        break;
-                    }
-                }
+    ctx->nb_triangles[slice] = triangle_index - begin * MAX_CLIPPED_TRIANGLES;
+}
 
-                // push back
-                if (nb_triangles + nb_tris_to_add > MAX_NB_TRIANGLES) break;    // safety net
-                for (int w = 0; w < nb_tris_to_add; ++w) triangles[nb_triangles++] = clipped[w];
-            }
-            nb_new_triangles = nb_triangles;
+void draw_model(int viewport_width, int viewport_height, const model_t* model, const mat4x4* mat_world, const mat4x4* mat_normal,
+    const mat4x4* mat_clip, const light_t* lights, size_t nb_lights, const texture_t* texture,
+    bool clamp_s, bool clamp_t, bool perspective_correct) {
+    const mesh_t* mesh = &model->mesh;
+    bool gouraud_shading = (mesh->nb_normals > 0) && (mat_normal != NULL);
+    geometry_context_t ctx;
+    ctx.model = model;
+    ctx.mat_clip = mat_clip;
+    ctx.lights = lights;
+    ctx.gouraud_shading = gouraud_shading;
+    ctx.perspective_correct = perspective_correct;
+    ctx.half_width = (float)viewport_width / 2.0f;
+    ctx.half_height = (float)viewport_height / 2.0f;
+
+    // Clip space planes of the viewport, the near and far planes, then the same with the side planes moved out to
+    // the guard band. Screen x = (x / w + 1) * width / 2 and screen y = (1 - y / w) * height / 2.
+    float vx = 1.0f - 2.0f / (float)viewport_width;
+    float vy = 1.0f - 2.0f / (float)viewport_height;
+    float gx = 2.0f * GUARD_BAND / (float)viewport_width;
+    float gy = 2.0f * GUARD_BAND / (float)viewport_height;
+    const vec3d cull_planes[NB_CLIP_PLANES] = {
+        {1.0f, 0.0f, 0.0f, 1.0f},       // left: screen x >= 0
+        {-1.0f, 0.0f, 0.0f, vx},        // right: screen x <= width - 1
+        {0.0f, 1.0f, 0.0f, vy},         // bottom: screen y <= height - 1
+        {0.0f, -1.0f, 0.0f, 1.0f},      // top: screen y >= 0
+        {0.0f, 0.0f, 1.0f, 0.0f},       // near: z >= 0
+        {0.0f, 0.0f, -1.0f, 1.0f}       // far: z <= w
+    };
+    const vec3d clip_planes[NB_CLIP_PLANES] = {
+        {1.0f, 0.0f, 0.0f, 1.0f + gx},
+        {-1.0f, 0.0f, 0.0f, vx + gx},
+        {0.0f, 1.0f, 0.0f, vy + gy},
+        {0.0f, -1.0f, 0.0f, 1.0f + gy},
+        {0.0f, 0.0f, 1.0f, 0.0f},
+        {0.0f, 0.0f, -1.0f, 1.0f}
+    };
+    memcpy(ctx.cull_planes, cull_planes, sizeof(cull_planes));
+    memcpy(ctx.clip_planes, clip_planes, sizeof(clip_planes));
+
+    // reject the back faces in model space, before any vertex transform, and mark the vertices of the front faces
+    vec3d camera = camera_position(mat_clip);
+    size_t nb_front_faces = 0;
+    memset(model->used_vertices, 0, mesh->nb_vertices * sizeof(bool));
+    for (size_t i = 0; i < mesh->nb_faces; ++i) {
+        const vec3d* plane = &mesh->face_planes[i];
+        if (plane->x * camera.x + plane->y * camera.y + plane->z * camera.z + plane->w * camera.w <= 0.0f)
+            continue;
+        const face_t* face = &mesh->faces[i];
+        model->used_vertices[face->indices[0]] = true;
+        model->used_vertices[face->indices[1]] = true;
+        model->used_vertices[face->indices[2]] = true;
+        model->front_faces[nb_front_faces++] = i;
+    }
+
+    // transform the used vertices
+    ctx.nb_front_faces = nb_front_faces;
+    run_slices(transform_vertices, &ctx, mesh->nb_vertices, MIN_VERTICES_PER_SLICE);
+
+    // the ambient colors do not depend on the normal
+    if (nb_lights > MAX_NB_LIGHTS)
+        nb_lights = MAX_NB_LIGHTS;
+    vec3d ambient_color = {0.0f, 0.0f, 0.0f, 1.0f};
+    for (size_t light_index = 0; light_index < nb_lights; ++light_index)
+        ambient_color = vector_add(&ambient_color, &lights[light_index].ambient_color);
+    ctx.nb_lights = nb_lights;
+    ctx.ambient_color = ambient_color;
+
+    //
+    // Gouraud shading
+    //
+
+    // The lights are directional, so the color only depends on the normal and is evaluated once per normal used by
+    // a front face. The light directions are transformed into model space instead of the normals, with the transpose
+    // of the normal matrix since dot(d, n * N) = dot(d * transpose(N), n).
+    if (gouraud_shading && nb_lights > 0) {
+        light_t model_lights[MAX_NB_LIGHTS];
+        for (size_t light_index = 0; light_index < nb_lights; ++light_index) {
+            const vec3d* d = &lights[light_index].direction;
+            model_lights[light_index] = lights[light_index];
+            model_lights[light_index].direction = (vec3d){
+                d->x * mat_normal->m[0][0] + d->y * mat_normal->m[0][1] + d->z * mat_normal->m[0][2],
+                d->x * mat_normal->m[1][0] + d->y * mat_normal->m[1][1] + d->z * mat_normal->m[1][2],
+                d->x * mat_normal->m[2][0] + d->y * mat_normal->m[2][1] + d->z * mat_normal->m[2][2], 0.0f};
         }
 
-        for (int i = 0; i < nb_triangles; ++i) {
-            triangle_t* t = &triangles[i];
-
-            // calculate the normal
-            vec3d normal, line1, line2;
-            line1.x = t->p[1].x - t->p[0].x;
-            line1.y = t->p[1].y - t->p[0].y;
-            line1.z = t->p[1].z - t->p[0].z;
-
-            line2.x = t->p[2].x - t->p[0].x;
-            line2.y = t->p[2].y - t->p[0].y;
-            line2.z = t->p[2].z - t->p[0].z;
-
-            // take the cross product of lines to get normal to triangle surface
-            normal = vector_cross_product(&line1, &line2);
-
-            if (normal.z > 0.0f) {
-                vec3d tp = t->p[0];
-                vec2d tt = t->t[0];
-                vec3d tc = t->c[0];
-                t->p[0] = t->p[1];
-                t->t[0] = t->t[1];
-                t->c[0] = t->c[1];
-                t->p[1] = tp;
-                t->t[1] = tt;
-                t->c[1] = tc;
+        memset(model->used_normals, 0, mesh->nb_normals * sizeof(bool));
+        for (size_t i = 0; i < nb_front_faces; ++i) {
+            const face_t* face = &mesh->faces[model->front_faces[i]];
+            for (int j = 0; j < 3; ++j) {
+                int norm_index = face->norm_indices[j];
+                if (!model->used_normals[norm_index]) {
+                    model->used_normals[norm_index] = true;
+                    model->normal_colors[norm_index] =
+                        light_color(model_lights, nb_lights, &ambient_color, &mesh->normals[norm_index]);
+                }
             }
+        }
+    }
+
+    //
+    // Flat shading
+    //
+
+    // The world space normal of a face is its model space normal multiplied by the cofactor matrix of the world
+    // transform, whose rows are the cross products of the rows of the transform.
+    if (!gouraud_shading && nb_lights > 0) {
+        const vec3d rows[3] = {
+            {mat_world->m[0][0], mat_world->m[0][1], mat_world->m[0][2], 0.0f},
+            {mat_world->m[1][0], mat_world->m[1][1], mat_world->m[1][2], 0.0f},
+            {mat_world->m[2][0], mat_world->m[2][1], mat_world->m[2][2], 0.0f}
+        };
+        ctx.cofactors[0] = vector_cross_product(&rows[1], &rows[2]);
+        ctx.cofactors[1] = vector_cross_product(&rows[2], &rows[0]);
+        ctx.cofactors[2] = vector_cross_product(&rows[0], &rows[1]);
+    }
+
+    // light, clip and project the front faces
+    int nb_slices = run_slices(process_faces, &ctx, nb_front_faces, MIN_FACES_PER_SLICE);
+
+    // draw the stored triangles in reverse order
+    for (int slice = nb_slices - 1; slice >= 0; --slice) {
+        triangle_t* triangles = &model->triangles_to_raster[slice_begin(nb_front_faces, slice, nb_slices) * MAX_CLIPPED_TRIANGLES];
+        for (size_t i = ctx.nb_triangles[slice]; i > 0; --i) {
+            triangle_t* t = &triangles[i - 1];
             draw_triangle(t->p, t->t, t->c, texture, clamp_s, clamp_t, true, perspective_correct);
         }
     }
-}
\ No newline at end of file
+}
@@ -49,18 +49,37 @@ typedef struct {
     vec3d* colors;
     vec3d* normals;
     face_t* faces;
+
+    // model space plane of each face, (x, y, z) is the normal and w the distance, see mesh_compute_face_planes()
+    vec3d* face_planes;
+
+    // bounding volumes in model space, see mesh_compute_bounds()
+    vec3d aabb_min, aabb_max;
+    vec3d sphere_center;
+    float sphere_radius;
 } mesh_t;
 
+// Maximum number of triangles to raster per face, a triangle clipped by the six frustum planes
+// is a polygon of at most nine vertices
+#define MAX_CLIPPED_TRIANGLES   7
+
 typedef struct {
     mesh_t mesh;
 
     // Internal buffers
     triangle_t* triangles_to_raster;
+    vec3d* clip_vertices;           // clip space, one per mesh vertex
+    vec3d* normal_colors;           // lighting color, one per mesh normal
+    bool* used_normals;             // one per mesh normal, set when used by a front face
+    bool* used_vertices;            // one per mesh vertex, set when used by a front face
+    size_t* front_faces;            // indices of the faces facing the camera
 } model_t;
 
 typedef struct {
     size_t scale_x, scale_y;
     uint16_t* addr;
+    size_t nb_levels;       // of the mip chain following the base level at addr
+    bool swizzled;          // texels in 4x4 tiles instead of rows
 } texture_t;
 
 typedef struct {
@@ -69,7 +88,63 @@ typedef struct {
     vec3d diffuse_color;
 } light_t;
 
+#define MAX_NB_LIGHTS   8   // lights taken into account by draw_model()
+
+// Parallel execution of the geometry stage of draw_model(). The run function must call task(context, slice, nb_slices)
+// once for each slice, possibly concurrently, and return when all of them are done.
+#define MAX_NB_SLICES   32
+typedef void (*parallel_task_fn_t)(void* context, int slice, int nb_slices);
+typedef void (*parallel_run_fn_t)(parallel_task_fn_t task, void* context, int nb_slices);
+
+typedef struct {
+    // left, right, bottom, top, near and far planes
+    // (x, y, z) is the normalized normal pointing inside the frustum and w the distance
+    vec3d planes[6];
+} frustum_t;
+
+typedef enum {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECT,
+    FRUSTUM_INSIDE
+} frustum_test_t;
+
+// Batch transform kernels built for the target (see transform.c).
+// Define GLIB_SCALAR_TRANSFORM to build the portable kernel only.
+#if !defined(GLIB_SCALAR_TRANSFORM)
+#if defined(__GNUC__) && (defined(__SSE__) || defined(__ARM_NEON) || defined(__riscv_vector))
+#define GLIB_HAS_VECTOR_EXT
+#endif
+#if defined(__SSE__)
+#define GLIB_HAS_SSE
+#endif
+#if defined(__AVX__)
+#define GLIB_HAS_AVX
+#endif
+#endif
+
+typedef void (*transform_fn_t)(const mat4x4* m, const vec3d* in, vec3d* out, size_t count);
+
+typedef struct {
+    const char* name;
+    transform_fn_t fn;
+} transform_kernel_t;
+
 vec3d matrix_multiply_vector(const mat4x4* m, const vec3d* i);
+
+// out[i] = in[i] * m for count vectors, in and out may be the same buffer
+void matrix_multiply_vectors(const mat4x4* m, const vec3d* in, vec3d* out, size_t count);
+void matrix_multiply_vectors_scalar(const mat4x4* m, const vec3d* in, vec3d* out, size_t count);
+#if defined(GLIB_HAS_VECTOR_EXT)
+void matrix_multiply_vectors_vector_ext(const mat4x4* m, const vec3d* in, vec3d* out, size_t count);
+#endif
+#if defined(GLIB_HAS_SSE)
+void matrix_multiply_vectors_sse(const mat4x4* m, const vec3d* in, vec3d* out, size_t count);
+#endif
+#if defined(GLIB_HAS_AVX)
+void matrix_multiply_vectors_avx(const mat4x4* m, const vec3d* in, vec3d* out, size_t count);
+#endif
+const transform_kernel_t* matrix_get_transform_kernels(size_t* nb_kernels);
+
 vec3d vector_add(const vec3d* v1, const vec3d* v2);
 vec3d vector_sub(const vec3d* v1, const vec3d* v2);
 vec3d vector_mul(const vec3d* v1, float k);
@@ -87,10 +162,19 @@ mat4x4 matrix_make_rotation_y(float theta);
 mat4x4 matrix_make_rotation_z(float theta);
 mat4x4 matrix_make_translation(float x, float y, float z);
 mat4x4 matrix_make_scale(float x, float y, float z);
-mat4x4 matrix_multiply_matrix(mat4x4* m1, mat4x4* m2);
+mat4x4 matrix_multiply_matrix(const mat4x4* m1, const mat4x4* m2);
 mat4x4 matrix_point_at(vec3d* pos, vec3d* target, vec3d* up);
 mat4x4 matrix_quick_inverse(mat4x4* m);
 
+void mesh_compute_face_planes(mesh_t* mesh);
+void mesh_compute_bounds(mesh_t* mesh);
+void aabb_transform(const vec3d* min, const vec3d* max, const mat4x4* m, vec3d* out_min, vec3d* out_max);
+float matrix_max_scale(const mat4x4* m);
+
+frustum_t frustum_from_matrix(const mat4x4* m);
+frustum_test_t frustum_test_sphere(const frustum_t* frustum, const vec3d* center, float radius);
+frustum_test_t frustum_test_aabb(const frustum_t* frustum, const vec3d* min, const vec3d* max);
+
 quaternion quaternion_make_identity(void);
 quaternion quaternion_from_euler(float pitch, float yaw, float roll);
 mat4x4 quaternion_to_matrix(const quaternion* q);
@@ -98,8 +182,12 @@ quaternion quaternion_multiply(const quaternion* q1, const quaternion* q2);
 quaternion quaternion_from_axis_angle(vec3d axis, float angle);
 vec3d vector_rotate_by_quaternion(const vec3d* v, const quaternion* q);
 
-void draw_model(int viewport_width, int viewport_height, const vec3d* vec_camera, const model_t* model, const mat4x4* mat_world,
-                const mat4x4* mat_normal, const mat4x4* mat_projection, const mat4x4* mat_view, const light_t* lights, size_t nb_lights, const texture_t* texture,
+// run is NULL to process the geometry on the calling thread only
+void set_parallel_run(parallel_run_fn_t run, int nb_slices);
+
+// mat_clip is the combined world, view and projection matrix of the model
+void draw_model(int viewport_width, int viewport_height, const model_t* model, const mat4x4* mat_world, const mat4x4* mat_normal,
+                const mat4x4* mat_clip, const light_t* lights, size_t nb_lights, const texture_t* texture,
                 bool clamp_s, bool clamp_t, bool perspective_correct);
 
 #endif
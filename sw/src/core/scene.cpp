@@ -1,10 +1,35 @@
 #include "scene.h"
 
 void Scene::add_entity(std::shared_ptr<Entity> entity) {
+    entity->update_bounds();
+    entity->m_bvh_proxy = m_bvh.insert(entity->m_aabb_min, entity->m_aabb_max, entity.get());
     m_entities.emplace_back(entity);
 }
 
+void Scene::update_entity(Entity* entity) {
+    entity->update_bounds();
+    m_bvh.move(entity->m_bvh_proxy, entity->m_aabb_min, entity->m_aabb_max);
+}
+
 void Scene::draw(const Camera* camera, const light_t* lights, size_t nb_lights) {
-    for (auto entity : m_entities)
-        entity->draw(&camera->m_position, &camera->m_mat_proj, &camera->m_mat_view, lights, nb_lights);
+    size_t nb_in_frustum = 0;
+
+    // reject the entities outside the view frustum before any per-face work
+    m_bvh.query(&camera->m_frustum, [&](void* user_data, bool inside) {
+        Entity* entity = static_cast<Entity*>(user_data);
+        if (!inside) {
+            // the index stores enlarged boxes, test the entity bounds
+            frustum_test_t test = frustum_test_sphere(&camera->m_frustum, &entity->m_sphere_center, entity->m_sphere_radius);
+            if (test == FRUSTUM_INTERSECT)
+                test = frustum_test_aabb(&camera->m_frustum, &entity->m_aabb_min, &entity->m_aabb_max);
+            if (test == FRUSTUM_OUTSIDE)
+                return;
+        }
+
+        nb_in_frustum++;
+        if (entity->m_visible)
+            entity->draw(&camera->m_mat_view_proj, lights, nb_lights);
+    });
+
+    m_nb_culled = m_entities.size() - nb_in_frustum;
 }
\ No newline at end of file
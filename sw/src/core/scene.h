@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bvh.h"
 #include "camera.h"
 #include "entity.h"
 
@@ -9,8 +10,17 @@
 class Scene {
 public:
     void add_entity(std::shared_ptr<Entity> entity);
+
+    // update the spatial index after the transform of an entity changed
+    void update_entity(Entity* entity);
+
     void draw(const Camera* camera, const light_t* lights, size_t nb_lights);
 
+    // number of entities rejected by the frustum culling during the last draw
+    size_t get_nb_culled() const { return m_nb_culled; }
+
 private:
     std::vector<std::shared_ptr<Entity>> m_entities;
+    BVH m_bvh;
+    size_t m_nb_culled = 0;
 };
\ No newline at end of file
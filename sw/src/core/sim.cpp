@@ -88,6 +88,7 @@ void sim_run(int *rasterizer_type) {
     while(!quit) {
 
         plane->update(delta_time);
+        scene.update_entity(plane.get());
         camera.update(view, *(std::dynamic_pointer_cast<Plane>(plane).get()), {13.0f, 20.0f, 0.0f});
         plane->m_visible = view != Camera::Views::COCKPIT_FORWARD;
         tower->m_visible = view != Camera::Views::TOWER;
@@ -158,6 +159,10 @@ void sim_run(int *rasterizer_type) {
                             if (rasterizer_type)
                                 *rasterizer_type = 2;
                             break;
+                        case SDLK_0:
+                            if (rasterizer_type)
+                                *rasterizer_type = 3;
+                            break;
                     }
                     break;
                 case SDL_KEYUP:
@@ -223,6 +228,6 @@ void sim_run(int *rasterizer_type) {
 
         frame_counter++;
         if ((frame_counter % 100) == 0)
-            printf("FPS: %.1f\n", 1.0f / delta_time);
+            printf("FPS: %.1f, culled entities: %d\n", 1.0f / delta_time, (int)scene.get_nb_culled());
     }
 }
\ No newline at end of file
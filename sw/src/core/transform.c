@@ -0,0 +1,126 @@
+// transform.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+// Batch matrix x vector transforms. The portable version is always available,
+// the vector extension, SSE and AVX versions are compiled in when the target supports them
+// and the widest one is used by matrix_multiply_vectors().
+
+#include "glib.h"
+
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+void matrix_multiply_vectors_scalar(const mat4x4* m, const vec3d* in, vec3d* out, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        out[i] = matrix_multiply_vector(m, &in[i]);
+}
+
+#if defined(GLIB_HAS_VECTOR_EXT)
+
+typedef float v4sf __attribute__((vector_size(16)));
+
+void matrix_multiply_vectors_vector_ext(const mat4x4* m, const vec3d* in, vec3d* out, size_t count) {
+    v4sf r0, r1, r2, r3;
+    memcpy(&r0, m->m[0], sizeof(v4sf));
+    memcpy(&r1, m->m[1], sizeof(v4sf));
+    memcpy(&r2, m->m[2], sizeof(v4sf));
+    memcpy(&r3, m->m[3], sizeof(v4sf));
+
+    for (size_t i = 0; i < count; ++i) {
+        // same evaluation order as matrix_multiply_vector() so the results are identical
+        v4sf r = in[i].x * r0 + in[i].y * r1 + in[i].z * r2 + r3;
+        memcpy(&out[i], &r, sizeof(v4sf));
+    }
+}
+
+#endif
+
+#if defined(GLIB_HAS_SSE)
+
+static inline __m128 transform_sse(__m128 v, __m128 r0, __m128 r1, __m128 r2, __m128 r3) {
+    __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+    return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0), _mm_mul_ps(y, r1)), _mm_mul_ps(z, r2)), r3);
+}
+
+void matrix_multiply_vectors_sse(const mat4x4* m, const vec3d* in, vec3d* out, size_t count) {
+    __m128 r0 = _mm_loadu_ps(m->m[0]);
+    __m128 r1 = _mm_loadu_ps(m->m[1]);
+    __m128 r2 = _mm_loadu_ps(m->m[2]);
+    __m128 r3 = _mm_loadu_ps(m->m[3]);
+
+    for (size_t i = 0; i < count; ++i)
+        _mm_storeu_ps(&out[i].x, transform_sse(_mm_loadu_ps(&in[i].x), r0, r1, r2, r3));
+}
+
+#endif
+
+#if defined(GLIB_HAS_AVX)
+
+static inline __m256 broadcast_row(const float* row) {
+    __m128 r = _mm_loadu_ps(row);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(r), r, 1);
+}
+
+void matrix_multiply_vectors_avx(const mat4x4* m, const vec3d* in, vec3d* out, size_t count) {
+    __m256 r0 = broadcast_row(m->m[0]);
+    __m256 r1 = broadcast_row(m->m[1]);
+    __m256 r2 = broadcast_row(m->m[2]);
+    __m256 r3 = broadcast_row(m->m[3]);
+
+    // two vectors per iteration, one in each 128-bit lane
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256 v = _mm256_loadu_ps(&in[i].x);
+        __m256 x = _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0));
+        __m256 y = _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1));
+        __m256 z = _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2));
+        __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, r0), _mm256_mul_ps(y, r1)), _mm256_mul_ps(z, r2)), r3);
+        _mm256_storeu_ps(&out[i].x, r);
+    }
+
+    if (i < count)
+        _mm_storeu_ps(&out[i].x, transform_sse(_mm_loadu_ps(&in[i].x), _mm256_castps256_ps128(r0), _mm256_castps256_ps128(r1),
+                                               _mm256_castps256_ps128(r2), _mm256_castps256_ps128(r3)));
+}
+
+#endif
+
+static const transform_kernel_t g_transform_kernels[] = {
+    {"scalar", matrix_multiply_vectors_scalar},
+#if defined(GLIB_HAS_VECTOR_EXT)
+    {"vector_ext", matrix_multiply_vectors_vector_ext},
+#endif
+#if defined(GLIB_HAS_SSE)
+    {"sse", matrix_multiply_vectors_sse},
+#endif
+#if defined(GLIB_HAS_AVX)
+    {"avx", matrix_multiply_vectors_avx},
+#endif
+};
+
+const transform_kernel_t* matrix_get_transform_kernels(size_t* nb_kernels) {
+    *nb_kernels = sizeof(g_transform_kernels) / sizeof(g_transform_kernels[0]);
+    return g_transform_kernels;
+}
+
+void matrix_multiply_vectors(const mat4x4* m, const vec3d* in, vec3d* out, size_t count) {
+#if defined(GLIB_HAS_AVX)
+    matrix_multiply_vectors_avx(m, in, out, count);
+#elif defined(GLIB_HAS_SSE)
+    matrix_multiply_vectors_sse(m, in, out, count);
+#elif defined(GLIB_HAS_VECTOR_EXT)
+    matrix_multiply_vectors_vector_ext(m, in, out, count);
+#else
+    matrix_multiply_vectors_scalar(m, in, out, count);
+#endif
+}
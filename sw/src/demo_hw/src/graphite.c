@@ -353,7 +353,15 @@ bool load_model(model_t *model, const char *obj_filename) {
 
     if (!load_mesh_obj_data(&model->mesh, path))
         return false;
-    model->triangles_to_raster = (triangle_t *)malloc(2 * model->mesh.nb_faces * sizeof(triangle_t));
+    model->mesh.face_planes = (vec3d *)malloc(model->mesh.nb_faces * sizeof(vec3d));
+    mesh_compute_face_planes(&model->mesh);
+    mesh_compute_bounds(&model->mesh);
+    model->triangles_to_raster = (triangle_t *)malloc(MAX_CLIPPED_TRIANGLES * model->mesh.nb_faces * sizeof(triangle_t));
+    model->clip_vertices = (vec3d *)malloc(model->mesh.nb_vertices * sizeof(vec3d));
+    model->normal_colors = (vec3d *)malloc(model->mesh.nb_normals * sizeof(vec3d));
+    model->used_normals = (bool *)malloc(model->mesh.nb_normals * sizeof(bool));
+    model->used_vertices = (bool *)malloc(model->mesh.nb_vertices * sizeof(bool));
+    model->front_faces = (size_t *)malloc(model->mesh.nb_faces * sizeof(size_t));
     return true;
 }
 
@@ -370,6 +378,9 @@ bool load_texture(texture_t *texture, const char *tex_filename) {
     }
 
     texture->addr = (uint16_t *)g_tex_addr;
+    // the rasterizer samples the base level only
+    texture->nb_levels = 1;
+    texture->swizzled = false;
 
     int texture_width = upng_get_width(png_image);
     int texture_height = upng_get_height(png_image);
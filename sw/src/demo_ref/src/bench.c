@@ -0,0 +1,794 @@
+// bench.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "graphite.h"
+#include "sw_rasterizer.h"
+#include "worker_pool.h"
+
+extern int g_rasterizer_type;
+
+static double elapsed_seconds(uint64_t start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+int bench_cache_misses_open(void) {
+#if defined(__linux__)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+uint64_t bench_cache_misses_read(int counter) {
+    uint64_t count = 0;
+#if defined(__linux__)
+    if (counter >= 0 && read(counter, &count, sizeof(count)) != sizeof(count))
+        count = 0;
+#endif
+    return count;
+}
+
+void bench_cache_misses_close(int counter) {
+#if defined(__linux__)
+    if (counter >= 0)
+        close(counter);
+#endif
+}
+
+static int bench_transform(void) {
+    const size_t nb_vertices = 4096;
+    const int nb_iterations = 2000;
+
+    vec3d* in = (vec3d*)malloc(nb_vertices * sizeof(vec3d));
+    vec3d* ref = (vec3d*)malloc(nb_vertices * sizeof(vec3d));
+    vec3d* out = (vec3d*)malloc(nb_vertices * sizeof(vec3d));
+
+    srand(1);
+    for (size_t i = 0; i < nb_vertices; ++i)
+        in[i] = (vec3d){(float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, 1.0f};
+
+    mat4x4 mat_rot = matrix_make_rotation_y(0.3f);
+    mat4x4 mat_trans = matrix_make_translation(1.0f, 2.0f, 3.0f);
+    mat4x4 mat_proj = matrix_make_projection(320, 240, 60.0f);
+    mat4x4 m = matrix_multiply_matrix(&mat_rot, &mat_trans);
+    m = matrix_multiply_matrix(&m, &mat_proj);
+
+    matrix_multiply_vectors_scalar(&m, in, ref, nb_vertices);
+
+    size_t nb_kernels;
+    const transform_kernel_t* kernels = matrix_get_transform_kernels(&nb_kernels);
+    for (size_t k = 0; k < nb_kernels; ++k) {
+        uint64_t start = SDL_GetPerformanceCounter();
+        for (int it = 0; it < nb_iterations; ++it)
+            kernels[k].fn(&m, in, out, nb_vertices);
+        double t = elapsed_seconds(start);
+
+        float max_error = 0.0f;
+        for (size_t i = 0; i < nb_vertices; ++i) {
+            max_error = fmaxf(max_error, fabsf(out[i].x - ref[i].x));
+            max_error = fmaxf(max_error, fabsf(out[i].y - ref[i].y));
+            max_error = fmaxf(max_error, fabsf(out[i].z - ref[i].z));
+            max_error = fmaxf(max_error, fabsf(out[i].w - ref[i].w));
+        }
+
+        printf("%-12s %8.1f Mvertices/s (max error vs scalar: %g)\n", kernels[k].name,
+               (double)nb_vertices * nb_iterations / t / 1e6, max_error);
+    }
+
+    free(out);
+    free(ref);
+    free(in);
+    return 0;
+}
+
+static vec3d midpoint(const vec3d* a, const vec3d* b) {
+    return (vec3d){(a->x + b->x) * 0.5f, (a->y + b->y) * 0.5f, (a->z + b->z) * 0.5f, (a->w + b->w) * 0.5f};
+}
+
+static vec2d midpoint2(const vec2d* a, const vec2d* b) {
+    return (vec2d){(a->u + b->u) * 0.5f, (a->v + b->v) * 0.5f, (a->w + b->w) * 0.5f};
+}
+
+// Split each face of the mesh in four, the new vertices are not shared between faces
+static void subdivide_mesh(mesh_t* mesh) {
+    mesh_t m = {0};
+    m.nb_vertices = mesh->nb_vertices;
+    m.nb_texcoords = mesh->nb_texcoords;
+    m.nb_normals = mesh->nb_normals;
+    for (size_t i = 0; i < mesh->nb_vertices; ++i)
+        array_push(m.vertices, mesh->vertices[i]);
+    for (size_t i = 0; i < mesh->nb_texcoords; ++i)
+        array_push(m.texcoords, mesh->texcoords[i]);
+    for (size_t i = 0; i < mesh->nb_normals; ++i)
+        array_push(m.normals, mesh->normals[i]);
+
+    for (size_t i = 0; i < mesh->nb_faces; ++i) {
+        const face_t* f = &mesh->faces[i];
+
+        // indices of the corners then of the edge midpoints 01, 12 and 20
+        int v[6], t[6], n[6];
+        for (int j = 0; j < 3; ++j) {
+            int k = (j + 1) % 3;
+            v[j] = f->indices[j];
+            t[j] = f->tex_indices[j];
+            n[j] = f->norm_indices[j];
+
+            v[3 + j] = (int)m.nb_vertices++;
+            array_push(m.vertices, midpoint(&mesh->vertices[f->indices[j]], &mesh->vertices[f->indices[k]]));
+            t[3 + j] = (int)m.nb_texcoords++;
+            array_push(m.texcoords, midpoint2(&mesh->texcoords[f->tex_indices[j]], &mesh->texcoords[f->tex_indices[k]]));
+            n[3 + j] = (int)m.nb_normals++;
+            vec3d normal = midpoint(&mesh->normals[f->norm_indices[j]], &mesh->normals[f->norm_indices[k]]);
+            array_push(m.normals, vector_normalize(&normal));
+        }
+
+        static const int corners[4][3] = {{0, 3, 5}, {3, 1, 4}, {5, 4, 2}, {3, 4, 5}};
+        for (int j = 0; j < 4; ++j) {
+            face_t face = {0};
+            for (int k = 0; k < 3; ++k) {
+                face.indices[k] = v[corners[j][k]];
+                face.tex_indices[k] = t[corners[j][k]];
+                face.norm_indices[k] = n[corners[j][k]];
+            }
+            array_push(m.faces, face);
+            m.nb_faces++;
+        }
+    }
+
+    array_free(mesh->vertices);
+    array_free(mesh->texcoords);
+    array_free(mesh->normals);
+    array_free(mesh->faces);
+    *mesh = m;
+}
+
+// Free what init_model() allocated
+static void free_model_buffers(model_t* model) {
+    free(model->mesh.face_planes);
+    free(model->triangles_to_raster);
+    free(model->clip_vertices);
+    free(model->normal_colors);
+    free(model->used_normals);
+    free(model->used_vertices);
+    free(model->front_faces);
+}
+
+static void free_model(model_t* model) {
+    free_model_buffers(model);
+    array_free(model->mesh.vertices);
+    array_free(model->mesh.texcoords);
+    array_free(model->mesh.normals);
+    array_free(model->mesh.faces);
+}
+
+// Geometry stage of draw_model() on the largest asset, subdivided, with an increasing number of threads
+static int bench_geometry(void) {
+    const int nb_iterations = 200;
+    int max_threads = SDL_GetCPUCount();
+
+    light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+    mat4x4 mat_proj = matrix_make_projection(320, 240, 60.0f);
+
+    // no rasterization
+    int rasterizer_type = g_rasterizer_type;
+    g_rasterizer_type = -1;
+
+    printf("%8s %8s %12s %8s\n", "faces", "threads", "time (us)", "speedup");
+
+    for (int level = 0; level <= 4; ++level) {
+        model_t model = {0};
+        if (!load_model(&model, "efa.obj"))
+            return 1;
+        if (level > 0) {
+            free_model_buffers(&model);
+            for (int i = 0; i < level; ++i)
+                subdivide_mesh(&model.mesh);
+            init_model(&model);
+        }
+
+        // centered in front of the camera
+        const mesh_t* mesh = &model.mesh;
+        mat4x4 mat_center = matrix_make_translation(-mesh->sphere_center.x, -mesh->sphere_center.y, -mesh->sphere_center.z);
+        mat4x4 mat_rot = matrix_make_rotation_y(0.5f);
+        mat4x4 mat_trans = matrix_make_translation(0.0f, 0.0f, 2.0f * mesh->sphere_radius);
+        mat4x4 mat_world = matrix_multiply_matrix(&mat_center, &mat_rot);
+        mat_world = matrix_multiply_matrix(&mat_world, &mat_trans);
+        mat4x4 mat_clip = matrix_multiply_matrix(&mat_world, &mat_proj);
+
+        double t_single = 0.0;
+        // 1, 2, 4, ... threads, and the number of cores
+        int nb_threads = 1;
+        while (nb_threads <= max_threads) {
+            worker_pool_init(nb_threads);
+            set_parallel_run(worker_pool_run, worker_pool_get_nb_threads());
+
+            uint64_t start = SDL_GetPerformanceCounter();
+            for (int it = 0; it < nb_iterations; ++it)
+                draw_model(320, 240, &model, &mat_world, &mat_rot, &mat_clip, &light, 1, NULL, false, false, true);
+            double t = elapsed_seconds(start) / nb_iterations;
+
+            set_parallel_run(NULL, 1);
+            worker_pool_dispose();
+
+            if (nb_threads == 1)
+                t_single = t;
+            printf("%8d %8d %12.1f %8.2f\n", (int)mesh->nb_faces, nb_threads, t * 1e6, t_single / t);
+
+            if (nb_threads < max_threads && nb_threads * 2 > max_threads)
+                nb_threads = max_threads;
+            else
+                nb_threads *= 2;
+        }
+
+        free_model(&model);
+    }
+
+    g_rasterizer_type = rasterizer_type;
+    return 0;
+}
+
+// Pixels tested and covered by the barycentric rasterizer on the runway, a pair of long thin triangles.
+// The bounding box column is what a traversal testing every pixel would test.
+static int bench_coverage(void) {
+    const int nb_iterations = 100;
+    const int fb_width = 320, fb_height = 240;
+
+    model_t model = {0};
+    texture_t texture = {0};
+    if (!load_model(&model, "runway.obj") || !load_texture(&texture, "runway.png"))
+        return 1;
+
+    uint16_t* framebuffer = (uint16_t*)malloc(fb_width * fb_height * sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_width * fb_height * sizeof(sw_depth_t));
+    sw_init_rasterizer_barycentric(fb_width, fb_height, framebuffer, depth_buffer);
+    int rasterizer_type = g_rasterizer_type;
+    g_rasterizer_type = 2;
+
+    light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+    mat4x4 mat_proj = matrix_make_projection(fb_width, fb_height, 60.0f);
+    mat4x4 mat_world = matrix_make_translation(0.0f, -0.5f, 3.0f);
+    mat4x4 mat_normal = matrix_make_identity();
+
+    // threshold, short final and the initial camera of the simulation
+    static const struct {
+        const char* name;
+        vec3d pos, target;
+    } views[] = {
+        {"threshold", {0.0f, 0.7f, -16.0f, 1.0f}, {0.0f, 0.0f, 20.0f, 1.0f}},
+        {"final", {0.0f, 5.0f, -40.0f, 1.0f}, {0.0f, 0.0f, 0.0f, 1.0f}},
+        {"side", {0.0f, 5.0f, -30.0f, 1.0f}, {20.0f, 0.0f, 0.0f, 1.0f}},
+    };
+
+    printf("%-10s %10s %10s %10s %10s\n", "view", "bbox", "tested", "covered", "time (us)");
+
+    for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); ++i) {
+        vec3d pos = views[i].pos, target = views[i].target;
+        vec3d up = {0.0f, 1.0f, 0.0f, 1.0f};
+        mat4x4 mat_camera = matrix_point_at(&pos, &target, &up);
+        mat4x4 mat_view = matrix_quick_inverse(&mat_camera);
+        mat4x4 mat_clip = matrix_multiply_matrix(&mat_world, &mat_view);
+        mat_clip = matrix_multiply_matrix(&mat_clip, &mat_proj);
+
+        sw_reset_stats_barycentric();
+        uint64_t start = SDL_GetPerformanceCounter();
+        for (int it = 0; it < nb_iterations; ++it) {
+            sw_clear_depth_buffer_barycentric();
+            draw_model(fb_width, fb_height, &model, &mat_world, &mat_normal, &mat_clip, &light, 1, &texture, false, false, true);
+        }
+        double t = elapsed_seconds(start) / nb_iterations;
+
+        sw_raster_stats_t stats;
+        sw_get_stats_barycentric(&stats);
+        printf("%-10s %10d %10d %10d %10.1f\n", views[i].name, (int)(stats.nb_bbox_pixels / nb_iterations),
+               (int)(stats.nb_tested_pixels / nb_iterations), (int)(stats.nb_covered_pixels / nb_iterations), t * 1e6);
+    }
+
+    g_rasterizer_type = rasterizer_type;
+    free(depth_buffer);
+    free(framebuffer);
+    free(texture.addr);
+    free_model(&model);
+    return 0;
+}
+
+static float random_range(float a, float b) { return a + (b - a) * (float)rand() / (float)RAND_MAX; }
+
+// Fragment kernels on random spans with the nearest and the bilinear filtering, checked against the scalar kernel
+static int bench_span(void) {
+    const int nb_spans = 4096;
+    const int max_count = 64;
+    const int nb_iterations = 200;
+
+    uint16_t texture[32 * 32];
+    sw_span_t* spans = (sw_span_t*)malloc(nb_spans * sizeof(sw_span_t));
+    int* counts = (int*)malloc(nb_spans * sizeof(int));
+    size_t buffer_size = (size_t)nb_spans * max_count;
+    sw_depth_t* depth_init = (sw_depth_t*)malloc(buffer_size * sizeof(sw_depth_t));
+    sw_depth_t* depth_ref = (sw_depth_t*)malloc(buffer_size * sizeof(sw_depth_t));
+    sw_depth_t* depth = (sw_depth_t*)malloc(buffer_size * sizeof(sw_depth_t));
+    uint16_t* colors_ref = (uint16_t*)calloc(buffer_size, sizeof(uint16_t));
+    uint16_t* colors = (uint16_t*)calloc(buffer_size, sizeof(uint16_t));
+    bool* written_ref = (bool*)calloc(buffer_size, sizeof(bool));
+    bool* written = (bool*)calloc(buffer_size, sizeof(bool));
+
+    srand(1);
+    for (int i = 0; i < 32 * 32; ++i)
+        texture[i] = (uint16_t)rand();
+    int nb_pixels = 0;
+    for (int i = 0; i < nb_spans; ++i) {
+        // perspective divided attributes of a span of up to 64 pixels, repeating the texture a few times, every
+        // fifth span magnified so that whole groups of lanes filter the same 2x2 texels
+        float z = random_range(0.01f, 1.0f);
+        float dz = random_range(-z, 1.0f - z) / max_count;
+        float duv = i % 5 == 0 ? 0.001f : 0.05f;
+        spans[i] = (sw_span_t){FXS(z, SCALE_Z), FXS(random_range(0.0f, 4.0f) * z, SCALE_UV), FXS(random_range(0.0f, 4.0f) * z, SCALE_UV),
+                               FXS(random_range(0.0f, 1.0f) * z, SCALE_COLOR), FXS(random_range(0.0f, 1.0f) * z, SCALE_COLOR),
+                               FXS(random_range(0.0f, 1.0f) * z, SCALE_COLOR),
+                               FXS(dz, SCALE_Z), FXS(random_range(-duv, duv), SCALE_UV), FXS(random_range(-duv, duv), SCALE_UV),
+                               FXS(random_range(-0.01f, 0.01f), SCALE_COLOR), FXS(random_range(-0.01f, 0.01f), SCALE_COLOR),
+                               FXS(random_range(-0.01f, 0.01f), SCALE_COLOR),
+                               texture, 0, 0, i % 3 == 0, i % 4 == 0, i % 8 == 0, true, true};
+        counts[i] = 1 + rand() % max_count;
+        nb_pixels += counts[i];
+        for (int k = 0; k < max_count; ++k)
+            depth_init[(size_t)i * max_count + k] = sw_depth(FXS(random_range(0.0f, 0.5f), SCALE_Z));
+    }
+
+    for (int filter = 0; filter < 2; ++filter) {
+        sw_set_bilinear(filter != 0);
+        memcpy(depth_ref, depth_init, buffer_size * sizeof(sw_depth_t));
+        for (int i = 0; i < nb_spans; ++i) {
+            size_t o = (size_t)i * max_count;
+            sw_shade_span_scalar(&spans[i], 0, counts[i], &depth_ref[o], &colors_ref[o], &written_ref[o]);
+        }
+
+        size_t nb_kernels;
+        const sw_span_kernel_t* kernels = sw_get_span_kernels(&nb_kernels);
+        for (size_t k = 0; k < nb_kernels; ++k) {
+            memcpy(depth, depth_init, buffer_size * sizeof(sw_depth_t));
+            memset(colors, 0, buffer_size * sizeof(uint16_t));
+            memset(written, 0, buffer_size * sizeof(bool));
+            for (int i = 0; i < nb_spans; ++i) {
+                size_t o = (size_t)i * max_count;
+                kernels[k].fn(&spans[i], 0, counts[i], &depth[o], &colors[o], &written[o]);
+            }
+            bool identical = memcmp(depth, depth_ref, buffer_size * sizeof(sw_depth_t)) == 0 &&
+                             memcmp(colors, colors_ref, buffer_size * sizeof(uint16_t)) == 0 &&
+                             memcmp(written, written_ref, buffer_size * sizeof(bool)) == 0;
+
+            // the depth buffer is reset so that every iteration shades the same pixels
+            double t = 0.0;
+            for (int it = 0; it < nb_iterations; ++it) {
+                memcpy(depth, depth_init, buffer_size * sizeof(sw_depth_t));
+                uint64_t start = SDL_GetPerformanceCounter();
+                for (int i = 0; i < nb_spans; ++i) {
+                    size_t o = (size_t)i * max_count;
+                    kernels[k].fn(&spans[i], 0, counts[i], &depth[o], &colors[o], &written[o]);
+                }
+                t += elapsed_seconds(start);
+            }
+
+            printf("%-12s %-9s %8.1f Mpixels/s (%s scalar)\n", kernels[k].name, filter ? "bilinear" : "nearest",
+                   (double)nb_pixels * nb_iterations / t / 1e6, identical ? "identical to" : "DIFFERENT from");
+        }
+    }
+    sw_set_bilinear(false);
+
+    free(written);
+    free(written_ref);
+    free(colors);
+    free(colors_ref);
+    free(depth);
+    free(depth_ref);
+    free(depth_init);
+    free(counts);
+    free(spans);
+    return 0;
+}
+
+// Affine spans of a 320x240 frame walking the runway texture at a few angles and texel steps per pixel, shaded
+// from the row-major and the swizzled layouts
+static int bench_texture_layout(void) {
+    const int fb_width = 320, fb_height = 240;
+    const int nb_iterations = 20;
+
+    texture_t textures[2] = {{0}, {0}};
+    for (int swizzled = 0; swizzled < 2; ++swizzled) {
+        set_texture_swizzle(swizzled != 0);
+        if (!load_texture(&textures[swizzled], "runway.png"))
+            return 1;
+    }
+    set_texture_swizzle(false);
+    float width = (float)(32 << textures[0].scale_x), height = (float)(32 << textures[0].scale_y);
+
+    sw_span_t* spans = (sw_span_t*)malloc(fb_height * sizeof(sw_span_t));
+    sw_depth_t* depth = (sw_depth_t*)calloc(fb_width, sizeof(sw_depth_t));
+    uint16_t* colors[2];
+    colors[0] = (uint16_t*)malloc((size_t)fb_width * fb_height * sizeof(uint16_t));
+    colors[1] = (uint16_t*)malloc((size_t)fb_width * fb_height * sizeof(uint16_t));
+    bool* written = (bool*)malloc(fb_width * sizeof(bool));
+    int counter = bench_cache_misses_open();
+
+    static const float angles[] = {0.0f, 30.0f, 45.0f, 60.0f, 90.0f};
+    static const float steps[] = {0.5f, 1.0f, 2.0f};
+
+    printf("%-6s %-6s %14s %14s %8s %14s %14s %s\n", "angle", "step", "rows (Mpix/s)", "tiles (Mpix/s)", "speedup",
+           "rows misses", "tiles misses", "colors");
+
+    for (size_t a = 0; a < sizeof(angles) / sizeof(angles[0]); ++a) {
+        for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); ++s) {
+            // texels per pixel along the rows and down the columns of the frame
+            float c = cosf(angles[a] * PI / 180.0f) * steps[s], d = sinf(angles[a] * PI / 180.0f) * steps[s];
+
+            double t[2];
+            uint64_t misses[2];
+            for (int swizzled = 0; swizzled < 2; ++swizzled) {
+                const texture_t* tex = &textures[swizzled];
+                for (int y = 0; y < fb_height; ++y)
+                    spans[y] = (sw_span_t){FXS(1.0f, SCALE_Z), FXS(0.25f - y * d / width, SCALE_UV), FXS(0.25f + y * c / height, SCALE_UV),
+                                           FXS(1.0f, SCALE_COLOR), FXS(1.0f, SCALE_COLOR), FXS(1.0f, SCALE_COLOR),
+                                           0, FXS(c / width, SCALE_UV), FXS(d / height, SCALE_UV), 0, 0, 0,
+                                           tex->addr, tex->scale_x, tex->scale_y, tex->swizzled, false, false, false, false};
+                sw_span_fn_t fn = sw_select_span_fn(tex->addr, tex->swizzled, false, false, false, false);
+
+                misses[swizzled] = bench_cache_misses_read(counter);
+                uint64_t start = SDL_GetPerformanceCounter();
+                for (int it = 0; it < nb_iterations; ++it)
+                    for (int y = 0; y < fb_height; ++y)
+                        fn(&spans[y], 0, fb_width, depth, &colors[swizzled][y * fb_width], written);
+                t[swizzled] = elapsed_seconds(start);
+                misses[swizzled] = (bench_cache_misses_read(counter) - misses[swizzled]) / nb_iterations;
+            }
+
+            double nb_pixels = (double)fb_width * fb_height * nb_iterations;
+            printf("%-6.0f %-6.1f %14.1f %14.1f %8.2f ", angles[a], steps[s], nb_pixels / t[0] / 1e6, nb_pixels / t[1] / 1e6,
+                   t[0] / t[1]);
+            if (counter >= 0)
+                printf("%14llu %14llu", (unsigned long long)misses[0], (unsigned long long)misses[1]);
+            else
+                printf("%14s %14s", "n/a", "n/a");
+            printf(" %s\n", memcmp(colors[0], colors[1], (size_t)fb_width * fb_height * sizeof(uint16_t)) == 0 ? "identical" : "DIFFERENT");
+        }
+    }
+
+    bench_cache_misses_close(counter);
+    free(written);
+    free(colors[1]);
+    free(colors[0]);
+    free(depth);
+    free(spans);
+    free(textures[1].addr);
+    free(textures[0].addr);
+    return 0;
+}
+
+// Shading time per pixel of the nearest and the bilinear filtering, with the scalar kernel specialized for the
+// render state and the kernel the rasterizers select, on affine spans of the runway texture at 30 degrees with
+// the texels in rows then swizzled
+static int bench_bilinear(void) {
+    const int fb_width = 320, fb_height = 240;
+    const int nb_iterations = 10;
+    const int nb_runs = 10;
+
+    sw_span_t* spans = (sw_span_t*)malloc(fb_height * sizeof(sw_span_t));
+    sw_depth_t* depth = (sw_depth_t*)calloc(fb_width, sizeof(sw_depth_t));
+    uint16_t* colors = (uint16_t*)malloc(fb_width * sizeof(uint16_t));
+    bool* written = (bool*)malloc(fb_width * sizeof(bool));
+
+    printf("%-10s %-9s %14s %14s %8s\n", "kernel", "layout", "nearest (ns)", "bilinear (ns)", "ratio");
+
+    for (int swizzled = 0; swizzled < 2; ++swizzled) {
+        texture_t texture = {0};
+        set_texture_swizzle(swizzled != 0);
+        if (!load_texture(&texture, "runway.png"))
+            break;
+        float width = (float)(32 << texture.scale_x), height = (float)(32 << texture.scale_y);
+
+        float c = cosf(30.0f * PI / 180.0f), d = sinf(30.0f * PI / 180.0f);
+        for (int y = 0; y < fb_height; ++y)
+            spans[y] = (sw_span_t){FXS(1.0f, SCALE_Z), FXS(0.25f - y * d / width, SCALE_UV), FXS(0.25f + y * c / height, SCALE_UV),
+                                   FXS(1.0f, SCALE_COLOR), FXS(1.0f, SCALE_COLOR), FXS(1.0f, SCALE_COLOR),
+                                   0, FXS(c / width, SCALE_UV), FXS(d / height, SCALE_UV), 0, 0, 0,
+                                   texture.addr, texture.scale_x, texture.scale_y, texture.swizzled, false, false, false, false};
+
+        for (int selected = 0; selected < 2; ++selected) {
+            double t[2];
+            for (int filter = 0; filter < 2; ++filter) {
+                sw_set_bilinear(filter != 0);
+                sw_span_fn_t fn = selected ? sw_select_span_fn(texture.addr, texture.swizzled, false, false, false, false)
+                                           : sw_get_span_variant_scalar(sw_get_render_state(texture.addr, texture.swizzled, false, false, false, false));
+                // best of the runs, the others are disturbed
+                t[filter] = INFINITY;
+                for (int run = 0; run < nb_runs; ++run) {
+                    uint64_t start = SDL_GetPerformanceCounter();
+                    for (int it = 0; it < nb_iterations; ++it)
+                        for (int y = 0; y < fb_height; ++y)
+                            fn(&spans[y], 0, fb_width, depth, colors, written);
+                    double t_run = elapsed_seconds(start) / ((double)fb_width * fb_height * nb_iterations);
+                    t[filter] = t_run < t[filter] ? t_run : t[filter];
+                }
+            }
+            printf("%-10s %-9s %14.2f %14.2f %8.2f\n", selected ? "selected" : "scalar", swizzled ? "swizzled" : "rows",
+                   t[0] * 1e9, t[1] * 1e9, t[1] / t[0]);
+        }
+        free(texture.addr);
+    }
+    sw_set_bilinear(false);
+    set_texture_swizzle(false);
+
+    free(written);
+    free(colors);
+    free(depth);
+    free(spans);
+    return 0;
+}
+
+// Modulation of the fragment shader before sw_modulate_texel(), the texel channels normalized by divisions then
+// the products by 31, 63 and 31 of the packing
+static __attribute__((noinline)) uint16_t modulate_texel_divide(fx32 r, fx32 g, fx32 b, uint16_t texel) {
+    fx32 fifteen = FXIS(15, SCALE_COLOR);
+    r = MULS(r, DIVS(FXIS((texel >> 8) & 0xF, SCALE_COLOR), fifteen, SCALE_COLOR), SCALE_COLOR);
+    g = MULS(g, DIVS(FXIS((texel >> 4) & 0xF, SCALE_COLOR), fifteen, SCALE_COLOR), SCALE_COLOR);
+    b = MULS(b, DIVS(FXIS(texel & 0xF, SCALE_COLOR), fifteen, SCALE_COLOR), SCALE_COLOR);
+    int rr = INTS(MULS(r, FXS(31.0f, SCALE_COLOR), SCALE_COLOR), SCALE_COLOR);
+    int gg = INTS(MULS(g, FXS(63.0f, SCALE_COLOR), SCALE_COLOR), SCALE_COLOR);
+    int bb = INTS(MULS(b, FXS(31.0f, SCALE_COLOR), SCALE_COLOR), SCALE_COLOR);
+    return rr << 11 | gg << 5 | bb;
+}
+
+// Time per pixel of the modulation of random colors by random texels and of their packing to RGB565, with the
+// divisions of modulate_texel_divide() and with the tables of sw_modulate_texel()
+static int bench_texel_pack(void) {
+    const int nb_pixels = 1 << 16;
+    const int nb_iterations = 20;
+    const int nb_runs = 10;
+
+    fx32* colors = (fx32*)malloc(3 * nb_pixels * sizeof(fx32));
+    uint16_t* texels = (uint16_t*)malloc(nb_pixels * sizeof(uint16_t));
+    uint16_t* packed[2];
+    packed[0] = (uint16_t*)malloc(nb_pixels * sizeof(uint16_t));
+    packed[1] = (uint16_t*)malloc(nb_pixels * sizeof(uint16_t));
+
+    srand(1);
+    for (int i = 0; i < nb_pixels; ++i) {
+        for (int k = 0; k < 3; ++k)
+            colors[3 * i + k] = FXS(random_range(0.0f, 1.0f), SCALE_COLOR);
+        texels[i] = (uint16_t)rand();
+    }
+
+    static const struct {
+        const char* name;
+        uint16_t (*fn)(fx32 r, fx32 g, fx32 b, uint16_t texel);
+    } routines[] = {{"divide", modulate_texel_divide}, {"tables", sw_modulate_texel}};
+
+    double t[2];
+    for (int k = 0; k < 2; ++k) {
+        // best of the runs, the others are disturbed
+        t[k] = INFINITY;
+        for (int run = 0; run < nb_runs; ++run) {
+            uint64_t start = SDL_GetPerformanceCounter();
+            for (int it = 0; it < nb_iterations; ++it)
+                for (int i = 0; i < nb_pixels; ++i)
+                    packed[k][i] = routines[k].fn(colors[3 * i], colors[3 * i + 1], colors[3 * i + 2], texels[i]);
+            double t_run = elapsed_seconds(start) / ((double)nb_pixels * nb_iterations);
+            t[k] = t_run < t[k] ? t_run : t[k];
+        }
+        printf("%-8s %8.2f ns/pixel\n", routines[k].name, t[k] * 1e9);
+    }
+
+    // the single product rounds once instead of twice, a channel can end 1 lower or higher
+    int nb_differing = 0;
+    for (int i = 0; i < nb_pixels; ++i)
+        if (packed[0][i] != packed[1][i])
+            nb_differing++;
+    printf("speedup %.2f, %d differing pixels (%.2f%%)\n", t[0] / t[1], nb_differing, 100.0 * nb_differing / nb_pixels);
+
+    free(packed[1]);
+    free(packed[0]);
+    free(texels);
+    free(colors);
+    return 0;
+}
+
+#if FIXED_POINT == 2
+#define MODE_NAME "int32"
+#elif FIXED_POINT
+#define MODE_NAME "int64"
+#else
+#define MODE_NAME "float"
+#endif
+
+static void draw_fixed_point_triangle(int rasterizer, fx32 t[3][9], const uint16_t* tex_addr, bool clamp_s, bool clamp_t) {
+    if (rasterizer == 0)
+        sw_draw_triangle_standard(t[0][0], t[0][1], t[0][2], t[0][3], t[0][4], t[0][5], t[0][6], t[0][7], t[0][8],
+                                  t[1][0], t[1][1], t[1][2], t[1][3], t[1][4], t[1][5], t[1][6], t[1][7], t[1][8],
+                                  t[2][0], t[2][1], t[2][2], t[2][3], t[2][4], t[2][5], t[2][6], t[2][7], t[2][8],
+                                  tex_addr, 0, 0, 1, false, clamp_s, clamp_t, true, true);
+    else if (rasterizer == 1)
+        sw_draw_triangle_standard2(t[0][0], t[0][1], t[0][2], t[0][3], t[0][4], t[0][5], t[0][6], t[0][7], t[0][8],
+                                   t[1][0], t[1][1], t[1][2], t[1][3], t[1][4], t[1][5], t[1][6], t[1][7], t[1][8],
+                                   t[2][0], t[2][1], t[2][2], t[2][3], t[2][4], t[2][5], t[2][6], t[2][7], t[2][8],
+                                   tex_addr, 0, 0, 1, false, clamp_s, clamp_t, true, true);
+    else
+        sw_draw_triangle_barycentric(t[0][0], t[0][1], t[0][2], t[0][3], t[0][4], t[0][5], t[0][6], t[0][7], t[0][8],
+                                     t[1][0], t[1][1], t[1][2], t[1][3], t[1][4], t[1][5], t[1][6], t[1][7], t[1][8],
+                                     t[2][0], t[2][1], t[2][2], t[2][3], t[2][4], t[2][5], t[2][6], t[2][7], t[2][8],
+                                     tex_addr, 0, 0, 1, false, clamp_s, clamp_t, true, true);
+}
+
+// Fixed set of triangles drawn by the standard, standard2 and barycentric rasterizers. The frames are saved
+// to fixed_point_<mode>.bin and compared with the ones of the other number formats found in the working
+// directory, see the fixed_point_check target of the Makefile.
+static int bench_fixed_point(void) {
+    const int nb_triangles = 500;
+    const int fb_width = 320, fb_height = 240;
+    static const char* modes[] = {"float", "int64", "int32"};
+    static const char* rasterizers[] = {"standard", "standard2", "barycentric"};
+    const int nb_rasterizers = sizeof(rasterizers) / sizeof(rasterizers[0]);
+    size_t fb_size = (size_t)fb_width * fb_height;
+
+    uint16_t texture[32 * 32];
+    uint16_t* frames = (uint16_t*)calloc(nb_rasterizers * fb_size, sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_size * sizeof(sw_depth_t));
+    uint16_t* other = (uint16_t*)malloc(nb_rasterizers * fb_size * sizeof(uint16_t));
+    float (*vertices)[3][8] = malloc(nb_triangles * sizeof(*vertices));
+
+    // x, y, 1/w and the perspective divided u, v, r, g, b over the viewport and the guard band,
+    // from the near to the far plane
+    srand(1);
+    for (int i = 0; i < 32 * 32; ++i)
+        texture[i] = (uint16_t)rand();
+    for (int i = 0; i < nb_triangles; ++i) {
+        float cx = random_range(-64.0f, fb_width + 64.0f), cy = random_range(-64.0f, fb_height + 64.0f);
+        float size = random_range(2.0f, 120.0f);
+        for (int j = 0; j < 3; ++j) {
+            float z = random_range(0.001f, 3.3f);
+            vertices[i][j][0] = fminf(fmaxf(cx + random_range(-size, size), -64.0f), fb_width + 64.0f);
+            vertices[i][j][1] = fminf(fmaxf(cy + random_range(-size, size), -64.0f), fb_height + 64.0f);
+            vertices[i][j][2] = z;
+            vertices[i][j][3] = random_range(0.0f, 4.0f) * z;
+            vertices[i][j][4] = random_range(0.0f, 4.0f) * z;
+            for (int k = 5; k < 8; ++k)
+                vertices[i][j][k] = random_range(0.0f, 1.0f) * z;
+        }
+
+        // the orientation culled by the barycentric rasterizer is drawn by the other ones
+        float (*v)[8] = vertices[i];
+        if ((v[2][0] - v[0][0]) * (v[1][1] - v[0][1]) - (v[2][1] - v[0][1]) * (v[1][0] - v[0][0]) < 0.0f) {
+            for (int k = 0; k < 8; ++k) {
+                float t = v[1][k];
+                v[1][k] = v[2][k];
+                v[2][k] = t;
+            }
+        }
+    }
+
+    for (int r = 0; r < nb_rasterizers; ++r) {
+        uint16_t* frame = &frames[r * fb_size];
+        if (r == 0) {
+            sw_init_rasterizer_standard(fb_width, fb_height, frame, depth_buffer);
+            sw_clear_depth_buffer_standard();
+        } else if (r == 1) {
+            sw_init_rasterizer_standard2(fb_width, fb_height, frame, depth_buffer);
+            sw_clear_depth_buffer_standard2();
+        } else {
+            sw_init_rasterizer_barycentric(fb_width, fb_height, frame, depth_buffer);
+            sw_clear_depth_buffer_barycentric();
+        }
+
+        for (int i = 0; i < nb_triangles; ++i) {
+            fx32 t[3][9];
+            for (int j = 0; j < 3; ++j) {
+                const float* v = vertices[i][j];
+                fx32 vertex[9] = {FXS(v[0], SCALE_POS), FXS(v[1], SCALE_POS), FXS(v[2], SCALE_Z), FXS(v[3], SCALE_UV), FXS(v[4], SCALE_UV),
+                                  FXS(v[5], SCALE_COLOR), FXS(v[6], SCALE_COLOR), FXS(v[7], SCALE_COLOR), FXS(v[2], SCALE_COLOR)};
+                memcpy(t[j], vertex, sizeof(vertex));
+            }
+            draw_fixed_point_triangle(r, t, i % 5 == 0 ? NULL : texture, i % 3 == 0, i % 7 == 0);
+        }
+    }
+
+    FILE* file = fopen("fixed_point_" MODE_NAME ".bin", "wb");
+    if (file == NULL || fwrite(frames, sizeof(uint16_t), nb_rasterizers * fb_size, file) != nb_rasterizers * fb_size) {
+        printf("Could not write fixed_point_" MODE_NAME ".bin\n");
+        return 1;
+    }
+    fclose(file);
+
+    // error in levels of the 5-bit red and blue and of the 6-bit green
+    printf("%-12s %-10s %18s %8s %8s %8s\n", MODE_NAME " vs", "rasterizer", "differing pixels", "max r", "max g", "max b");
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        if (strcmp(modes[m], MODE_NAME) == 0)
+            continue;
+        char filename[64];
+        snprintf(filename, sizeof(filename), "fixed_point_%s.bin", modes[m]);
+        file = fopen(filename, "rb");
+        if (file == NULL)
+            continue;
+        size_t nb_read = fread(other, sizeof(uint16_t), nb_rasterizers * fb_size, file);
+        fclose(file);
+        if (nb_read != nb_rasterizers * fb_size)
+            continue;
+
+        for (int r = 0; r < nb_rasterizers; ++r) {
+            int nb_differing = 0, max_error[3] = {0, 0, 0};
+            for (size_t i = r * fb_size; i < (r + 1) * fb_size; ++i) {
+                if (frames[i] == other[i])
+                    continue;
+                nb_differing++;
+                int error[3] = {abs((frames[i] >> 11) - (other[i] >> 11)), abs(((frames[i] >> 5) & 0x3F) - ((other[i] >> 5) & 0x3F)),
+                                abs((frames[i] & 0x1F) - (other[i] & 0x1F))};
+                for (int c = 0; c < 3; ++c)
+                    if (error[c] > max_error[c])
+                        max_error[c] = error[c];
+            }
+            printf("%-12s %-10s %9d (%5.2f%%) %8d %8d %8d\n", modes[m], rasterizers[r], nb_differing, 100.0 * nb_differing / fb_size,
+                   max_error[0], max_error[1], max_error[2]);
+        }
+    }
+
+    free(vertices);
+    free(depth_buffer);
+    free(other);
+    free(frames);
+    return 0;
+}
+
+int bench_run(const char* name) {
+    if (strcmp(name, "transform") == 0)
+        return bench_transform();
+    if (strcmp(name, "scene") == 0)
+        return bench_scene();
+    if (strcmp(name, "geometry") == 0)
+        return bench_geometry();
+    if (strcmp(name, "coverage") == 0)
+        return bench_coverage();
+    if (strcmp(name, "span") == 0)
+        return bench_span();
+    if (strcmp(name, "specialize") == 0)
+        return bench_specialize();
+    if (strcmp(name, "fixed_point") == 0)
+        return bench_fixed_point();
+    if (strcmp(name, "persp_span") == 0)
+        return bench_persp_span();
+    if (strcmp(name, "depth") == 0)
+        return bench_depth();
+    if (strcmp(name, "hiz") == 0)
+        return bench_hiz();
+    if (strcmp(name, "mipmap") == 0)
+        return bench_mipmap();
+    if (strcmp(name, "texture_layout") == 0)
+        return bench_texture_layout();
+    if (strcmp(name, "bilinear") == 0)
+        return bench_bilinear();
+    if (strcmp(name, "texel_pack") == 0)
+        return bench_texel_pack();
+
+    printf("Unknown benchmark %s\n", name);
+    printf("Available benchmarks: transform, scene, geometry, coverage, span, specialize, fixed_point, persp_span, depth, hiz, mipmap, texture_layout, bilinear, texel_pack\n");
+    return 1;
+}
@@ -0,0 +1,25 @@
+// bench.h
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Run the named benchmark and print its results, returns the process exit code
+int bench_run(const char* name);
+
+// Cache misses of the calling thread from the hardware counters, the counter is -1 where they are not available
+int bench_cache_misses_open(void);
+uint64_t bench_cache_misses_read(int counter);
+void bench_cache_misses_close(int counter);
+
+int bench_scene(void);
+int bench_specialize(void);
+int bench_persp_span(void);
+int bench_depth(void);
+int bench_hiz(void);
+int bench_mipmap(void);
+
+#endif
@@ -0,0 +1,558 @@
+// bench_scene.cpp
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+extern "C" {
+#include "bench.h"
+#include "sw_rasterizer.h"
+#include "worker_pool.h"
+}
+
+#include <bvh.h>
+#include <camera.h>
+#include <plane.h>
+#include <scene.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <SDL.h>
+
+struct Box {
+    vec3d min, max;
+    int proxy;
+};
+
+static double elapsed_seconds(uint64_t start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+static float random_range(float a, float b) { return a + (b - a) * (float)rand() / (float)RAND_MAX; }
+
+static bool is_visible(const frustum_t* frustum, const Box& box) {
+    return frustum_test_aabb(frustum, &box.min, &box.max) != FRUSTUM_OUTSIDE;
+}
+
+int bench_scene(void) {
+    const int nb_frames = 20;
+
+    // camera on the ground looking along the runway
+    vec3d pos = {0.0f, 10.0f, -1000.0f, 1.0f};
+    vec3d target = {0.0f, 0.0f, 0.0f, 1.0f};
+    vec3d up = {0.0f, 1.0f, 0.0f, 1.0f};
+    mat4x4 mat_camera = matrix_point_at(&pos, &target, &up);
+    mat4x4 mat_view = matrix_quick_inverse(&mat_camera);
+    mat4x4 mat_proj = matrix_make_projection(320, 240, 60.0f);
+    mat4x4 mat_view_proj = matrix_multiply_matrix(&mat_view, &mat_proj);
+    frustum_t frustum = frustum_from_matrix(&mat_view_proj);
+
+    printf("%8s %10s %12s %12s %12s %10s\n", "entities", "visible", "linear (us)", "bvh (us)", "update (us)", "height");
+
+    for (int nb_entities = 10; nb_entities <= 100000; nb_entities *= 10) {
+        srand(1);
+
+        // entities spread over a 2 km square
+        std::vector<Box> boxes(nb_entities);
+        BVH bvh;
+        for (auto& box : boxes) {
+            vec3d c = {random_range(-1000.0f, 1000.0f), random_range(0.0f, 20.0f), random_range(-1000.0f, 1000.0f), 1.0f};
+            float s = random_range(0.5f, 5.0f);
+            box.min = {c.x - s, c.y - s, c.z - s, 1.0f};
+            box.max = {c.x + s, c.y + s, c.z + s, 1.0f};
+            box.proxy = bvh.insert(box.min, box.max, &box);
+        }
+
+        size_t nb_visible_linear = 0;
+        uint64_t start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < nb_frames; ++frame) {
+            nb_visible_linear = 0;
+            for (const auto& box : boxes)
+                if (is_visible(&frustum, box))
+                    nb_visible_linear++;
+        }
+        double t_linear = elapsed_seconds(start) / nb_frames;
+
+        size_t nb_visible_bvh = 0;
+        start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < nb_frames; ++frame) {
+            nb_visible_bvh = 0;
+            bvh.query(&frustum, [&](void* user_data, bool inside) {
+                if (inside || is_visible(&frustum, *static_cast<Box*>(user_data)))
+                    nb_visible_bvh++;
+            });
+        }
+        double t_bvh = elapsed_seconds(start) / nb_frames;
+
+        // one percent of the entities move every frame
+        start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < nb_frames; ++frame) {
+            for (int i = 0; i < (nb_entities + 99) / 100; ++i) {
+                Box& box = boxes[rand() % nb_entities];
+                float dx = random_range(-2.0f, 2.0f);
+                float dz = random_range(-2.0f, 2.0f);
+                box.min.x += dx;
+                box.max.x += dx;
+                box.min.z += dz;
+                box.max.z += dz;
+                bvh.move(box.proxy, box.min, box.max);
+            }
+        }
+        double t_update = elapsed_seconds(start) / nb_frames;
+
+        if (nb_visible_linear != nb_visible_bvh)
+            printf("Mismatch: %d visible with the linear traversal, %d with the BVH\n", (int)nb_visible_linear, (int)nb_visible_bvh);
+
+        printf("%8d %10d %12.1f %12.1f %12.1f %10d\n", nb_entities, (int)nb_visible_bvh, t_linear * 1e6, t_bvh * 1e6,
+               t_update * 1e6, bvh.get_height());
+    }
+
+    return 0;
+}
+
+extern int g_rasterizer_type;
+
+struct Asset {
+    const char* name;
+    std::shared_ptr<Entity> entity;
+};
+
+// Entities of the simulation scene, the camera follows the plane
+static std::vector<Asset> make_assets(std::shared_ptr<Plane>& plane) {
+    plane = std::make_shared<Plane>("f22.obj", "f22.png");
+    plane->m_position = {0.0f, 0.1f, -15.0f, 1.0f};
+    plane->update(0.0f);
+
+    auto runway = std::make_shared<Entity>("runway.obj", "runway.png");
+    runway->m_transform = matrix_make_translation(0.0f, -0.5f, 3.0f);
+
+    auto terrain = std::make_shared<Entity>("cube.obj", "cube.png");
+    auto s = matrix_make_scale(100.0f, 1.0f, 100.0f);
+    auto t = matrix_make_translation(0.0f, -2.1f, 0.0f);
+    terrain->m_transform = matrix_multiply_matrix(&s, &t);
+
+    auto tower = std::make_shared<Entity>("cube.obj", "cube.png");
+    s = matrix_make_scale(3.0f, 10.0f, 3.0f);
+    t = matrix_make_translation(10.0f, 10.0f, 0.0f);
+    tower->m_transform = matrix_multiply_matrix(&s, &t);
+
+    return {{"plane", plane}, {"runway", runway}, {"terrain", terrain}, {"tower", tower}};
+}
+
+// Frames of the simulation scene from the follow camera, with the generic span kernel testing the render
+// state on each pixel then with the kernels specialized for each render state
+int bench_specialize(void) {
+    const int nb_frames = 100;
+    const int fb_width = 320, fb_height = 240;
+
+    uint16_t* framebuffer = (uint16_t*)calloc(fb_width * fb_height, sizeof(uint16_t));
+    uint16_t* reference = (uint16_t*)malloc(fb_width * fb_height * sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_width * fb_height * sizeof(sw_depth_t));
+    sw_init_rasterizer_standard2(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_barycentric(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_tiled(fb_width, fb_height, framebuffer);
+    graphite_init(NULL, framebuffer, fb_width, fb_height);
+    worker_pool_init(SDL_GetCPUCount());
+    int rasterizer_type = g_rasterizer_type;
+
+    {
+        Camera camera(60.0f);
+        Scene scene;
+        std::shared_ptr<Plane> plane;
+        for (const auto& asset : make_assets(plane))
+            scene.add_entity(asset.entity);
+
+        camera.update(Camera::Views::FOLLOW, *plane, {13.0f, 20.0f, 0.0f});
+        light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+
+        static const struct {
+            const char* name;
+            int type;
+        } rasterizers[] = {{"standard2", 1}, {"barycentric", 2}, {"tiled", 3}};
+
+        printf("%-12s %14s %16s %8s\n", "rasterizer", "generic (us)", "specialized (us)", "speedup");
+
+        for (const auto& rasterizer : rasterizers) {
+            g_rasterizer_type = rasterizer.type;
+
+            double t_frame[2];
+            for (int specialize = 0; specialize < 2; ++specialize) {
+                sw_set_span_specialization(specialize != 0);
+                uint64_t start = SDL_GetPerformanceCounter();
+                for (int frame = 0; frame < nb_frames; ++frame) {
+                    clear(0x31A6);
+                    camera.begin_drawing();
+                    scene.draw(&camera, &light, 1);
+                    camera.end_drawing();
+                    if (rasterizer.type == 3)
+                        sw_flush_rasterizer_tiled();
+                }
+                t_frame[specialize] = elapsed_seconds(start) / nb_frames;
+                if (specialize == 0)
+                    memcpy(reference, framebuffer, fb_width * fb_height * sizeof(uint16_t));
+            }
+
+            bool identical = memcmp(reference, framebuffer, fb_width * fb_height * sizeof(uint16_t)) == 0;
+            printf("%-12s %14.1f %16.1f %8.2f%s\n", rasterizer.name, t_frame[0] * 1e6, t_frame[1] * 1e6,
+                   t_frame[0] / t_frame[1], identical ? "" : " (DIFFERENT frames)");
+        }
+    }
+
+    sw_set_span_specialization(true);
+    g_rasterizer_type = rasterizer_type;
+    worker_pool_dispose();
+    graphite_dispose();
+    sw_dispose_rasterizer_tiled();
+    free(depth_buffer);
+    free(reference);
+    free(framebuffer);
+    return 0;
+}
+
+// Each asset of the simulation scene alone from the follow camera with the standard2 rasterizer, shaded with
+// the exact perspective correction then with subdivided affine spans of increasing length. The error is the
+// texture coordinate error in texels against the exact correction, the pixels are compared to the exact frame.
+int bench_persp_span(void) {
+    const int nb_frames = 20;
+    const int nb_runs = 10;
+    const int fb_width = 320, fb_height = 240;
+    const int lengths[] = {0, 4, 8, 16, 32};
+
+    uint16_t* framebuffer = (uint16_t*)calloc(fb_width * fb_height, sizeof(uint16_t));
+    uint16_t* reference = (uint16_t*)malloc(fb_width * fb_height * sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_width * fb_height * sizeof(sw_depth_t));
+    sw_init_rasterizer_standard2(fb_width, fb_height, framebuffer, depth_buffer);
+    graphite_init(NULL, framebuffer, fb_width, fb_height);
+    int rasterizer_type = g_rasterizer_type;
+    int persp_span_length = sw_get_persp_span_length();
+    g_rasterizer_type = 1;
+
+    {
+        Camera camera(60.0f);
+        std::shared_ptr<Plane> plane;
+        std::vector<Asset> assets = make_assets(plane);
+        camera.update(Camera::Views::FOLLOW, *plane, {13.0f, 20.0f, 0.0f});
+        light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+
+        printf("%-8s %6s %11s %8s %16s %10s %10s\n", "asset", "length", "frame (us)", "speedup", "differing pixels",
+               "max error", "mean error");
+
+        for (const auto& asset : assets) {
+            Scene scene;
+            scene.add_entity(asset.entity);
+
+            auto draw = [&]() {
+                clear(0x31A6);
+                camera.begin_drawing();
+                scene.draw(&camera, &light, 1);
+                camera.end_drawing();
+            };
+
+            // best of the runs, the lengths alternate so that all of them see the same disturbances
+            const int nb_lengths = sizeof(lengths) / sizeof(lengths[0]);
+            double t_frames[nb_lengths];
+            for (int i = 0; i < nb_lengths; ++i)
+                t_frames[i] = INFINITY;
+            for (int run = 0; run < nb_runs; ++run) {
+                for (int i = 0; i < nb_lengths; ++i) {
+                    sw_set_persp_span_length(lengths[i]);
+                    uint64_t start = SDL_GetPerformanceCounter();
+                    for (int frame = 0; frame < nb_frames; ++frame)
+                        draw();
+                    t_frames[i] = std::min(t_frames[i], elapsed_seconds(start) / nb_frames);
+                }
+            }
+
+            double t_exact = t_frames[0];
+            for (int i = 0; i < nb_lengths; ++i) {
+                int length = lengths[i];
+                double t_frame = t_frames[i];
+                sw_set_persp_span_length(length);
+                draw();
+
+                if (length == 0) {
+                    memcpy(reference, framebuffer, fb_width * fb_height * sizeof(uint16_t));
+                    printf("%-8s %6s %11.1f\n", asset.name, "exact", t_frame * 1e6);
+                    continue;
+                }
+
+                int nb_differing = 0;
+                for (int i = 0; i < fb_width * fb_height; ++i)
+                    if (framebuffer[i] != reference[i])
+                        nb_differing++;
+
+                sw_persp_error_t error;
+                sw_reset_persp_error();
+                sw_measure_persp_error(true);
+                draw();
+                sw_measure_persp_error(false);
+                sw_get_persp_error(&error);
+
+                printf("%-8s %6d %11.1f %8.2f %9d (%5.2f%%) %10.3f %10.4f\n", asset.name, length, t_frame * 1e6,
+                       t_exact / t_frame, nb_differing, 100.0 * nb_differing / (fb_width * fb_height), error.max_error,
+                       error.nb_pixels ? error.sum_error / error.nb_pixels : 0.0);
+            }
+        }
+    }
+
+    sw_set_persp_span_length(persp_span_length);
+    g_rasterizer_type = rasterizer_type;
+    graphite_dispose();
+    free(depth_buffer);
+    free(reference);
+    free(framebuffer);
+    return 0;
+}
+
+// Frames of the simulation scene from the follow camera with the depth buffer format of the build (DEPTH_BITS),
+// with the cache misses of the frames where the hardware counters are available
+int bench_depth(void) {
+    const int nb_frames = 100;
+    const int nb_clears = 1000;
+    const int fb_width = 320, fb_height = 240;
+
+    uint16_t* framebuffer = (uint16_t*)calloc(fb_width * fb_height, sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_width * fb_height * sizeof(sw_depth_t));
+    sw_init_rasterizer_standard2(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_barycentric(fb_width, fb_height, framebuffer, depth_buffer);
+    graphite_init(NULL, framebuffer, fb_width, fb_height);
+    int rasterizer_type = g_rasterizer_type;
+    int counter = bench_cache_misses_open();
+
+    printf("Depth buffer of %d bits, %d KB\n", DEPTH_BITS, (int)(fb_width * fb_height * sizeof(sw_depth_t) / 1024));
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < nb_clears; ++i)
+        sw_clear_depth_buffer_standard2();
+    printf("Clear: %.2f us\n", elapsed_seconds(start) / nb_clears * 1e6);
+
+    {
+        Camera camera(60.0f);
+        Scene scene;
+        std::shared_ptr<Plane> plane;
+        for (const auto& asset : make_assets(plane))
+            scene.add_entity(asset.entity);
+        camera.update(Camera::Views::FOLLOW, *plane, {13.0f, 20.0f, 0.0f});
+        light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+
+        static const struct {
+            const char* name;
+            int type;
+        } rasterizers[] = {{"standard2", 1}, {"barycentric", 2}};
+
+        printf("%-12s %11s %20s\n", "rasterizer", "frame (us)", "cache misses/frame");
+
+        for (const auto& rasterizer : rasterizers) {
+            g_rasterizer_type = rasterizer.type;
+
+            uint64_t misses = bench_cache_misses_read(counter);
+            start = SDL_GetPerformanceCounter();
+            for (int frame = 0; frame < nb_frames; ++frame) {
+                clear(0x31A6);
+                camera.begin_drawing();
+                scene.draw(&camera, &light, 1);
+                camera.end_drawing();
+            }
+            double t_frame = elapsed_seconds(start) / nb_frames;
+            misses = bench_cache_misses_read(counter) - misses;
+
+            if (counter >= 0)
+                printf("%-12s %11.1f %20llu\n", rasterizer.name, t_frame * 1e6, (unsigned long long)(misses / nb_frames));
+            else
+                printf("%-12s %11.1f %20s\n", rasterizer.name, t_frame * 1e6, "n/a");
+        }
+    }
+
+    bench_cache_misses_close(counter);
+    g_rasterizer_type = rasterizer_type;
+    graphite_dispose();
+    free(depth_buffer);
+    free(framebuffer);
+    return 0;
+}
+
+// Frames of the simulation scene without then with the culling of the hierarchical Z, with the triangles and
+// the blocks of the barycentric rasterizer it culled in a frame. The follow camera draws the scene in the order
+// of its index, the camera behind the tower looks at the plane through it and draws the tower first.
+int bench_hiz(void) {
+    const int nb_frames = 20;
+    const int nb_runs = 10;
+    const int fb_width = 320, fb_height = 240;
+
+    uint16_t* framebuffer = (uint16_t*)calloc(fb_width * fb_height, sizeof(uint16_t));
+    uint16_t* reference = (uint16_t*)malloc(fb_width * fb_height * sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_width * fb_height * sizeof(sw_depth_t));
+    sw_init_rasterizer_standard(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_standard2(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_barycentric(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_hiz(fb_width, fb_height, depth_buffer);
+    graphite_init(NULL, framebuffer, fb_width, fb_height);
+    int rasterizer_type = g_rasterizer_type;
+
+    {
+        std::shared_ptr<Plane> plane;
+        std::vector<Asset> assets = make_assets(plane);
+        light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+
+        // the scenes of a view are drawn one after the other
+        struct View {
+            const char* name;
+            Camera camera;
+            std::vector<std::unique_ptr<Scene>> scenes;
+        };
+        View views[] = {{"follow", Camera(60.0f), {}}, {"tower", Camera(60.0f), {}}};
+        views[0].camera.update(Camera::Views::FOLLOW, *plane, {13.0f, 20.0f, 0.0f});
+        views[0].scenes.emplace_back(new Scene());
+        views[1].camera.update(Camera::Views::TOWER, *plane, {20.0f, 8.0f, 12.0f});
+        views[1].scenes.emplace_back(new Scene());
+        views[1].scenes.emplace_back(new Scene());
+        for (const auto& asset : assets) {
+            views[0].scenes[0]->add_entity(asset.entity);
+            views[1].scenes[strcmp(asset.name, "tower") == 0 ? 0 : 1]->add_entity(asset.entity);
+        }
+
+        static const struct {
+            const char* name;
+            int type;
+        } rasterizers[] = {{"standard", 0}, {"standard2", 1}, {"barycentric", 2}};
+
+        printf("%-12s %-7s %9s %9s %8s %18s %18s\n", "rasterizer", "view", "off (us)", "on (us)", "speedup",
+               "culled triangles", "culled blocks");
+
+        for (const auto& rasterizer : rasterizers) {
+            g_rasterizer_type = rasterizer.type;
+
+            for (auto& view : views) {
+                // best of the runs, off and on alternate so that both see the same disturbances
+                double t_frame[2] = {INFINITY, INFINITY};
+                sw_hiz_stats_t stats;
+                for (int run = 0; run < nb_runs; ++run) {
+                    for (int enabled = 0; enabled < 2; ++enabled) {
+                        sw_set_hiz(enabled != 0);
+                        uint64_t start = SDL_GetPerformanceCounter();
+                        for (int frame = 0; frame < nb_frames; ++frame) {
+                            sw_reset_stats_hiz();
+                            clear(0x31A6);
+                            view.camera.begin_drawing();
+                            for (const auto& scene : view.scenes)
+                                scene->draw(&view.camera, &light, 1);
+                            view.camera.end_drawing();
+                        }
+                        t_frame[enabled] = std::min(t_frame[enabled], elapsed_seconds(start) / nb_frames);
+                        sw_get_stats_hiz(&stats);
+                        if (enabled == 0)
+                            memcpy(reference, framebuffer, fb_width * fb_height * sizeof(uint16_t));
+                    }
+                }
+
+                bool identical = memcmp(reference, framebuffer, fb_width * fb_height * sizeof(uint16_t)) == 0;
+                printf("%-12s %-7s %9.1f %9.1f %8.2f %8llu / %7llu %8llu / %7llu%s\n", rasterizer.name, view.name,
+                       t_frame[0] * 1e6, t_frame[1] * 1e6, t_frame[0] / t_frame[1],
+                       (unsigned long long)stats.nb_culled_triangles, (unsigned long long)stats.nb_triangles,
+                       (unsigned long long)stats.nb_culled_blocks, (unsigned long long)stats.nb_blocks,
+                       identical ? "" : " (DIFFERENT frames)");
+            }
+        }
+    }
+
+    sw_set_hiz(false);
+    g_rasterizer_type = rasterizer_type;
+    graphite_dispose();
+    sw_dispose_hiz();
+    free(depth_buffer);
+    free(reference);
+    free(framebuffer);
+    return 0;
+}
+
+// Frames of the simulation scene sampling the base level of the textures then their mip levels, with the
+// cache misses of the frames where the hardware counters are available and the pixels changed by the filtering.
+// From the tower the runway is a few pixels high, from the follow camera it recedes from under the plane.
+int bench_mipmap(void) {
+    const int nb_frames = 100;
+    const int fb_width = 320, fb_height = 240;
+
+    uint16_t* framebuffer = (uint16_t*)calloc(fb_width * fb_height, sizeof(uint16_t));
+    uint16_t* reference = (uint16_t*)malloc(fb_width * fb_height * sizeof(uint16_t));
+    sw_depth_t* depth_buffer = (sw_depth_t*)malloc(fb_width * fb_height * sizeof(sw_depth_t));
+    sw_init_rasterizer_standard(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_standard2(fb_width, fb_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_barycentric(fb_width, fb_height, framebuffer, depth_buffer);
+    graphite_init(NULL, framebuffer, fb_width, fb_height);
+    int rasterizer_type = g_rasterizer_type;
+    int counter = bench_cache_misses_open();
+
+    {
+        Scene scene;
+        std::shared_ptr<Plane> plane;
+        for (const auto& asset : make_assets(plane))
+            scene.add_entity(asset.entity);
+        light_t light = {{0.0f, -1.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.1f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+
+        struct View {
+            const char* name;
+            Camera camera;
+        };
+        View views[] = {{"follow", Camera(60.0f)}, {"tower", Camera(60.0f)}};
+        views[0].camera.update(Camera::Views::FOLLOW, *plane, {13.0f, 20.0f, 0.0f});
+        views[1].camera.update(Camera::Views::TOWER, *plane, {20.0f, 8.0f, 12.0f});
+
+        static const struct {
+            const char* name;
+            int type;
+        } rasterizers[] = {{"standard", 0}, {"standard2", 1}, {"barycentric", 2}};
+
+        printf("%-12s %-7s %9s %9s %8s %14s %14s %16s\n", "rasterizer", "view", "base (us)", "mip (us)", "speedup",
+               "base misses", "mip misses", "differing pixels");
+
+        for (const auto& rasterizer : rasterizers) {
+            g_rasterizer_type = rasterizer.type;
+
+            for (auto& view : views) {
+                double t_frame[2];
+                uint64_t misses[2];
+                for (int enabled = 0; enabled < 2; ++enabled) {
+                    sw_set_mipmap(enabled != 0);
+                    misses[enabled] = bench_cache_misses_read(counter);
+                    uint64_t start = SDL_GetPerformanceCounter();
+                    for (int frame = 0; frame < nb_frames; ++frame) {
+                        clear(0x31A6);
+                        view.camera.begin_drawing();
+                        scene.draw(&view.camera, &light, 1);
+                        view.camera.end_drawing();
+                    }
+                    t_frame[enabled] = elapsed_seconds(start) / nb_frames;
+                    misses[enabled] = (bench_cache_misses_read(counter) - misses[enabled]) / nb_frames;
+                    if (enabled == 0)
+                        memcpy(reference, framebuffer, fb_width * fb_height * sizeof(uint16_t));
+                }
+
+                int nb_differing = 0;
+                for (int i = 0; i < fb_width * fb_height; ++i)
+                    if (framebuffer[i] != reference[i])
+                        nb_differing++;
+
+                printf("%-12s %-7s %9.1f %9.1f %8.2f ", rasterizer.name, view.name, t_frame[0] * 1e6, t_frame[1] * 1e6,
+                       t_frame[0] / t_frame[1]);
+                if (counter >= 0)
+                    printf("%14llu %14llu", (unsigned long long)misses[0], (unsigned long long)misses[1]);
+                else
+                    printf("%14s %14s", "n/a", "n/a");
+                printf(" %9d (%5.2f%%)\n", nb_differing, 100.0 * nb_differing / (fb_width * fb_height));
+            }
+        }
+    }
+
+    sw_set_mipmap(true);
+    bench_cache_misses_close(counter);
+    g_rasterizer_type = rasterizer_type;
+    graphite_dispose();
+    free(depth_buffer);
+    free(reference);
+    free(framebuffer);
+    return 0;
+}
@@ -17,26 +17,43 @@
 #include "upng.h"
 
 static SDL_Renderer* g_renderer;
+static SDL_Texture* g_texture;
+static uint16_t* g_framebuffer;
 static int g_fb_width, g_fb_height;
+static bool g_swizzle_textures;
 
 //bool g_rasterizer_barycentric = true;
 extern int g_rasterizer_type;
 void draw_triangle(vec3d p[3], vec2d t[3], vec3d c[3], texture_t* tex, bool clamp_s, bool clamp_t,
                       bool depth_test, bool perspective_correct)
 {
-    if (g_rasterizer_type == 2) {
-        sw_draw_triangle_barycentric(FX(p[0].x), FX(p[0].y), FX(t[0].w), FX(t[0].u), FX(t[0].v), FX(c[0].x), FX(c[0].y), FX(c[0].z), FX(c[0].w), FX(p[1].x), FX(p[1].y), FX(t[1].w), FX(t[1].u), FX(t[1].v), FX(c[1].x), FX(c[1].y), FX(c[1].z), FX(c[1].w), FX(p[2].x), FX(p[2].y), FX(t[2].w), FX(t[2].u), FX(t[2].v), FX(c[2].x), FX(c[2].y), FX(c[2].z), FX(c[2].w), tex->addr, tex->scale_x, tex->scale_y, clamp_s, clamp_t, depth_test, perspective_correct);
+    if (g_rasterizer_type < 0) {
+        return;
+    } else if (g_rasterizer_type == 3) {
+        sw_draw_triangle_tiled(FXS(p[0].x, SCALE_POS), FXS(p[0].y, SCALE_POS), FXS(t[0].w, SCALE_Z), FXS(t[0].u, SCALE_UV), FXS(t[0].v, SCALE_UV), FXS(c[0].x, SCALE_COLOR), FXS(c[0].y, SCALE_COLOR), FXS(c[0].z, SCALE_COLOR), FXS(c[0].w, SCALE_COLOR), FXS(p[1].x, SCALE_POS), FXS(p[1].y, SCALE_POS), FXS(t[1].w, SCALE_Z), FXS(t[1].u, SCALE_UV), FXS(t[1].v, SCALE_UV), FXS(c[1].x, SCALE_COLOR), FXS(c[1].y, SCALE_COLOR), FXS(c[1].z, SCALE_COLOR), FXS(c[1].w, SCALE_COLOR), FXS(p[2].x, SCALE_POS), FXS(p[2].y, SCALE_POS), FXS(t[2].w, SCALE_Z), FXS(t[2].u, SCALE_UV), FXS(t[2].v, SCALE_UV), FXS(c[2].x, SCALE_COLOR), FXS(c[2].y, SCALE_COLOR), FXS(c[2].z, SCALE_COLOR), FXS(c[2].w, SCALE_COLOR), tex->addr, tex->scale_x, tex->scale_y, tex->nb_levels, tex->swizzled, clamp_s, clamp_t, depth_test, perspective_correct);
+    } else if (g_rasterizer_type == 2) {
+        sw_draw_triangle_barycentric(FXS(p[0].x, SCALE_POS), FXS(p[0].y, SCALE_POS), FXS(t[0].w, SCALE_Z), FXS(t[0].u, SCALE_UV), FXS(t[0].v, SCALE_UV), FXS(c[0].x, SCALE_COLOR), FXS(c[0].y, SCALE_COLOR), FXS(c[0].z, SCALE_COLOR), FXS(c[0].w, SCALE_COLOR), FXS(p[1].x, SCALE_POS), FXS(p[1].y, SCALE_POS), FXS(t[1].w, SCALE_Z), FXS(t[1].u, SCALE_UV), FXS(t[1].v, SCALE_UV), FXS(c[1].x, SCALE_COLOR), FXS(c[1].y, SCALE_COLOR), FXS(c[1].z, SCALE_COLOR), FXS(c[1].w, SCALE_COLOR), FXS(p[2].x, SCALE_POS), FXS(p[2].y, SCALE_POS), FXS(t[2].w, SCALE_Z), FXS(t[2].u, SCALE_UV), FXS(t[2].v, SCALE_UV), FXS(c[2].x, SCALE_COLOR), FXS(c[2].y, SCALE_COLOR), FXS(c[2].z, SCALE_COLOR), FXS(c[2].w, SCALE_COLOR), tex->addr, tex->scale_x, tex->scale_y, tex->nb_levels, tex->swizzled, clamp_s, clamp_t, depth_test, perspective_correct);
     } else if (g_rasterizer_type == 1) {
-        sw_draw_triangle_standard2(FX(p[0].x), FX(p[0].y), FX(t[0].w), FX(t[0].u), FX(t[0].v), FX(c[0].x), FX(c[0].y), FX(c[0].z), FX(c[0].w), FX(p[1].x), FX(p[1].y), FX(t[1].w), FX(t[1].u), FX(t[1].v), FX(c[1].x), FX(c[1].y), FX(c[1].z), FX(c[1].w), FX(p[2].x), FX(p[2].y), FX(t[2].w), FX(t[2].u), FX(t[2].v), FX(c[2].x), FX(c[2].y), FX(c[2].z), FX(c[2].w), tex->addr, tex->scale_x, tex->scale_y, clamp_s, clamp_t, depth_test, perspective_correct);
+        sw_draw_triangle_standard2(FXS(p[0].x, SCALE_POS), FXS(p[0].y, SCALE_POS), FXS(t[0].w, SCALE_Z), FXS(t[0].u, SCALE_UV), FXS(t[0].v, SCALE_UV), FXS(c[0].x, SCALE_COLOR), FXS(c[0].y, SCALE_COLOR), FXS(c[0].z, SCALE_COLOR), FXS(c[0].w, SCALE_COLOR), FXS(p[1].x, SCALE_POS), FXS(p[1].y, SCALE_POS), FXS(t[1].w, SCALE_Z), FXS(t[1].u, SCALE_UV), FXS(t[1].v, SCALE_UV), FXS(c[1].x, SCALE_COLOR), FXS(c[1].y, SCALE_COLOR), FXS(c[1].z, SCALE_COLOR), FXS(c[1].w, SCALE_COLOR), FXS(p[2].x, SCALE_POS), FXS(p[2].y, SCALE_POS), FXS(t[2].w, SCALE_Z), FXS(t[2].u, SCALE_UV), FXS(t[2].v, SCALE_UV), FXS(c[2].x, SCALE_COLOR), FXS(c[2].y, SCALE_COLOR), FXS(c[2].z, SCALE_COLOR), FXS(c[2].w, SCALE_COLOR), tex->addr, tex->scale_x, tex->scale_y, tex->nb_levels, tex->swizzled, clamp_s, clamp_t, depth_test, perspective_correct);
     } else {
-        sw_draw_triangle_standard(FX(p[0].x), FX(p[0].y), FX(t[0].w), FX(t[0].u), FX(t[0].v), FX(c[0].x), FX(c[0].y), FX(c[0].z), FX(c[0].w), FX(p[1].x), FX(p[1].y), FX(t[1].w), FX(t[1].u), FX(t[1].v), FX(c[1].x), FX(c[1].y), FX(c[1].z), FX(c[1].w), FX(p[2].x), FX(p[2].y), FX(t[2].w), FX(t[2].u), FX(t[2].v), FX(c[2].x), FX(c[2].y), FX(c[2].z), FX(c[2].w), tex->addr, tex->scale_x, tex->scale_y, clamp_s, clamp_t, depth_test, perspective_correct);
+        sw_draw_triangle_standard(FXS(p[0].x, SCALE_POS), FXS(p[0].y, SCALE_POS), FXS(t[0].w, SCALE_Z), FXS(t[0].u, SCALE_UV), FXS(t[0].v, SCALE_UV), FXS(c[0].x, SCALE_COLOR), FXS(c[0].y, SCALE_COLOR), FXS(c[0].z, SCALE_COLOR), FXS(c[0].w, SCALE_COLOR), FXS(p[1].x, SCALE_POS), FXS(p[1].y, SCALE_POS), FXS(t[1].w, SCALE_Z), FXS(t[1].u, SCALE_UV), FXS(t[1].v, SCALE_UV), FXS(c[1].x, SCALE_COLOR), FXS(c[1].y, SCALE_COLOR), FXS(c[1].z, SCALE_COLOR), FXS(c[1].w, SCALE_COLOR), FXS(p[2].x, SCALE_POS), FXS(p[2].y, SCALE_POS), FXS(t[2].w, SCALE_Z), FXS(t[2].u, SCALE_UV), FXS(t[2].v, SCALE_UV), FXS(c[2].x, SCALE_COLOR), FXS(c[2].y, SCALE_COLOR), FXS(c[2].z, SCALE_COLOR), FXS(c[2].w, SCALE_COLOR), tex->addr, tex->scale_x, tex->scale_y, tex->nb_levels, tex->swizzled, clamp_s, clamp_t, depth_test, perspective_correct);
     }
 }
 
-void graphite_init(SDL_Renderer* renderer, int fb_width, int fb_height) {
+void graphite_init(SDL_Renderer* renderer, uint16_t* framebuffer, int fb_width, int fb_height) {
     g_renderer = renderer;
+    g_framebuffer = framebuffer;
     g_fb_width = fb_width;
     g_fb_height = fb_height;
+    // without a renderer, the frames are only drawn into the framebuffer
+    if (renderer != NULL)
+        g_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB565, SDL_TEXTUREACCESS_STREAMING, fb_width, fb_height);
+}
+
+void graphite_dispose(void) {
+    if (g_texture != NULL)
+        SDL_DestroyTexture(g_texture);
+    g_texture = NULL;
 }
 
 void get_fb_dimensions(int* fb_width, int* fb_height) {
@@ -45,20 +62,11 @@ void get_fb_dimensions(int* fb_width, int* fb_height) {
 }
 
 void clear(unsigned int color) {
-
-    // Constants taken from https://stackoverflow.com/a/9069480
-
-    int r5 = color >> 11;
-    int g6 = (color >> 5) & 0x3F;
-    int b5 = color & 0x1F;
-
-    int r = (r5 * 527 + 23) >> 6;
-    int g = (g6 * 259 + 33) >> 6;
-    int b = (b5 * 527 + 23) >> 6;
-
-    SDL_SetRenderDrawColor(g_renderer, r, g, b, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(g_renderer);
-    if (g_rasterizer_type == 2)
+    for (int i = 0; i < g_fb_width * g_fb_height; ++i)
+        g_framebuffer[i] = (uint16_t)color;
+    if (g_rasterizer_type == 3)
+        sw_clear_depth_buffer_tiled();
+    else if (g_rasterizer_type == 2)
         sw_clear_depth_buffer_barycentric();
     else if (g_rasterizer_type == 1) {
         sw_clear_depth_buffer_standard2();
@@ -68,6 +76,12 @@ void clear(unsigned int color) {
 }
 
 void swap(void) {
+    if (g_rasterizer_type == 3)
+        sw_flush_rasterizer_tiled();
+
+    // upload the RGB565 framebuffer, SDL converts and scales it
+    SDL_UpdateTexture(g_texture, NULL, g_framebuffer, g_fb_width * sizeof(uint16_t));
+    SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
     SDL_RenderPresent(g_renderer);
 }
 
@@ -155,10 +169,24 @@ bool load_model(model_t *model, const char *obj_filename) {
         printf("Unable to load the model %s\n", path);
         return false;
     }
-    model->triangles_to_raster = (triangle_t *)malloc(2 * model->mesh.nb_faces * sizeof(triangle_t));
+    init_model(model);
     return true;
 }
 
+void init_model(model_t *model) {
+    model->mesh.face_planes = (vec3d *)malloc(model->mesh.nb_faces * sizeof(vec3d));
+    mesh_compute_face_planes(&model->mesh);
+    mesh_compute_bounds(&model->mesh);
+    model->triangles_to_raster = (triangle_t *)malloc(MAX_CLIPPED_TRIANGLES * model->mesh.nb_faces * sizeof(triangle_t));
+    model->clip_vertices = (vec3d *)malloc(model->mesh.nb_vertices * sizeof(vec3d));
+    model->normal_colors = (vec3d *)malloc(model->mesh.nb_normals * sizeof(vec3d));
+    model->used_normals = (bool *)malloc(model->mesh.nb_normals * sizeof(bool));
+    model->used_vertices = (bool *)malloc(model->mesh.nb_vertices * sizeof(bool));
+    model->front_faces = (size_t *)malloc(model->mesh.nb_faces * sizeof(size_t));
+}
+
+void set_texture_swizzle(bool enabled) { g_swizzle_textures = enabled; }
+
 bool load_texture(texture_t *texture, const char *tex_filename) {
     char path[128];
     snprintf(path, sizeof(path), "../../assets/%s", tex_filename);
@@ -192,7 +220,9 @@ bool load_texture(texture_t *texture, const char *tex_filename) {
 
     uint32_t* texture_buffer = (uint32_t *)upng_get_buffer(png_image);
 
-    texture->addr = malloc(texture_width * texture_height * sizeof(uint16_t));
+    // the mip chain follows the base level
+    texture->nb_levels = sw_mip_nb_levels(texture->scale_x, texture->scale_y);
+    texture->addr = malloc(sw_mip_chain_size(texture->scale_x, texture->scale_y) * sizeof(uint16_t));
     uint16_t* tex = texture->addr;
     for (int t = 0; t < texture_height; ++t)
         for (int s = 0; s < texture_width; ++s) {
@@ -208,5 +238,10 @@ bool load_texture(texture_t *texture, const char *tex_filename) {
 
     upng_free(png_image);
 
+    sw_build_mip_chain(texture->addr, texture->scale_x, texture->scale_y);
+    texture->swizzled = g_swizzle_textures;
+    if (texture->swizzled)
+        sw_swizzle_mip_chain(texture->addr, texture->scale_x, texture->scale_y);
+
     return true;
 }
@@ -14,11 +14,18 @@
 
 #include <SDL.h>
 
-void graphite_init(SDL_Renderer* renderer, int fb_width, int fb_height);
+// The rasterizers draw into framebuffer, an RGB565 buffer of fb_width x fb_height pixels shown by swap().
+// The renderer may be NULL to draw without presenting the frames, swap() must not be called then.
+void graphite_init(SDL_Renderer* renderer, uint16_t* framebuffer, int fb_width, int fb_height);
+void graphite_dispose(void);
 void get_fb_dimensions(int* fb_width, int* fb_height);
 
 bool load_model(model_t *model, const char *obj_filename);
+// Compute the mesh data and allocate the buffers of a model whose mesh is filled
+void init_model(model_t *model);
 bool load_texture(texture_t *texture, const char *tex_filename);
+// Store the textures loaded afterwards in 4x4 texel tiles instead of rows, see sw_texel_index()
+void set_texture_swizzle(bool enabled);
 
 void clear(unsigned int color);
 void swap(void);
@@ -1,9 +1,13 @@
 #include <SDL.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 extern "C" {
 #include "sw_rasterizer.h"
 #include "graphite.h"
+#include "bench.h"
+#include "worker_pool.h"
 }
 
 #include <sim.h>
@@ -13,30 +17,46 @@ static int screen_height = 240;
 static int screen_scale = 3;
 
 static SDL_Renderer* renderer;
+static uint16_t* framebuffer;
+static sw_depth_t* depth_buffer;
 
-// 0: standard, 1: standard2, 2: barycentric
+// -1: none (geometry only), 0: standard, 1: standard2, 2: barycentric, 3: tiled
 int g_rasterizer_type = 1;
 
-void draw_pixel(int x, int y, int color) {
-
-    // Constants taken from https://stackoverflow.com/a/9069480
-
-    int r5 = color >> 11;
-    int g6 = (color >> 5) & 0x3F;
-    int b5 = color & 0x1F;
-
-    int r = (r5 * 527 + 23) >> 6;
-    int g = (g6 * 259 + 33) >> 6;
-    int b = (b5 * 527 + 23) >> 6;
-
-    SDL_SetRenderDrawColor(renderer, r, g, b, SDL_ALPHA_OPAQUE);
-    SDL_RenderDrawPoint(renderer, x, y);
-}
-
-int main() {
-    sw_init_rasterizer_standard(screen_width, screen_height, draw_pixel);
-    sw_init_rasterizer_standard2(screen_width, screen_height, draw_pixel);
-    sw_init_rasterizer_barycentric(screen_width, screen_height, draw_pixel);
+int main(int argc, char* argv[]) {
+    // program [--threads <n>] [--persp-span <length>] [--mipmap <0|1>] [--swizzle <0|1>] [--bilinear <0|1>] [--hiz <0|1>]
+    //         [--bench <name>]
+    int nb_threads = SDL_GetCPUCount();
+    const char* bench_name = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--threads") == 0)
+            nb_threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--persp-span") == 0)
+            sw_set_persp_span_length(atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--mipmap") == 0)
+            sw_set_mipmap(atoi(argv[i + 1]) != 0);
+        else if (strcmp(argv[i], "--swizzle") == 0)
+            set_texture_swizzle(atoi(argv[i + 1]) != 0);
+        else if (strcmp(argv[i], "--bilinear") == 0)
+            sw_set_bilinear(atoi(argv[i + 1]) != 0);
+        else if (strcmp(argv[i], "--hiz") == 0)
+            sw_set_hiz(atoi(argv[i + 1]) != 0);
+        else if (strcmp(argv[i], "--bench") == 0)
+            bench_name = argv[i + 1];
+    }
+    if (bench_name != NULL)
+        return bench_run(bench_name);
+
+    worker_pool_init(nb_threads);
+    set_parallel_run(worker_pool_run, worker_pool_get_nb_threads());
+
+    framebuffer = (uint16_t*)calloc(screen_width * screen_height, sizeof(uint16_t));
+    depth_buffer = (sw_depth_t*)calloc(screen_width * screen_height, sizeof(sw_depth_t));
+    sw_init_rasterizer_standard(screen_width, screen_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_standard2(screen_width, screen_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_barycentric(screen_width, screen_height, framebuffer, depth_buffer);
+    sw_init_rasterizer_tiled(screen_width, screen_height, framebuffer);
+    sw_init_hiz(screen_width, screen_height, depth_buffer);
 
     SDL_Init(SDL_INIT_VIDEO);
 
@@ -49,16 +69,20 @@ int main() {
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
     SDL_RenderSetScale(renderer, (float)screen_scale, (float)screen_scale);
 
-    graphite_init(renderer, screen_width, screen_height);
+    graphite_init(renderer, framebuffer, screen_width, screen_height);
 
     sim_run(&g_rasterizer_type);
 
+    graphite_dispose();
     SDL_DestroyWindow(window);
     SDL_Quit();
 
-    sw_dispose_rasterizer_barycentric();
-    sw_dispose_rasterizer_standard2();
-    sw_dispose_rasterizer_standard();
+    worker_pool_dispose();
+
+    sw_dispose_rasterizer_tiled();
+    sw_dispose_hiz();
+    free(depth_buffer);
+    free(framebuffer);
 
     return 0;
 }
@@ -6,97 +6,345 @@
 #define TEXTURE_WIDTH   32
 #define TEXTURE_HEIGHT  32
 
+// Factors of the r, g, b attributes to the RGB565 channels, the texel channels scaled by 31, 63 and 31
 typedef struct {
-    fx32 r, g, b, a;
+    fx32 r, g, b;
 } color_t;
 
+// The 4-bit texel channel c scaled to the max of an RGB565 channel, c * max / 15. A constant expression,
+// the DIVS of the 32-bit mode is a routine.
+#define TEXEL_CHANNEL(c, max) ((fx32)(FXIS((c) * (max), SCALE_COLOR) / 15))
+#define TEXEL_CHANNELS(max) \
+    {TEXEL_CHANNEL(0, max), TEXEL_CHANNEL(1, max), TEXEL_CHANNEL(2, max), TEXEL_CHANNEL(3, max), \
+     TEXEL_CHANNEL(4, max), TEXEL_CHANNEL(5, max), TEXEL_CHANNEL(6, max), TEXEL_CHANNEL(7, max), \
+     TEXEL_CHANNEL(8, max), TEXEL_CHANNEL(9, max), TEXEL_CHANNEL(10, max), TEXEL_CHANNEL(11, max), \
+     TEXEL_CHANNEL(12, max), TEXEL_CHANNEL(13, max), TEXEL_CHANNEL(14, max), TEXEL_CHANNEL(15, max)}
+
+static const fx32 g_texel_5bits[16] = TEXEL_CHANNELS(31);
+static const fx32 g_texel_6bits[16] = TEXEL_CHANNELS(63);
+
+static bool g_bilinear = false;
+
+// pixels of a group of the bilinear kernels, see shade_span_bilinear()
+#define FILTER_CHUNK    16
+
+// The same of each blend step of the bilinear filtering, step 16 * c is the channel c
+static fx32 g_filter_5bits[SW_FILTER_STEPS + 1];
+static fx32 g_filter_6bits[SW_FILTER_STEPS + 1];
+
 #define RECIPROCAL_NUMERATOR 1.0f
-static fx32 reciprocal(fx32 x) { return x > 0 ? DIV(FX(RECIPROCAL_NUMERATOR), x) : FX(RECIPROCAL_NUMERATOR); }
+// w at SCALE_W from the depth z at SCALE_Z
+static fx32 reciprocal(fx32 x) { return x > 0 ? DIVS(FXS(RECIPROCAL_NUMERATOR, SCALE_W), x, SCALE_Z) : FXS(RECIPROCAL_NUMERATOR, SCALE_W); }
+
+// Texel index of the coordinate t in [0, 1], the size at SCALE_UV would not fit the 32-bit mode
+static int texel_index(fx32 t, int size) {
+#if FIXED_POINT
+    return (int)_FIXED_TO_INT((int64_t)t * size, SCALE_UV);
+#else
+    return (int)(t * size);
+#endif
+}
 
-color_t texture_sample_color(const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, fx32 u, fx32 v) {
+static color_t texture_sample_color(const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool swizzled, fx32 u, fx32 v) {
     int tex_width = TEXTURE_WIDTH << tex_scale_x;
     int tex_height = TEXTURE_HEIGHT << tex_scale_y;
 
-    if (tex_addr != NULL) {
-        int x = INT(MUL(u, FXI(tex_width)));
-        int y = INT(MUL(v, FXI(tex_height)));
-        if (x >= tex_width) x = tex_width - 1;
-        if (y >= tex_height) y = tex_height - 1;
-        uint16_t c = tex_addr[y * tex_width + x];
-        uint8_t a = (c >> 12) & 0xF;
-        uint8_t r = (c >> 8) & 0xF;
-        uint8_t g = (c >> 4) & 0xF;
-        uint8_t b = c & 0xF;
-
-        return (color_t){DIV(FXI(r), FXI(15)), DIV(FXI(g), FXI(15)), DIV(FXI(b), FXI(15)), DIV(FXI(a), FXI(15))};
+    int x = texel_index(u, tex_width);
+    int y = texel_index(v, tex_height);
+    if (x >= tex_width) x = tex_width - 1;
+    if (y >= tex_height) y = tex_height - 1;
+    uint16_t c = tex_addr[sw_texel_index(x, y, tex_scale_x, swizzled)];
+    return (color_t){g_texel_5bits[(c >> 8) & 0xF], g_texel_6bits[(c >> 4) & 0xF], g_texel_5bits[c & 0xF]};
+}
+
+const fx32* sw_get_texel_channels(int bits) { return bits == 6 ? g_texel_6bits : g_texel_5bits; }
+
+void sw_set_bilinear(bool enabled) {
+    g_bilinear = enabled;
+    for (int i = 0; i <= SW_FILTER_STEPS; ++i) {
+        g_filter_5bits[i] = DIVS(FXIS(i * 31, SCALE_COLOR), FXIS(SW_FILTER_STEPS, SCALE_COLOR), SCALE_COLOR);
+        g_filter_6bits[i] = DIVS(FXIS(i * 63, SCALE_COLOR), FXIS(SW_FILTER_STEPS, SCALE_COLOR), SCALE_COLOR);
+    }
+}
+
+// Position of the coordinate t in [0, 1] in 1/16 of texels from the center of the first texel, the texel
+// centers are at half texels
+static inline int filter_position(fx32 t, int size) {
+#if FIXED_POINT
+    return (int)_FIXED_TO_INT((int64_t)t * (size << 4), SCALE_UV) - 8;
+#else
+    return (int)(t * (float)(size << 4)) - 8;
+#endif
+}
+
+// Texels i0 and i1 around the position s and the weight of i1 in 1/16
+static inline void filter_texels(int s, int size, bool clamp, int* i0, int* i1, int* frac) {
+    int i = s >> 4;
+    *frac = s & 15;
+    if (clamp) {
+        *i0 = i < 0 ? 0 : i;
+        *i1 = i + 1 < size ? i + 1 : size - 1;
+    } else {
+        *i0 = i & (size - 1);
+        *i1 = (i + 1) & (size - 1);
     }
-    return (color_t){FX(1.0f), FX(1.0f), FX(1.0f), FX(1.0f)};
+}
+
+// The 4-bit channels of an ARGB4444 texel in the 8-bit lanes b, r, g, a, wide enough for a blend of 2 texels
+static inline uint32_t spread_channels(uint16_t c) { return (c & 0x0F0F) | ((uint32_t)(c & 0xF0F0) << 12); }
+
+// Blend of the texels c0 and c1 with the weight w1 in 1/16, the lanes b, g, r, a of 16 bits of the result are
+// wide enough for a blend of 2 of them
+static inline uint64_t blend_texels(uint16_t c0, uint16_t c1, int w1) {
+    uint32_t c = spread_channels(c0) * (uint32_t)(16 - w1) + spread_channels(c1) * (uint32_t)w1;
+    return (c & 0x00FF00FF) | ((uint64_t)(c & 0xFF00FF00) << 24);
+}
+
+static inline __attribute__((always_inline)) color_t texture_sample_bilinear(const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool swizzled, bool clamp_s, bool clamp_t, fx32 u, fx32 v) {
+    int x0, x1, fx, y0, y1, fy;
+    filter_texels(filter_position(u, TEXTURE_WIDTH << tex_scale_x), TEXTURE_WIDTH << tex_scale_x, clamp_s, &x0, &x1, &fx);
+    filter_texels(filter_position(v, TEXTURE_HEIGHT << tex_scale_y), TEXTURE_HEIGHT << tex_scale_y, clamp_t, &y0, &y1, &fy);
+
+    uint16_t t[4];
+    sw_fetch_footprint(tex_addr, sw_texel_index(x0, y0, tex_scale_x, swizzled), sw_texel_index(x1, y0, tex_scale_x, swizzled),
+                       sw_texel_index(x0, y1, tex_scale_x, swizzled), sw_texel_index(x1, y1, tex_scale_x, swizzled), t);
+
+    // the rows then the columns, each lane sums to at most 15 * 256
+    uint64_t sum = blend_texels(t[0], t[1], fx) * (uint64_t)(16 - fy) + blend_texels(t[2], t[3], fx) * (uint64_t)fy;
+    return (color_t){g_filter_5bits[(((sum >> 32) & 0xFFFF) + 8) >> 4], g_filter_6bits[(((sum >> 16) & 0xFFFF) + 8) >> 4],
+                     g_filter_5bits[((sum & 0xFFFF) + 8) >> 4]};
 }
 
 static fx32 clamp(fx32 v) {
-    if (v < FX(0.0f)) {
-        v = FX(0.0f);
-    } else if (v > FX(1.0f)) {
-        v = FX(1.0f);
+    if (v < FXS(0.0f, SCALE_UV)) {
+        v = FXS(0.0f, SCALE_UV);
+    } else if (v > FXS(1.0f, SCALE_UV)) {
+        v = FXS(1.0f, SCALE_UV);
     }
     return v;
 }
 
 static fx32 wrap(fx32 v) {
-    if (v < FX(0.0f)) {
-        v = FX(0.0f);
-    } else if (v >= FX(1.0f)) {
+    if (v < FXS(0.0f, SCALE_UV)) {
+        v = FXS(0.0f, SCALE_UV);
+    } else if (v >= FXS(1.0f, SCALE_UV)) {
 #if FIXED_POINT
-        v = v & _FRACTION_MASK(SCALE);
+        v = v & _FRACTION_MASK(SCALE_UV);
 #else
-        v = FX(fmod(FLT(v), 1.0f));
+        v = fmod(v, 1.0f);
 #endif
     }
     return v;
 }
 
-void sw_fragment_shader(int fb_width, int fb_height, int x, int y, fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, fx32* depth_buffer, bool persp_correct, draw_pixel_fn_t draw_pixel_fn) {
-    if (x < 0 || y < 0 || x >= fb_width || y >= fb_height)
-        return;
-    int depth_index = y * fb_width + x;
-    if (!depth_test || (z > depth_buffer[depth_index])) {
-        // Perspective correction
-        fx32 inv_z = reciprocal(z);
-        inv_z = DIV(inv_z, FX(RECIPROCAL_NUMERATOR));
-
-        if (persp_correct) {
-            u = MUL(u, inv_z);
-            v = MUL(v, inv_z);
-            r = MUL(r, inv_z);
-            g = MUL(g, inv_z);
-            b = MUL(b, inv_z);
-            a = MUL(a, inv_z);
+static inline uint16_t pack_color(fx32 r, fx32 g, fx32 b, color_t scale) {
+    int rr = INTS(MULS(r, scale.r, SCALE_COLOR), SCALE_COLOR);
+    int gg = INTS(MULS(g, scale.g, SCALE_COLOR), SCALE_COLOR);
+    int bb = INTS(MULS(b, scale.b, SCALE_COLOR), SCALE_COLOR);
+    return rr << 11 | gg << 5 | bb;
+}
+
+uint16_t sw_modulate_texel(fx32 r, fx32 g, fx32 b, uint16_t texel) {
+    return pack_color(r, g, b, (color_t){g_texel_5bits[(texel >> 8) & 0xF], g_texel_6bits[(texel >> 4) & 0xF], g_texel_5bits[texel & 0xF]});
+}
+
+// The render state arguments are constants in the specialized kernels, where the untaken paths are removed
+static inline __attribute__((always_inline)) bool shade_fragment(fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, bool textured, bool bilinear, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool tex_swizzled, sw_depth_t* depth, bool persp_correct, uint16_t* color) {
+    sw_depth_t d = sw_depth(z);
+    if (depth_test && !(d > *depth))
+        return false;
+
+    // Perspective correction
+    fx32 inv_z = reciprocal(z);
+    inv_z = DIVS(inv_z, FXS(RECIPROCAL_NUMERATOR, SCALE_W), SCALE_W);
+
+    if (persp_correct) {
+        u = MULS(u, inv_z, SCALE_W);
+        v = MULS(v, inv_z, SCALE_W);
+        r = MULS(r, inv_z, SCALE_W);
+        g = MULS(g, inv_z, SCALE_W);
+        b = MULS(b, inv_z, SCALE_W);
+        a = MULS(a, inv_z, SCALE_W);
+    }
+
+    if (clamp_s) {
+        u = clamp(u);
+    } else {
+        u = wrap(u);
+    }
+    
+    if (clamp_t) {
+        v = clamp(v);
+    } else {
+        v = wrap(v);
+    }
+
+    // the modulation by the texel and the scaling to RGB565 in a single product
+    color_t scale = {FXS(31.0f, SCALE_COLOR), FXS(63.0f, SCALE_COLOR), FXS(31.0f, SCALE_COLOR)};
+    if (textured)
+        scale = bilinear ? texture_sample_bilinear(tex_addr, tex_scale_x, tex_scale_y, tex_swizzled, clamp_s, clamp_t, u, v)
+                         : texture_sample_color(tex_addr, tex_scale_x, tex_scale_y, tex_swizzled, u, v);
+    *color = pack_color(r, g, b, scale);
+
+    // write to depth buffer
+    *depth = d;
+    return true;
+}
+
+bool sw_shade_fragment(fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool tex_swizzled, sw_depth_t* depth, bool persp_correct, uint16_t* color) {
+    return shade_fragment(z, u, v, r, g, b, a, clamp_s, clamp_t, depth_test, tex_addr != NULL, g_bilinear, tex_addr, tex_scale_x, tex_scale_y, tex_swizzled, depth, persp_correct, color);
+}
+
+int sw_get_render_state(const uint16_t* tex_addr, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct) {
+    return (clamp_s ? SW_STATE_CLAMP_S : 0) | (clamp_t ? SW_STATE_CLAMP_T : 0) | (depth_test ? SW_STATE_DEPTH_TEST : 0) |
+           (persp_correct ? SW_STATE_PERSP_CORRECT : 0) | (tex_addr != NULL ? SW_STATE_TEXTURED : 0) |
+           (tex_addr != NULL && tex_swizzled ? SW_STATE_SWIZZLED : 0) | (tex_addr != NULL && g_bilinear ? SW_STATE_BILINEAR : 0);
+}
+
+// Channel at shift of the 2x2 texels t00, t10, t01 and t11 blended with the weights w00, w10, w01 and w11 in
+// 1/256, the step of the filter tables like the lanes of blend_texels(). The sum is at most 15 * 256, the 16-bit
+// arithmetic vectorizes in 16-bit lanes.
+static inline uint16_t filter_step(uint16_t t00, uint16_t t10, uint16_t t01, uint16_t t11, uint16_t w00, uint16_t w10, uint16_t w01, uint16_t w11, int shift) {
+    uint16_t sum = ((t00 >> shift) & 0xF) * w00 + ((t10 >> shift) & 0xF) * w10 + ((t01 >> shift) & 0xF) * w01 + ((t11 >> shift) & 0xF) * w11;
+    return (uint16_t)(sum + 8) >> 4;
+}
+
+// The bilinear filtering of shade_span_scalar() in groups of FILTER_CHUNK pixels, each group in passes: the
+// positions in the texture of the pixels passing the depth test, the indices and weights of their 2x2 texels,
+// the loads of the texels, the blends then the packing of the pixels. The passes of the indices and of the blends
+// run over the whole group without branches and vectorize, the rejected pixels and the pixels past the span
+// filter at position 0 and are not written.
+static inline __attribute__((always_inline)) void shade_span_bilinear(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written, int state) {
+    int tex_width = TEXTURE_WIDTH << span->tex_scale_x;
+    int tex_height = TEXTURE_HEIGHT << span->tex_scale_y;
+    bool swizzled = state & SW_STATE_SWIZZLED;
+
+    for (int start = 0; start < count; start += FILTER_CHUNK) {
+        int nb_pixels = count - start < FILTER_CHUNK ? count - start : FILTER_CHUNK;
+        bool pass[FILTER_CHUNK];
+        fx32 inv_z[FILTER_CHUNK];
+        int32_t sx[FILTER_CHUNK] = {0}, sy[FILTER_CHUNK] = {0};
+        for (int i = 0; i < nb_pixels; ++i) {
+            int n = first + start + i;
+            fx32 z = span->z + span->dz * n;
+            pass[i] = !(state & SW_STATE_DEPTH_TEST) || sw_depth(z) > depth[start + i];
+            if (!pass[i])
+                continue;
+
+            fx32 u = span->u + span->du * n;
+            fx32 v = span->v + span->dv * n;
+            if (state & SW_STATE_PERSP_CORRECT) {
+                inv_z[i] = DIVS(reciprocal(z), FXS(RECIPROCAL_NUMERATOR, SCALE_W), SCALE_W);
+                u = MULS(u, inv_z[i], SCALE_W);
+                v = MULS(v, inv_z[i], SCALE_W);
+            }
+            u = state & SW_STATE_CLAMP_S ? clamp(u) : wrap(u);
+            v = state & SW_STATE_CLAMP_T ? clamp(v) : wrap(v);
+            sx[i] = filter_position(u, tex_width);
+            sy[i] = filter_position(v, tex_height);
         }
 
-        if (clamp_s) {
-            u = clamp(u);
-        } else {
-            u = wrap(u);
+        int32_t i00[FILTER_CHUNK], i10[FILTER_CHUNK], i01[FILTER_CHUNK], i11[FILTER_CHUNK];
+        uint16_t wx[FILTER_CHUNK], wy[FILTER_CHUNK];
+        for (int i = 0; i < FILTER_CHUNK; ++i) {
+            int x0, x1, y0, y1, fx, fy;
+            filter_texels(sx[i], tex_width, state & SW_STATE_CLAMP_S, &x0, &x1, &fx);
+            filter_texels(sy[i], tex_height, state & SW_STATE_CLAMP_T, &y0, &y1, &fy);
+            int row0 = sw_texel_row(y0, span->tex_scale_x, swizzled), row1 = sw_texel_row(y1, span->tex_scale_x, swizzled);
+            int column0 = sw_texel_column(x0, swizzled), column1 = sw_texel_column(x1, swizzled);
+            i00[i] = row0 + column0;
+            i10[i] = row0 + column1;
+            i01[i] = row1 + column0;
+            i11[i] = row1 + column1;
+            wx[i] = fx;
+            wy[i] = fy;
         }
-        
-        if (clamp_t) {
-            v = clamp(v);
-        } else {
-            v = wrap(v);
+
+        uint16_t t00[FILTER_CHUNK], t10[FILTER_CHUNK], t01[FILTER_CHUNK], t11[FILTER_CHUNK];
+        for (int i = 0; i < FILTER_CHUNK; ++i) {
+            t00[i] = span->tex_addr[i00[i]];
+            t10[i] = span->tex_addr[i10[i]];
+            t01[i] = span->tex_addr[i01[i]];
+            t11[i] = span->tex_addr[i11[i]];
         }
 
-        color_t sample = texture_sample_color(tex_addr, tex_scale_x, tex_scale_y, u, v);
-        r = MUL(r, sample.r);
-        g = MUL(g, sample.g);
-        b = MUL(b, sample.b);
+        uint16_t step_r[FILTER_CHUNK], step_g[FILTER_CHUNK], step_b[FILTER_CHUNK];
+        for (int i = 0; i < FILTER_CHUNK; ++i) {
+            uint16_t w00 = (16 - wx[i]) * (16 - wy[i]), w10 = wx[i] * (16 - wy[i]), w01 = (16 - wx[i]) * wy[i], w11 = wx[i] * wy[i];
+            step_r[i] = filter_step(t00[i], t10[i], t01[i], t11[i], w00, w10, w01, w11, 8);
+            step_g[i] = filter_step(t00[i], t10[i], t01[i], t11[i], w00, w10, w01, w11, 4);
+            step_b[i] = filter_step(t00[i], t10[i], t01[i], t11[i], w00, w10, w01, w11, 0);
+        }
 
-        int rr = INT(MUL(r, FX(31.0f)));
-        int gg = INT(MUL(g, FX(63.0f)));
-        int bb = INT(MUL(b, FX(31.0f)));
+        for (int i = 0; i < nb_pixels; ++i) {
+            if (!pass[i])
+                continue;
+            int n = first + start + i;
+            fx32 r = span->r + span->dr * n;
+            fx32 g = span->g + span->dg * n;
+            fx32 b = span->b + span->db * n;
+            if (state & SW_STATE_PERSP_CORRECT) {
+                r = MULS(r, inv_z[i], SCALE_W);
+                g = MULS(g, inv_z[i], SCALE_W);
+                b = MULS(b, inv_z[i], SCALE_W);
+            }
+            colors[start + i] = pack_color(r, g, b, (color_t){g_filter_5bits[step_r[i]], g_filter_6bits[step_g[i]], g_filter_5bits[step_b[i]]});
+            depth[start + i] = sw_depth(span->z + span->dz * n);
+            written[start + i] = true;
+        }
+    }
+}
 
-        (*draw_pixel_fn)(x, y, rr << 11 | gg << 5 | bb);
+// The depth is tested first, the other attributes of the occluded pixels are not interpolated
+static inline __attribute__((always_inline)) void shade_span_scalar(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written, int state) {
+    if ((state & SW_STATE_TEXTURED) && (state & SW_STATE_BILINEAR)) {
+        shade_span_bilinear(span, first, count, depth, colors, written, state);
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        int n = first + i;
+        fx32 z = span->z + span->dz * n;
+        if ((state & SW_STATE_DEPTH_TEST) && !(sw_depth(z) > depth[i]))
+            continue;
+        if (shade_fragment(z, span->u + span->du * n, span->v + span->dv * n,
+                           span->r + span->dr * n, span->g + span->dg * n, span->b + span->db * n, FXS(1.0f, SCALE_COLOR),
+                           state & SW_STATE_CLAMP_S, state & SW_STATE_CLAMP_T, false, state & SW_STATE_TEXTURED, state & SW_STATE_BILINEAR,
+                           span->tex_addr, span->tex_scale_x, span->tex_scale_y, state & SW_STATE_SWIZZLED, &depth[i], state & SW_STATE_PERSP_CORRECT, &colors[i]))
+            written[i] = true;
+    }
+}
 
-        // write to depth buffer
-        depth_buffer[depth_index] = z;
+// The generic kernel tests the render state on each pixel
+void sw_shade_span_scalar(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) {
+    for (int i = 0; i < count; ++i) {
+        int n = first + i;
+        fx32 z = span->z + span->dz * n;
+        if (span->depth_test && !(sw_depth(z) > depth[i]))
+            continue;
+        if (sw_shade_fragment(z, span->u + span->du * n, span->v + span->dv * n,
+                              span->r + span->dr * n, span->g + span->dg * n, span->b + span->db * n, FXS(1.0f, SCALE_COLOR),
+                              span->clamp_s, span->clamp_t, false, span->tex_addr, span->tex_scale_x, span->tex_scale_y,
+                              span->tex_swizzled, &depth[i], span->persp_correct, &colors[i]))
+            written[i] = true;
     }
-}
\ No newline at end of file
+}
+
+#define SCALAR_VARIANT(state) \
+    static void shade_span_scalar_##state(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) { \
+        shade_span_scalar(span, first, count, depth, colors, written, state); \
+    }
+SW_FOR_EACH_STATE(SCALAR_VARIANT)
+
+#define SCALAR_VARIANT_ENTRY(state) shade_span_scalar_##state,
+static const sw_span_fn_t g_scalar_variants[SW_NB_STATES] = {SW_FOR_EACH_STATE(SCALAR_VARIANT_ENTRY)};
+
+sw_span_fn_t sw_get_span_variant_scalar(int state) {
+    return g_scalar_variants[state];
+}
+
+void sw_fragment_shader(int fb_width, int fb_height, int x, int y, fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool tex_swizzled, sw_depth_t* depth_buffer, bool persp_correct, uint16_t* color_buffer) {
+    if (x < 0 || y < 0 || x >= fb_width || y >= fb_height)
+        return;
+    int i = y * fb_width + x;
+    sw_shade_fragment(z, u, v, r, g, b, a, clamp_s, clamp_t, depth_test, tex_addr, tex_scale_x, tex_scale_y, tex_swizzled, &depth_buffer[i], persp_correct, &color_buffer[i]);
+}
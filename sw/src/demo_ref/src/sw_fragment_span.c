@@ -0,0 +1,964 @@
+// sw_fragment_span.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+// Fragment shading of horizontal spans, the scalar kernels are in sw_fragment_shader.c.
+// In the floating point mode, the SSE2, NEON and AVX2 kernels shade 4 or 8 pixels per iteration
+// with the same operations in the same order, so their results are bit identical. They need a
+// build without fused multiply-add contraction (-ffp-contract=off).
+
+#include "sw_rasterizer.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(SW_HAS_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(SW_HAS_AVX2)
+#include <immintrin.h>
+#endif
+
+#if defined(SW_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+#define TEXTURE_WIDTH   32
+#define TEXTURE_HEIGHT  32
+
+// pixels shaded at once by sw_fragment_shader_span(), the size of its scratch written flags
+#define SPAN_CHUNK      64
+
+static bool g_specialize = true;
+
+// Subdivided affine spans, 0 for the exact perspective correction of each pixel
+static int g_persp_span_length = 0;
+static int g_persp_span_shift = 0;  // log2 of g_persp_span_length
+static bool g_measure_persp_error = false;
+static sw_persp_error_t g_persp_error;
+
+static inline int span_state(const sw_span_t* span) {
+    return sw_get_render_state(span->tex_addr, span->tex_swizzled, span->clamp_s, span->clamp_t, span->depth_test, span->persp_correct);
+}
+
+#if defined(SW_HAS_SSE2) || defined(SW_HAS_NEON)
+
+// Loads of the 2x2 texels of a group of lanes, chosen once for the group from vector compares rather than for
+// each lane like sw_fetch_footprint(): the four texels of each lane at once when every lane is on a 2x2 quad of
+// the swizzled layout at even coordinates, the two texels of each row at once when they are adjacent in memory
+// for every lane, else one by one. The pairs of the row-major layout start on odd texels as well, memcpy() loads
+// them unaligned, which the targets of these kernels allow.
+enum { FETCH_TEXELS, FETCH_PAIRS, FETCH_QUADS };
+
+// The pairs of texels of the rows of the 2x2 texels of the bilinear filtering, row j of lane k at j * nb_lanes + k
+// from the indices of texel j of lane k at j * nb_lanes + k. The quads and pairs are loaded for every lane, their
+// texels are inside the texture, the single texels only for the lanes passing the depth test. The texels of a pair
+// or quad are in the low bits first, the targets are little endian.
+static inline void fetch_footprints(const uint16_t* tex_addr, const int32_t* index, int32_t* row, int nb_lanes, int pass_bits, int fetch) {
+    if (fetch == FETCH_QUADS) {
+        for (int k = 0; k < nb_lanes; ++k) {
+            uint64_t quad;
+            memcpy(&quad, &tex_addr[index[k]], sizeof(quad));
+            row[k] = (int32_t)(uint32_t)quad;
+            row[nb_lanes + k] = (int32_t)(uint32_t)(quad >> 32);
+        }
+    } else if (fetch == FETCH_PAIRS) {
+        for (int k = 0; k < nb_lanes; ++k) {
+            memcpy(&row[k], &tex_addr[index[k]], sizeof(int32_t));
+            memcpy(&row[nb_lanes + k], &tex_addr[index[2 * nb_lanes + k]], sizeof(int32_t));
+        }
+    } else {
+        for (int k = 0; k < nb_lanes; ++k) {
+            bool pass = (pass_bits >> k) & 1;
+            row[k] = pass ? tex_addr[index[k]] | (uint32_t)tex_addr[index[nb_lanes + k]] << 16 : 0;
+            row[nb_lanes + k] = pass ? tex_addr[index[2 * nb_lanes + k]] | (uint32_t)tex_addr[index[3 * nb_lanes + k]] << 16 : 0;
+        }
+    }
+}
+
+#endif
+
+#if defined(SW_HAS_SSE2)
+
+static inline __m128 lerp_sse2(float start, float step, __m128 n) {
+    return _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set1_ps(step), n));
+}
+
+static inline __m128 select_sse2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 clamp_sse2(__m128 v) {
+    v = select_sse2(_mm_cmplt_ps(v, _mm_setzero_ps()), _mm_setzero_ps(), v);
+    return select_sse2(_mm_cmpgt_ps(v, _mm_set1_ps(1.0f)), _mm_set1_ps(1.0f), v);
+}
+
+// fmod(v, 1) for v >= 1 is v - trunc(v), and v - v from 2^23 where every float is an integer
+static inline __m128 wrap_sse2(__m128 v) {
+    __m128 frac = _mm_sub_ps(v, _mm_cvtepi32_ps(_mm_cvttps_epi32(v)));
+    frac = select_sse2(_mm_cmpge_ps(v, _mm_set1_ps(8388608.0f)), _mm_sub_ps(v, v), frac);
+    v = select_sse2(_mm_cmpge_ps(v, _mm_set1_ps(1.0f)), frac, v);
+    return select_sse2(_mm_cmplt_ps(v, _mm_setzero_ps()), _mm_setzero_ps(), v);
+}
+
+// Stored depth of z like sw_depth(), in 32-bit lanes
+static inline __m128i depth_sse2(__m128 z) {
+#if DEPTH_BITS == 32
+    return _mm_castps_si128(_mm_max_ps(z, _mm_setzero_ps()));
+#else
+    __m128 d = _mm_max_ps(_mm_mul_ps(z, _mm_set1_ps((float)(1 << (DEPTH_BITS - 2)))), _mm_setzero_ps());
+    return _mm_cvttps_epi32(_mm_min_ps(d, _mm_set1_ps((float)SW_DEPTH_MAX)));
+#endif
+}
+
+// Texel indices like sw_texel_index()
+static inline __m128i texel_index_sse2(__m128i x, __m128i y, int tex_shift, bool swizzled) {
+    if (!swizzled)
+        return _mm_add_epi32(_mm_sll_epi32(y, _mm_cvtsi32_si128(tex_shift)), x);
+    __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+    __m128i tile = _mm_add_epi32(_mm_sll_epi32(_mm_srli_epi32(y, 2), _mm_cvtsi32_si128(tex_shift - 2)), _mm_srli_epi32(x, 2));
+    __m128i quad = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(y, two), 2), _mm_slli_epi32(_mm_and_si128(x, two), 1)),
+                                _mm_or_si128(_mm_slli_epi32(_mm_and_si128(y, one), 1), _mm_and_si128(x, one)));
+    return _mm_or_si128(_mm_slli_epi32(tile, 4), quad);
+}
+
+// Texels and weight like filter_texels() of sw_fragment_shader.c
+static inline void filter_texels_sse2(__m128 t, int size, bool clamp, __m128i* i0, __m128i* i1, __m128i* frac) {
+    __m128i s = _mm_sub_epi32(_mm_cvttps_epi32(_mm_mul_ps(t, _mm_set1_ps((float)(size << 4)))), _mm_set1_epi32(8));
+    __m128i i = _mm_srai_epi32(s, 4);
+    __m128i next = _mm_add_epi32(i, _mm_set1_epi32(1));
+    *frac = _mm_and_si128(s, _mm_set1_epi32(15));
+    if (clamp) {
+        __m128i last = _mm_set1_epi32(size - 1);
+        __m128i over = _mm_cmpgt_epi32(next, last);
+        *i0 = _mm_andnot_si128(_mm_srai_epi32(i, 31), i);
+        *i1 = _mm_or_si128(_mm_and_si128(over, last), _mm_andnot_si128(over, next));
+    } else {
+        *i0 = _mm_and_si128(i, _mm_set1_epi32(size - 1));
+        *i1 = _mm_and_si128(next, _mm_set1_epi32(size - 1));
+    }
+}
+
+// Loads of the footprints of the lanes, x1 and y1 follow x0 and y0 unless they wrap or clamp
+static inline int footprint_fetch_sse2(__m128i x0, __m128i x1, __m128i y0, __m128i y1, bool swizzled) {
+    __m128i one = _mm_set1_epi32(1);
+    __m128i pairs = _mm_cmpeq_epi32(x1, _mm_add_epi32(x0, one));
+    if (!swizzled)
+        return _mm_movemask_epi8(pairs) == 0xFFFF ? FETCH_PAIRS : FETCH_TEXELS;
+    pairs = _mm_and_si128(pairs, _mm_cmpeq_epi32(_mm_and_si128(x0, one), _mm_setzero_si128()));
+    if (_mm_movemask_epi8(pairs) != 0xFFFF)
+        return FETCH_TEXELS;
+    __m128i quads = _mm_and_si128(_mm_cmpeq_epi32(y1, _mm_add_epi32(y0, one)), _mm_cmpeq_epi32(_mm_and_si128(y0, one), _mm_setzero_si128()));
+    return _mm_movemask_epi8(quads) == 0xFFFF ? FETCH_QUADS : FETCH_PAIRS;
+}
+
+// Entries of a table at the indices of the lanes
+static inline __m128 lookup_sse2(const float* table, __m128i index) {
+    int32_t i[4];
+    _mm_storeu_si128((__m128i*)i, index);
+    return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+// Blend of the channel at shift of the pairs of texels of the rows y0 and y1 with the pairs of weights of the rows,
+// the 16-bit products summed by pairs in the 32-bit lanes. The entries step * max / SW_FILTER_STEPS of the filter
+// tables are divided in the lanes rather than loaded, with the same rounding.
+static inline __m128 filter_channel_sse2(__m128i row0, __m128i row1, __m128i weights0, __m128i weights1, int shift, int max) {
+    __m128i mask = _mm_set1_epi32(0x000F000F);
+    __m128i c0 = _mm_and_si128(_mm_srl_epi32(row0, _mm_cvtsi32_si128(shift)), mask);
+    __m128i c1 = _mm_and_si128(_mm_srl_epi32(row1, _mm_cvtsi32_si128(shift)), mask);
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(c0, weights0), _mm_madd_epi16(c1, weights1));
+    __m128 step = _mm_cvtepi32_ps(_mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(8)), 4));
+    return _mm_div_ps(_mm_mul_ps(step, _mm_set1_ps((float)max)), _mm_set1_ps((float)SW_FILTER_STEPS));
+}
+
+// Factors of the RGB565 channels like texture_sample_bilinear() of sw_fragment_shader.c
+static inline void sample_bilinear_sse2(const sw_span_t* span, __m128 u, __m128 v, int pass_bits, int state, __m128* r, __m128* g, __m128* b) {
+    __m128i x0, x1, fx, y0, y1, fy;
+    filter_texels_sse2(u, TEXTURE_WIDTH << span->tex_scale_x, state & SW_STATE_CLAMP_S, &x0, &x1, &fx);
+    filter_texels_sse2(v, TEXTURE_HEIGHT << span->tex_scale_y, state & SW_STATE_CLAMP_T, &y0, &y1, &fy);
+
+    int tex_shift = 5 + span->tex_scale_x;
+    bool swizzled = state & SW_STATE_SWIZZLED;
+    int32_t index[4 * 4], row[2 * 4];
+    _mm_storeu_si128((__m128i*)&index[0], texel_index_sse2(x0, y0, tex_shift, swizzled));
+    _mm_storeu_si128((__m128i*)&index[4], texel_index_sse2(x1, y0, tex_shift, swizzled));
+    _mm_storeu_si128((__m128i*)&index[8], texel_index_sse2(x0, y1, tex_shift, swizzled));
+    _mm_storeu_si128((__m128i*)&index[12], texel_index_sse2(x1, y1, tex_shift, swizzled));
+    fetch_footprints(span->tex_addr, index, row, 4, pass_bits, footprint_fetch_sse2(x0, x1, y0, y1, swizzled));
+    __m128i row0 = _mm_loadu_si128((const __m128i*)&row[0]), row1 = _mm_loadu_si128((const __m128i*)&row[4]);
+
+    // the weights of the texels x0 and x1 in the 16-bit halves, times the weights of the rows, at most 256
+    __m128i weights = _mm_or_si128(_mm_sub_epi32(_mm_set1_epi32(16), fx), _mm_slli_epi32(fx, 16));
+    __m128i wy1 = _mm_or_si128(fy, _mm_slli_epi32(fy, 16));
+    __m128i weights0 = _mm_mullo_epi16(weights, _mm_sub_epi16(_mm_set1_epi16(16), wy1));
+    __m128i weights1 = _mm_mullo_epi16(weights, wy1);
+    *r = filter_channel_sse2(row0, row1, weights0, weights1, 8, 31);
+    *g = filter_channel_sse2(row0, row1, weights0, weights1, 4, 63);
+    *b = filter_channel_sse2(row0, row1, weights0, weights1, 0, 31);
+}
+
+static inline __m128i load_depth_sse2(const sw_depth_t* depth) {
+#if DEPTH_BITS == 16
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)depth), _mm_setzero_si128());
+#else
+    return _mm_loadu_si128((const __m128i*)depth);
+#endif
+}
+
+static inline void store_depth_sse2(sw_depth_t* depth, __m128i d) {
+#if DEPTH_BITS == 16
+    // SSE2 only packs with signed saturation, the depths are moved to the signed range and back
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(d, _mm_set1_epi32(0x8000)), _mm_setzero_si128());
+    _mm_storel_epi64((__m128i*)depth, _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000)));
+#else
+    _mm_storeu_si128((__m128i*)depth, d);
+#endif
+}
+
+// Shade the groups of 4 pixels, returns the number of pixels shaded
+static inline __attribute__((always_inline)) int shade_span_sse2(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written, int state) {
+    int tex_width = TEXTURE_WIDTH << span->tex_scale_x;
+    int tex_height = TEXTURE_HEIGHT << span->tex_scale_y;
+    int tex_shift = 5 + span->tex_scale_x;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 n = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + i), _mm_set_epi32(3, 2, 1, 0)));
+        __m128 z = lerp_sse2(span->z, span->dz, n);
+
+        __m128i zd = depth_sse2(z);
+        __m128 pass = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128i d = load_depth_sse2(&depth[i]);
+        if (state & SW_STATE_DEPTH_TEST)
+            pass = _mm_castsi128_ps(_mm_cmpgt_epi32(zd, d));
+        int pass_bits = _mm_movemask_ps(pass);
+        if (pass_bits == 0)
+            continue;
+
+        __m128 u = lerp_sse2(span->u, span->du, n);
+        __m128 v = lerp_sse2(span->v, span->dv, n);
+        __m128 r = lerp_sse2(span->r, span->dr, n);
+        __m128 g = lerp_sse2(span->g, span->dg, n);
+        __m128 b = lerp_sse2(span->b, span->db, n);
+
+        // Perspective correction
+        if (state & SW_STATE_PERSP_CORRECT) {
+            __m128 inv_z = select_sse2(_mm_cmpgt_ps(z, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1.0f), z), _mm_set1_ps(1.0f));
+            u = _mm_mul_ps(u, inv_z);
+            v = _mm_mul_ps(v, inv_z);
+            r = _mm_mul_ps(r, inv_z);
+            g = _mm_mul_ps(g, inv_z);
+            b = _mm_mul_ps(b, inv_z);
+        }
+
+        u = state & SW_STATE_CLAMP_S ? clamp_sse2(u) : wrap_sse2(u);
+        v = state & SW_STATE_CLAMP_T ? clamp_sse2(v) : wrap_sse2(v);
+
+        // factors of the RGB565 channels, the texel channels scaled by the tables when textured
+        __m128 sr = _mm_set1_ps(31.0f), sg = _mm_set1_ps(63.0f), sb = _mm_set1_ps(31.0f);
+        if ((state & SW_STATE_TEXTURED) && (state & SW_STATE_BILINEAR)) {
+            sample_bilinear_sse2(span, u, v, pass_bits, state, &sr, &sg, &sb);
+        } else if (state & SW_STATE_TEXTURED) {
+            __m128i x = _mm_cvttps_epi32(_mm_mul_ps(u, _mm_set1_ps((float)tex_width)));
+            __m128i y = _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps((float)tex_height)));
+            __m128i x_max = _mm_set1_epi32(tex_width - 1);
+            __m128i y_max = _mm_set1_epi32(tex_height - 1);
+            __m128i x_over = _mm_cmpgt_epi32(x, x_max);
+            __m128i y_over = _mm_cmpgt_epi32(y, y_max);
+            x = _mm_or_si128(_mm_and_si128(x_over, x_max), _mm_andnot_si128(x_over, x));
+            y = _mm_or_si128(_mm_and_si128(y_over, y_max), _mm_andnot_si128(y_over, y));
+
+            // the texels of the rejected pixels are not fetched, their coordinates may be anything
+            int32_t index[4], texel[4];
+            _mm_storeu_si128((__m128i*)index, texel_index_sse2(x, y, tex_shift, state & SW_STATE_SWIZZLED));
+            for (int k = 0; k < 4; ++k)
+                texel[k] = (pass_bits >> k) & 1 ? span->tex_addr[index[k]] : 0;
+            __m128i c = _mm_loadu_si128((const __m128i*)texel);
+
+            __m128i mask = _mm_set1_epi32(0xF);
+            sr = lookup_sse2(sw_get_texel_channels(5), _mm_and_si128(_mm_srli_epi32(c, 8), mask));
+            sg = lookup_sse2(sw_get_texel_channels(6), _mm_and_si128(_mm_srli_epi32(c, 4), mask));
+            sb = lookup_sse2(sw_get_texel_channels(5), _mm_and_si128(c, mask));
+        }
+
+        __m128i rr = _mm_cvttps_epi32(_mm_mul_ps(r, sr));
+        __m128i gg = _mm_cvttps_epi32(_mm_mul_ps(g, sg));
+        __m128i bb = _mm_cvttps_epi32(_mm_mul_ps(b, sb));
+        int32_t color[4];
+        _mm_storeu_si128((__m128i*)color, _mm_or_si128(_mm_or_si128(_mm_slli_epi32(rr, 11), _mm_slli_epi32(gg, 5)), bb));
+
+        store_depth_sse2(&depth[i], _mm_castps_si128(select_sse2(pass, _mm_castsi128_ps(zd), _mm_castsi128_ps(d))));
+        for (int k = 0; k < 4; ++k) {
+            if ((pass_bits >> k) & 1) {
+                colors[i + k] = (uint16_t)color[k];
+                written[i + k] = true;
+            }
+        }
+    }
+    return i;
+}
+
+void sw_shade_span_sse2(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) {
+    int i = shade_span_sse2(span, first, count, depth, colors, written, span_state(span));
+    sw_shade_span_scalar(span, first + i, count - i, &depth[i], &colors[i], &written[i]);
+}
+
+#endif
+
+#if defined(SW_HAS_AVX2)
+
+static inline __m256 lerp_avx2(float start, float step, __m256 n) {
+    return _mm256_add_ps(_mm256_set1_ps(start), _mm256_mul_ps(_mm256_set1_ps(step), n));
+}
+
+static inline __m256 clamp_avx2(__m256 v) {
+    v = _mm256_blendv_ps(v, _mm256_setzero_ps(), _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ));
+    return _mm256_blendv_ps(v, _mm256_set1_ps(1.0f), _mm256_cmp_ps(v, _mm256_set1_ps(1.0f), _CMP_GT_OQ));
+}
+
+static inline __m256 wrap_avx2(__m256 v) {
+    __m256 frac = _mm256_sub_ps(v, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(v)));
+    frac = _mm256_blendv_ps(frac, _mm256_sub_ps(v, v), _mm256_cmp_ps(v, _mm256_set1_ps(8388608.0f), _CMP_GE_OQ));
+    v = _mm256_blendv_ps(v, frac, _mm256_cmp_ps(v, _mm256_set1_ps(1.0f), _CMP_GE_OQ));
+    return _mm256_blendv_ps(v, _mm256_setzero_ps(), _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ));
+}
+
+static inline __m256i depth_avx2(__m256 z) {
+#if DEPTH_BITS == 32
+    return _mm256_castps_si256(_mm256_max_ps(z, _mm256_setzero_ps()));
+#else
+    __m256 d = _mm256_max_ps(_mm256_mul_ps(z, _mm256_set1_ps((float)(1 << (DEPTH_BITS - 2)))), _mm256_setzero_ps());
+    return _mm256_cvttps_epi32(_mm256_min_ps(d, _mm256_set1_ps((float)SW_DEPTH_MAX)));
+#endif
+}
+
+static inline __m256i texel_index_avx2(__m256i x, __m256i y, int tex_shift, bool swizzled) {
+    if (!swizzled)
+        return _mm256_add_epi32(_mm256_sll_epi32(y, _mm_cvtsi32_si128(tex_shift)), x);
+    __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+    __m256i tile = _mm256_add_epi32(_mm256_sll_epi32(_mm256_srli_epi32(y, 2), _mm_cvtsi32_si128(tex_shift - 2)), _mm256_srli_epi32(x, 2));
+    __m256i quad = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(y, two), 2), _mm256_slli_epi32(_mm256_and_si256(x, two), 1)),
+                                   _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(y, one), 1), _mm256_and_si256(x, one)));
+    return _mm256_or_si256(_mm256_slli_epi32(tile, 4), quad);
+}
+
+static inline void filter_texels_avx2(__m256 t, int size, bool clamp, __m256i* i0, __m256i* i1, __m256i* frac) {
+    __m256i s = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(t, _mm256_set1_ps((float)(size << 4)))), _mm256_set1_epi32(8));
+    __m256i i = _mm256_srai_epi32(s, 4);
+    __m256i next = _mm256_add_epi32(i, _mm256_set1_epi32(1));
+    *frac = _mm256_and_si256(s, _mm256_set1_epi32(15));
+    if (clamp) {
+        *i0 = _mm256_max_epi32(i, _mm256_setzero_si256());
+        *i1 = _mm256_min_epi32(next, _mm256_set1_epi32(size - 1));
+    } else {
+        *i0 = _mm256_and_si256(i, _mm256_set1_epi32(size - 1));
+        *i1 = _mm256_and_si256(next, _mm256_set1_epi32(size - 1));
+    }
+}
+
+// Texels of the indices of the lanes, gathered from the aligned 32-bit words of the pairs of even and odd
+// texels that hold them. The lanes off the mask are not loaded.
+static inline __m256i gather_texels_avx2(const uint16_t* tex_addr, __m256i index, __m256i mask) {
+    __m256i words = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)tex_addr, _mm256_srli_epi32(index, 1), mask, 4);
+    return _mm256_srlv_epi32(words, _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(1)), 4));
+}
+
+// Entries of a table of 16 at the indices of the lanes, bit 3 of the indices selects the half of the table
+static inline __m256 lookup16_avx2(const float* table, __m256i index) {
+    __m256 low = _mm256_permutevar8x32_ps(_mm256_loadu_ps(table), index);
+    __m256 high = _mm256_permutevar8x32_ps(_mm256_loadu_ps(table + 8), index);
+    return _mm256_blendv_ps(low, high, _mm256_castsi256_ps(_mm256_slli_epi32(index, 28)));
+}
+
+static inline __m256 filter_channel_avx2(__m256i row0, __m256i row1, __m256i weights0, __m256i weights1, int shift, int max) {
+    __m256i mask = _mm256_set1_epi32(0x000F000F);
+    __m256i c0 = _mm256_and_si256(_mm256_srl_epi32(row0, _mm_cvtsi32_si128(shift)), mask);
+    __m256i c1 = _mm256_and_si256(_mm256_srl_epi32(row1, _mm_cvtsi32_si128(shift)), mask);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(c0, weights0), _mm256_madd_epi16(c1, weights1));
+    __m256 step = _mm256_cvtepi32_ps(_mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(8)), 4));
+    return _mm256_div_ps(_mm256_mul_ps(step, _mm256_set1_ps((float)max)), _mm256_set1_ps((float)SW_FILTER_STEPS));
+}
+
+static inline void sample_bilinear_avx2(const sw_span_t* span, __m256 u, __m256 v, __m256 pass, int state, __m256* r, __m256* g, __m256* b) {
+    __m256i x0, x1, fx, y0, y1, fy;
+    filter_texels_avx2(u, TEXTURE_WIDTH << span->tex_scale_x, state & SW_STATE_CLAMP_S, &x0, &x1, &fx);
+    filter_texels_avx2(v, TEXTURE_HEIGHT << span->tex_scale_y, state & SW_STATE_CLAMP_T, &y0, &y1, &fy);
+
+    int tex_shift = 5 + span->tex_scale_x;
+    bool swizzled = state & SW_STATE_SWIZZLED;
+    const uint16_t* tex_addr = span->tex_addr;
+    __m256i mask = _mm256_castps_si256(pass);
+    __m256i t00 = gather_texels_avx2(tex_addr, texel_index_avx2(x0, y0, tex_shift, swizzled), mask);
+    __m256i t10 = gather_texels_avx2(tex_addr, texel_index_avx2(x1, y0, tex_shift, swizzled), mask);
+    __m256i t01 = gather_texels_avx2(tex_addr, texel_index_avx2(x0, y1, tex_shift, swizzled), mask);
+    __m256i t11 = gather_texels_avx2(tex_addr, texel_index_avx2(x1, y1, tex_shift, swizzled), mask);
+    __m256i low = _mm256_set1_epi32(0xFFFF);
+    __m256i row0 = _mm256_or_si256(_mm256_and_si256(t00, low), _mm256_slli_epi32(t10, 16));
+    __m256i row1 = _mm256_or_si256(_mm256_and_si256(t01, low), _mm256_slli_epi32(t11, 16));
+
+    __m256i weights = _mm256_or_si256(_mm256_sub_epi32(_mm256_set1_epi32(16), fx), _mm256_slli_epi32(fx, 16));
+    __m256i weights0 = _mm256_mullo_epi32(weights, _mm256_sub_epi32(_mm256_set1_epi32(16), fy));
+    __m256i weights1 = _mm256_mullo_epi32(weights, fy);
+    *r = filter_channel_avx2(row0, row1, weights0, weights1, 8, 31);
+    *g = filter_channel_avx2(row0, row1, weights0, weights1, 4, 63);
+    *b = filter_channel_avx2(row0, row1, weights0, weights1, 0, 31);
+}
+
+static inline __m256i load_depth_avx2(const sw_depth_t* depth) {
+#if DEPTH_BITS == 16
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)depth));
+#else
+    return _mm256_loadu_si256((const __m256i*)depth);
+#endif
+}
+
+static inline void store_depth_avx2(sw_depth_t* depth, __m256i d) {
+#if DEPTH_BITS == 16
+    _mm_storeu_si128((__m128i*)depth, _mm_packus_epi32(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1)));
+#else
+    _mm256_storeu_si256((__m256i*)depth, d);
+#endif
+}
+
+// Shade the groups of 8 pixels, returns the number of pixels shaded
+static inline __attribute__((always_inline)) int shade_span_avx2(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written, int state) {
+    int tex_width = TEXTURE_WIDTH << span->tex_scale_x;
+    int tex_height = TEXTURE_HEIGHT << span->tex_scale_y;
+    int tex_shift = 5 + span->tex_scale_x;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 n = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(first + i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+        __m256 z = lerp_avx2(span->z, span->dz, n);
+
+        __m256i zd = depth_avx2(z);
+        __m256 pass = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256i d = load_depth_avx2(&depth[i]);
+        if (state & SW_STATE_DEPTH_TEST)
+            pass = _mm256_castsi256_ps(_mm256_cmpgt_epi32(zd, d));
+        int pass_bits = _mm256_movemask_ps(pass);
+        if (pass_bits == 0)
+            continue;
+
+        __m256 u = lerp_avx2(span->u, span->du, n);
+        __m256 v = lerp_avx2(span->v, span->dv, n);
+        __m256 r = lerp_avx2(span->r, span->dr, n);
+        __m256 g = lerp_avx2(span->g, span->dg, n);
+        __m256 b = lerp_avx2(span->b, span->db, n);
+
+        // Perspective correction
+        if (state & SW_STATE_PERSP_CORRECT) {
+            __m256 inv_z = _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_div_ps(_mm256_set1_ps(1.0f), z),
+                                            _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_GT_OQ));
+            u = _mm256_mul_ps(u, inv_z);
+            v = _mm256_mul_ps(v, inv_z);
+            r = _mm256_mul_ps(r, inv_z);
+            g = _mm256_mul_ps(g, inv_z);
+            b = _mm256_mul_ps(b, inv_z);
+        }
+
+        u = state & SW_STATE_CLAMP_S ? clamp_avx2(u) : wrap_avx2(u);
+        v = state & SW_STATE_CLAMP_T ? clamp_avx2(v) : wrap_avx2(v);
+
+        __m256 sr = _mm256_set1_ps(31.0f), sg = _mm256_set1_ps(63.0f), sb = _mm256_set1_ps(31.0f);
+        if ((state & SW_STATE_TEXTURED) && (state & SW_STATE_BILINEAR)) {
+            sample_bilinear_avx2(span, u, v, pass, state, &sr, &sg, &sb);
+        } else if (state & SW_STATE_TEXTURED) {
+            __m256i x = _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps((float)tex_width)));
+            __m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps((float)tex_height)));
+            __m256i x_max = _mm256_set1_epi32(tex_width - 1);
+            __m256i y_max = _mm256_set1_epi32(tex_height - 1);
+            x = _mm256_blendv_epi8(x, x_max, _mm256_cmpgt_epi32(x, x_max));
+            y = _mm256_blendv_epi8(y, y_max, _mm256_cmpgt_epi32(y, y_max));
+
+            // the texels of the rejected pixels are not fetched, their coordinates may be anything
+            int32_t index[8], texel[8];
+            _mm256_storeu_si256((__m256i*)index, texel_index_avx2(x, y, tex_shift, state & SW_STATE_SWIZZLED));
+            for (int k = 0; k < 8; ++k)
+                texel[k] = (pass_bits >> k) & 1 ? span->tex_addr[index[k]] : 0;
+            __m256i c = _mm256_loadu_si256((const __m256i*)texel);
+
+            __m256i mask = _mm256_set1_epi32(0xF);
+            sr = lookup16_avx2(sw_get_texel_channels(5), _mm256_and_si256(_mm256_srli_epi32(c, 8), mask));
+            sg = lookup16_avx2(sw_get_texel_channels(6), _mm256_and_si256(_mm256_srli_epi32(c, 4), mask));
+            sb = lookup16_avx2(sw_get_texel_channels(5), _mm256_and_si256(c, mask));
+        }
+
+        __m256i rr = _mm256_cvttps_epi32(_mm256_mul_ps(r, sr));
+        __m256i gg = _mm256_cvttps_epi32(_mm256_mul_ps(g, sg));
+        __m256i bb = _mm256_cvttps_epi32(_mm256_mul_ps(b, sb));
+        int32_t color[8];
+        _mm256_storeu_si256((__m256i*)color, _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(rr, 11), _mm256_slli_epi32(gg, 5)), bb));
+
+        store_depth_avx2(&depth[i], _mm256_blendv_epi8(d, zd, _mm256_castps_si256(pass)));
+        for (int k = 0; k < 8; ++k) {
+            if ((pass_bits >> k) & 1) {
+                colors[i + k] = (uint16_t)color[k];
+                written[i + k] = true;
+            }
+        }
+    }
+    return i;
+}
+
+void sw_shade_span_avx2(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) {
+    int state = span_state(span);
+    int i = shade_span_avx2(span, first, count, depth, colors, written, state);
+
+    // the remaining pixels, fewer than 8
+#if defined(SW_HAS_SSE2)
+    i += shade_span_sse2(span, first + i, count - i, &depth[i], &colors[i], &written[i], state);
+#endif
+    sw_shade_span_scalar(span, first + i, count - i, &depth[i], &colors[i], &written[i]);
+}
+
+#endif
+
+#if defined(SW_HAS_NEON)
+
+static inline float32x4_t lerp_neon(float start, float step, float32x4_t n) {
+    return vaddq_f32(vdupq_n_f32(start), vmulq_f32(vdupq_n_f32(step), n));
+}
+
+static inline float32x4_t clamp_neon(float32x4_t v) {
+    v = vbslq_f32(vcltq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(0.0f), v);
+    return vbslq_f32(vcgtq_f32(v, vdupq_n_f32(1.0f)), vdupq_n_f32(1.0f), v);
+}
+
+static inline float32x4_t wrap_neon(float32x4_t v) {
+    float32x4_t frac = vsubq_f32(v, vcvtq_f32_s32(vcvtq_s32_f32(v)));
+    frac = vbslq_f32(vcgeq_f32(v, vdupq_n_f32(8388608.0f)), vsubq_f32(v, v), frac);
+    v = vbslq_f32(vcgeq_f32(v, vdupq_n_f32(1.0f)), frac, v);
+    return vbslq_f32(vcltq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(0.0f), v);
+}
+
+// The comparisons send NaN to 0 like sw_depth(), vmaxq_f32() would keep it
+static inline uint32x4_t depth_neon(float32x4_t z) {
+#if DEPTH_BITS == 32
+    return vreinterpretq_u32_f32(vbslq_f32(vcgtq_f32(z, vdupq_n_f32(0.0f)), z, vdupq_n_f32(0.0f)));
+#else
+    float32x4_t d = vmulq_f32(z, vdupq_n_f32((float)(1 << (DEPTH_BITS - 2))));
+    d = vbslq_f32(vcgtq_f32(d, vdupq_n_f32(0.0f)), d, vdupq_n_f32(0.0f));
+    return vcvtq_u32_f32(vminq_f32(d, vdupq_n_f32((float)SW_DEPTH_MAX)));
+#endif
+}
+
+static inline int32x4_t texel_index_neon(int32x4_t x, int32x4_t y, int tex_shift, bool swizzled) {
+    if (!swizzled)
+        return vaddq_s32(vshlq_s32(y, vdupq_n_s32(tex_shift)), x);
+    int32x4_t one = vdupq_n_s32(1), two = vdupq_n_s32(2);
+    int32x4_t tile = vaddq_s32(vshlq_s32(vshrq_n_s32(y, 2), vdupq_n_s32(tex_shift - 2)), vshrq_n_s32(x, 2));
+    int32x4_t quad = vorrq_s32(vorrq_s32(vshlq_n_s32(vandq_s32(y, two), 2), vshlq_n_s32(vandq_s32(x, two), 1)),
+                               vorrq_s32(vshlq_n_s32(vandq_s32(y, one), 1), vandq_s32(x, one)));
+    return vorrq_s32(vshlq_n_s32(tile, 4), quad);
+}
+
+static inline void filter_texels_neon(float32x4_t t, int size, bool clamp, int32x4_t* i0, int32x4_t* i1, int32x4_t* frac) {
+    int32x4_t s = vsubq_s32(vcvtq_s32_f32(vmulq_f32(t, vdupq_n_f32((float)(size << 4)))), vdupq_n_s32(8));
+    int32x4_t i = vshrq_n_s32(s, 4);
+    int32x4_t next = vaddq_s32(i, vdupq_n_s32(1));
+    *frac = vandq_s32(s, vdupq_n_s32(15));
+    if (clamp) {
+        *i0 = vmaxq_s32(i, vdupq_n_s32(0));
+        *i1 = vminq_s32(next, vdupq_n_s32(size - 1));
+    } else {
+        *i0 = vandq_s32(i, vdupq_n_s32(size - 1));
+        *i1 = vandq_s32(next, vdupq_n_s32(size - 1));
+    }
+}
+
+static inline int footprint_fetch_neon(int32x4_t x0, int32x4_t x1, int32x4_t y0, int32x4_t y1, bool swizzled) {
+    int32x4_t one = vdupq_n_s32(1);
+    uint32x4_t pairs = vceqq_s32(x1, vaddq_s32(x0, one));
+    if (!swizzled)
+        return vminvq_u32(pairs) ? FETCH_PAIRS : FETCH_TEXELS;
+    pairs = vandq_u32(pairs, vceqq_s32(vandq_s32(x0, one), vdupq_n_s32(0)));
+    if (!vminvq_u32(pairs))
+        return FETCH_TEXELS;
+    uint32x4_t quads = vandq_u32(vceqq_s32(y1, vaddq_s32(y0, one)), vceqq_s32(vandq_s32(y0, one), vdupq_n_s32(0)));
+    return vminvq_u32(quads) ? FETCH_QUADS : FETCH_PAIRS;
+}
+
+static inline float32x4_t lookup_neon(const float* table, int32x4_t index) {
+    int32_t i[4];
+    vst1q_s32(i, index);
+    float value[4] = {table[i[0]], table[i[1]], table[i[2]], table[i[3]]};
+    return vld1q_f32(value);
+}
+
+// The 16-bit products of the pairs are summed by pairs in the 32-bit lanes like _mm_madd_epi16()
+static inline float32x4_t filter_channel_neon(uint32x4_t row0, uint32x4_t row1, uint32x4_t weights0, uint32x4_t weights1, int shift, int max) {
+    uint32x4_t mask = vdupq_n_u32(0x000F000F);
+    uint16x8_t c0 = vreinterpretq_u16_u32(vandq_u32(vshlq_u32(row0, vdupq_n_s32(-shift)), mask));
+    uint16x8_t c1 = vreinterpretq_u16_u32(vandq_u32(vshlq_u32(row1, vdupq_n_s32(-shift)), mask));
+    uint32x4_t sum = vaddq_u32(vpaddlq_u16(vmulq_u16(c0, vreinterpretq_u16_u32(weights0))),
+                               vpaddlq_u16(vmulq_u16(c1, vreinterpretq_u16_u32(weights1))));
+    float32x4_t step = vcvtq_f32_u32(vshrq_n_u32(vaddq_u32(sum, vdupq_n_u32(8)), 4));
+    return vdivq_f32(vmulq_f32(step, vdupq_n_f32((float)max)), vdupq_n_f32((float)SW_FILTER_STEPS));
+}
+
+static inline void sample_bilinear_neon(const sw_span_t* span, float32x4_t u, float32x4_t v, int pass_bits, int state, float32x4_t* r, float32x4_t* g, float32x4_t* b) {
+    int32x4_t x0, x1, fx, y0, y1, fy;
+    filter_texels_neon(u, TEXTURE_WIDTH << span->tex_scale_x, state & SW_STATE_CLAMP_S, &x0, &x1, &fx);
+    filter_texels_neon(v, TEXTURE_HEIGHT << span->tex_scale_y, state & SW_STATE_CLAMP_T, &y0, &y1, &fy);
+
+    int tex_shift = 5 + span->tex_scale_x;
+    bool swizzled = state & SW_STATE_SWIZZLED;
+    int32_t index[4 * 4], row[2 * 4];
+    vst1q_s32(&index[0], texel_index_neon(x0, y0, tex_shift, swizzled));
+    vst1q_s32(&index[4], texel_index_neon(x1, y0, tex_shift, swizzled));
+    vst1q_s32(&index[8], texel_index_neon(x0, y1, tex_shift, swizzled));
+    vst1q_s32(&index[12], texel_index_neon(x1, y1, tex_shift, swizzled));
+    fetch_footprints(span->tex_addr, index, row, 4, pass_bits, footprint_fetch_neon(x0, x1, y0, y1, swizzled));
+    uint32x4_t row0 = vreinterpretq_u32_s32(vld1q_s32(&row[0])), row1 = vreinterpretq_u32_s32(vld1q_s32(&row[4]));
+
+    int32x4_t weights = vorrq_s32(vsubq_s32(vdupq_n_s32(16), fx), vshlq_n_s32(fx, 16));
+    uint32x4_t weights0 = vreinterpretq_u32_s32(vmulq_s32(weights, vsubq_s32(vdupq_n_s32(16), fy)));
+    uint32x4_t weights1 = vreinterpretq_u32_s32(vmulq_s32(weights, fy));
+    *r = filter_channel_neon(row0, row1, weights0, weights1, 8, 31);
+    *g = filter_channel_neon(row0, row1, weights0, weights1, 4, 63);
+    *b = filter_channel_neon(row0, row1, weights0, weights1, 0, 31);
+}
+
+static inline uint32x4_t load_depth_neon(const sw_depth_t* depth) {
+#if DEPTH_BITS == 16
+    return vmovl_u16(vld1_u16(depth));
+#else
+    return vld1q_u32(depth);
+#endif
+}
+
+static inline void store_depth_neon(sw_depth_t* depth, uint32x4_t d) {
+#if DEPTH_BITS == 16
+    vst1_u16(depth, vmovn_u32(d));
+#else
+    vst1q_u32(depth, d);
+#endif
+}
+
+// Shade the groups of 4 pixels, returns the number of pixels shaded
+static inline __attribute__((always_inline)) int shade_span_neon(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written, int state) {
+    int tex_width = TEXTURE_WIDTH << span->tex_scale_x;
+    int tex_height = TEXTURE_HEIGHT << span->tex_scale_y;
+    int tex_shift = 5 + span->tex_scale_x;
+    static const int32_t lanes[4] = {0, 1, 2, 3};
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t n = vcvtq_f32_s32(vaddq_s32(vdupq_n_s32(first + i), vld1q_s32(lanes)));
+        float32x4_t z = lerp_neon(span->z, span->dz, n);
+
+        uint32x4_t zd = depth_neon(z);
+        uint32x4_t pass = vdupq_n_u32(0xFFFFFFFF);
+        uint32x4_t d = load_depth_neon(&depth[i]);
+        if (state & SW_STATE_DEPTH_TEST)
+            pass = vcgtq_u32(zd, d);
+        uint32_t pass_lanes[4];
+        vst1q_u32(pass_lanes, pass);
+        if (vmaxvq_u32(pass) == 0)
+            continue;
+
+        float32x4_t u = lerp_neon(span->u, span->du, n);
+        float32x4_t v = lerp_neon(span->v, span->dv, n);
+        float32x4_t r = lerp_neon(span->r, span->dr, n);
+        float32x4_t g = lerp_neon(span->g, span->dg, n);
+        float32x4_t b = lerp_neon(span->b, span->db, n);
+
+        // Perspective correction
+        if (state & SW_STATE_PERSP_CORRECT) {
+            float32x4_t inv_z = vbslq_f32(vcgtq_f32(z, vdupq_n_f32(0.0f)), vdivq_f32(vdupq_n_f32(1.0f), z), vdupq_n_f32(1.0f));
+            u = vmulq_f32(u, inv_z);
+            v = vmulq_f32(v, inv_z);
+            r = vmulq_f32(r, inv_z);
+            g = vmulq_f32(g, inv_z);
+            b = vmulq_f32(b, inv_z);
+        }
+
+        u = state & SW_STATE_CLAMP_S ? clamp_neon(u) : wrap_neon(u);
+        v = state & SW_STATE_CLAMP_T ? clamp_neon(v) : wrap_neon(v);
+
+        float32x4_t sr = vdupq_n_f32(31.0f), sg = vdupq_n_f32(63.0f), sb = vdupq_n_f32(31.0f);
+        if ((state & SW_STATE_TEXTURED) && (state & SW_STATE_BILINEAR)) {
+            int pass_bits = (pass_lanes[0] ? 1 : 0) | (pass_lanes[1] ? 2 : 0) | (pass_lanes[2] ? 4 : 0) | (pass_lanes[3] ? 8 : 0);
+            sample_bilinear_neon(span, u, v, pass_bits, state, &sr, &sg, &sb);
+        } else if (state & SW_STATE_TEXTURED) {
+            int32x4_t x = vcvtq_s32_f32(vmulq_f32(u, vdupq_n_f32((float)tex_width)));
+            int32x4_t y = vcvtq_s32_f32(vmulq_f32(v, vdupq_n_f32((float)tex_height)));
+            int32x4_t x_max = vdupq_n_s32(tex_width - 1);
+            int32x4_t y_max = vdupq_n_s32(tex_height - 1);
+            x = vbslq_s32(vcgtq_s32(x, x_max), x_max, x);
+            y = vbslq_s32(vcgtq_s32(y, y_max), y_max, y);
+
+            // the texels of the rejected pixels are not fetched, their coordinates may be anything
+            int32_t index[4], texel[4];
+            vst1q_s32(index, texel_index_neon(x, y, tex_shift, state & SW_STATE_SWIZZLED));
+            for (int k = 0; k < 4; ++k)
+                texel[k] = pass_lanes[k] ? span->tex_addr[index[k]] : 0;
+            int32x4_t c = vld1q_s32(texel);
+
+            int32x4_t mask = vdupq_n_s32(0xF);
+            sr = lookup_neon(sw_get_texel_channels(5), vandq_s32(vshrq_n_s32(c, 8), mask));
+            sg = lookup_neon(sw_get_texel_channels(6), vandq_s32(vshrq_n_s32(c, 4), mask));
+            sb = lookup_neon(sw_get_texel_channels(5), vandq_s32(c, mask));
+        }
+
+        int32x4_t rr = vcvtq_s32_f32(vmulq_f32(r, sr));
+        int32x4_t gg = vcvtq_s32_f32(vmulq_f32(g, sg));
+        int32x4_t bb = vcvtq_s32_f32(vmulq_f32(b, sb));
+        int32_t color[4];
+        vst1q_s32(color, vorrq_s32(vorrq_s32(vshlq_n_s32(rr, 11), vshlq_n_s32(gg, 5)), bb));
+
+        store_depth_neon(&depth[i], vbslq_u32(pass, zd, d));
+        for (int k = 0; k < 4; ++k) {
+            if (pass_lanes[k]) {
+                colors[i + k] = (uint16_t)color[k];
+                written[i + k] = true;
+            }
+        }
+    }
+    return i;
+}
+
+void sw_shade_span_neon(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) {
+    int i = shade_span_neon(span, first, count, depth, colors, written, span_state(span));
+    sw_shade_span_scalar(span, first + i, count - i, &depth[i], &colors[i], &written[i]);
+}
+
+#endif
+
+static const sw_span_kernel_t g_span_kernels[] = {
+    {"scalar", sw_shade_span_scalar},
+#if defined(SW_HAS_SSE2)
+    {"sse2", sw_shade_span_sse2},
+#endif
+#if defined(SW_HAS_NEON)
+    {"neon", sw_shade_span_neon},
+#endif
+#if defined(SW_HAS_AVX2)
+    {"avx2", sw_shade_span_avx2},
+#endif
+};
+
+const sw_span_kernel_t* sw_get_span_kernels(size_t* nb_kernels) {
+    *nb_kernels = sizeof(g_span_kernels) / sizeof(g_span_kernels[0]);
+    return g_span_kernels;
+}
+
+void sw_shade_span(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) {
+#if defined(SW_HAS_AVX2)
+    sw_shade_span_avx2(span, first, count, depth, colors, written);
+#elif defined(SW_HAS_SSE2)
+    sw_shade_span_sse2(span, first, count, depth, colors, written);
+#elif defined(SW_HAS_NEON)
+    sw_shade_span_neon(span, first, count, depth, colors, written);
+#else
+    sw_shade_span_scalar(span, first, count, depth, colors, written);
+#endif
+}
+
+#if defined(SW_HAS_AVX2) || defined(SW_HAS_SSE2) || defined(SW_HAS_NEON)
+
+// The widest kernel specialized for each render state, the tail of the span goes to the specialized scalar kernel
+#define SPAN_VARIANT(state) \
+    static void shade_span_##state(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) { \
+        int i = shade_span_simd(span, first, count, depth, colors, written, state); \
+        sw_get_span_variant_scalar(state)(span, first + i, count - i, &depth[i], &colors[i], &written[i]); \
+    }
+
+static inline __attribute__((always_inline)) int shade_span_simd(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written, int state) {
+#if defined(SW_HAS_AVX2)
+    int i = shade_span_avx2(span, first, count, depth, colors, written, state);
+#if defined(SW_HAS_SSE2)
+    i += shade_span_sse2(span, first + i, count - i, &depth[i], &colors[i], &written[i], state);
+#endif
+    return i;
+#elif defined(SW_HAS_SSE2)
+    return shade_span_sse2(span, first, count, depth, colors, written, state);
+#else
+    return shade_span_neon(span, first, count, depth, colors, written, state);
+#endif
+}
+
+SW_FOR_EACH_STATE(SPAN_VARIANT)
+
+#define SPAN_VARIANT_ENTRY(state) shade_span_##state,
+static const sw_span_fn_t g_span_variants[SW_NB_STATES] = {SW_FOR_EACH_STATE(SPAN_VARIANT_ENTRY)};
+
+#endif
+
+void sw_set_span_specialization(bool enabled) {
+    g_specialize = enabled;
+}
+
+static sw_span_fn_t span_fn(int state) {
+    if (!g_specialize)
+        return sw_shade_span;
+
+#if defined(SW_HAS_AVX2) || defined(SW_HAS_SSE2) || defined(SW_HAS_NEON)
+    return g_span_variants[state];
+#else
+    return sw_get_span_variant_scalar(state);
+#endif
+}
+
+void sw_set_persp_span_length(int length) {
+    g_persp_span_shift = 0;
+    while (length >> (g_persp_span_shift + 1))
+        g_persp_span_shift++;
+    g_persp_span_length = g_persp_span_shift > 0 ? 1 << g_persp_span_shift : 0;
+}
+
+int sw_get_persp_span_length() {
+    return g_persp_span_length;
+}
+
+void sw_measure_persp_error(bool enabled) {
+    g_measure_persp_error = enabled;
+}
+
+void sw_get_persp_error(sw_persp_error_t* error) { *error = g_persp_error; }
+
+void sw_reset_persp_error() {
+    g_persp_error = (sw_persp_error_t){0};
+}
+
+// Perspective correct u, v, r, g, b of pixel n of the span, false when its w is not positive
+static bool persp_attrs(const sw_span_t* span, int n, fx32 attrs[5]) {
+    fx32 z = span->z + span->dz * n;
+    if (z <= FXS(0.0f, SCALE_Z))
+        return false;
+    fx32 w = DIVS(FXS(1.0f, SCALE_W), z, SCALE_Z);
+    attrs[0] = MULS(span->u + span->du * n, w, SCALE_W);
+    attrs[1] = MULS(span->v + span->dv * n, w, SCALE_W);
+    attrs[2] = MULS(span->r + span->dr * n, w, SCALE_W);
+    attrs[3] = MULS(span->g + span->dg * n, w, SCALE_W);
+    attrs[4] = MULS(span->b + span->db * n, w, SCALE_W);
+    return true;
+}
+
+// Texture coordinate error in texels of the pixels of a segment against their exact perspective correction
+static void measure_persp_error(const sw_span_t* span, const sw_span_t* segment, int first, int count) {
+    float tex_width = (float)(TEXTURE_WIDTH << span->tex_scale_x);
+    float tex_height = (float)(TEXTURE_HEIGHT << span->tex_scale_y);
+    for (int n = first; n < first + count; ++n) {
+        fx32 exact[5];
+        if (!persp_attrs(span, n, exact))
+            continue;
+        float du = fabsf(FLTS(segment->u + segment->du * n - exact[0], SCALE_UV)) * tex_width;
+        float dv = fabsf(FLTS(segment->v + segment->dv * n - exact[1], SCALE_UV)) * tex_height;
+        float error = du > dv ? du : dv;
+        g_persp_error.nb_pixels++;
+        g_persp_error.sum_error += error;
+        if (error > g_persp_error.max_error)
+            g_persp_error.max_error = error;
+    }
+}
+
+// Step of a segment between attributes d apart, the segment length being a power of two it is a shift rather
+// than a divide in fixed point
+static inline fx32 segment_step(fx32 d, int shift) {
+#if FIXED_POINT
+    return d >> shift;
+#else
+    return d * (1.0f / (float)(1 << shift));
+#endif
+}
+
+// Quake style perspective correction: the attributes are exact at every g_persp_span_length pixels of the
+// span and interpolated linearly in between by the affine kernel. The segments are aligned on the start of the
+// span, so the result does not depend on how the span is split into calls. A segment whose far end is behind
+// the eye, where the plane of the triangle has no perspective projection, is shaded exactly.
+static void shade_span_subdivided(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written) {
+    int state = span_state(span);
+    sw_span_fn_t affine = span_fn(state & ~SW_STATE_PERSP_CORRECT);
+    sw_span_fn_t exact = span_fn(state);
+    int length = g_persp_span_length;
+    int shift = g_persp_span_shift;
+    int last = first + count;
+
+    // a0 is not known after a skipped segment
+    int start = first - first % length;
+    fx32 a0[5], a1[5];
+    bool known = false, valid = false;
+
+    // the steps keep the depth of the span, the attributes are rebased at its first pixel
+    sw_span_t segment = *span;
+    segment.persp_correct = false;
+    for (; start < last; start += length) {
+        int n = start > first ? start : first;
+        int end = start + length < last ? start + length : last;
+
+        // The segments without a pixel in front of the depth buffer skip their perspective correction,
+        // the SIMD kernels test the depth of their pixels first anyway
+        if (SW_SCAN_OCCLUDED_RUNS && (state & SW_STATE_DEPTH_TEST)) {
+            n += sw_depth_occluded_run(span->z, span->dz, n, end - n, &depth[n - first]);
+            if (n == end) {
+                known = false;
+                continue;
+            }
+        }
+
+        if (!known)
+            valid = persp_attrs(span, start, a0);
+        bool next_valid = persp_attrs(span, start + length, a1);
+
+        if (valid && next_valid) {
+            segment.du = segment_step(a1[0] - a0[0], shift);
+            segment.dv = segment_step(a1[1] - a0[1], shift);
+            segment.dr = segment_step(a1[2] - a0[2], shift);
+            segment.dg = segment_step(a1[3] - a0[3], shift);
+            segment.db = segment_step(a1[4] - a0[4], shift);
+            segment.u = a0[0] - segment.du * start;
+            segment.v = a0[1] - segment.dv * start;
+            segment.r = a0[2] - segment.dr * start;
+            segment.g = a0[3] - segment.dg * start;
+            segment.b = a0[4] - segment.db * start;
+            affine(&segment, n, end - n, &depth[n - first], &colors[n - first], &written[n - first]);
+            if (g_measure_persp_error && span->tex_addr)
+                measure_persp_error(span, &segment, n, end - n);
+        } else {
+            exact(span, n, end - n, &depth[n - first], &colors[n - first], &written[n - first]);
+        }
+
+        for (int i = 0; i < 5; ++i)
+            a0[i] = a1[i];
+        valid = next_valid;
+        known = true;
+    }
+}
+
+sw_span_fn_t sw_select_span_fn(const uint16_t* tex_addr, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct) {
+    if (persp_correct && g_persp_span_length > 0)
+        return shade_span_subdivided;
+
+    return span_fn(sw_get_render_state(tex_addr, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct));
+}
+
+int sw_depth_occluded_run(fx32 z, fx32 dz, int first, int count, const sw_depth_t* depth) {
+    int i = 0;
+    while (i < count && !(sw_depth(z + dz * (first + i)) > depth[i]))
+        ++i;
+    return i;
+}
+
+void sw_fragment_shader_span(int fb_width, int fb_height, int x, int y, int first, int count, const sw_span_t* span, sw_span_fn_t shade, sw_depth_t* depth_buffer, uint16_t* color_buffer) {
+    if (y < 0 || y >= fb_height)
+        return;
+
+    // pixels of the span inside the framebuffer
+    int last = first + count;
+    if (first < -x)
+        first = -x;
+    if (last > fb_width - x)
+        last = fb_width - x;
+
+    // the buffers need no written flags
+    bool written[SPAN_CHUNK];
+    int offset = y * fb_width + x;
+    for (int i = first; i < last; i += SPAN_CHUNK) {
+        int n = last - i < SPAN_CHUNK ? last - i : SPAN_CHUNK;
+        shade(span, i, n, &depth_buffer[offset + i], &color_buffer[offset + i], written);
+    }
+}
@@ -0,0 +1,248 @@
+// sw_hiz.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+// Hierarchical Z of the depth buffer shared by the standard, standard2 and barycentric rasterizers.
+// Level 0 keeps the farthest depth of each SW_HIZ_BLOCK_SIZE x SW_HIZ_BLOCK_SIZE block, level 1 the farthest
+// depth of each SW_HIZ_REGION_BLOCKS x SW_HIZ_REGION_BLOCKS blocks. With the depth test the depths only get
+// nearer, so a farthest depth stays a bound of its pixels: the blocks under the bounding box of a triangle are
+// flagged before it is drawn and recomputed when a triangle query needs them. A write without the depth test can
+// make a pixel farther, its blocks drop to 0 at once. Nothing is tracked while the culling is off, the bounds
+// drop to 0 when it is back on.
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sw_rasterizer.h"
+
+typedef struct {
+    int nb_x, nb_y;
+    sw_depth_t* farthest;
+    bool* dirty;        // written since farthest was computed
+} level_t;
+
+static int g_fb_width, g_fb_height;
+static const sw_depth_t* g_depth_buffer;
+
+static level_t g_blocks, g_regions;
+static bool g_enabled = false;
+
+static sw_hiz_stats_t g_stats;
+
+#define REGION_SIZE (SW_HIZ_BLOCK_SIZE * SW_HIZ_REGION_BLOCKS)
+
+static int min(int a, int b) { return (a <= b) ? a : b; }
+
+static int max(int a, int b) { return (a >= b) ? a : b; }
+
+static void init_level(level_t* level, int size) {
+    level->nb_x = (g_fb_width + size - 1) / size;
+    level->nb_y = (g_fb_height + size - 1) / size;
+    level->farthest = (sw_depth_t*)calloc(level->nb_x * level->nb_y, sizeof(sw_depth_t));
+    level->dirty = (bool*)calloc(level->nb_x * level->nb_y, sizeof(bool));
+}
+
+static void dispose_level(level_t* level) {
+    free(level->farthest);
+    free(level->dirty);
+    memset(level, 0, sizeof(level_t));
+}
+
+void sw_init_hiz(int fb_width, int fb_height, const sw_depth_t* depth_buffer) {
+    g_fb_width = fb_width;
+    g_fb_height = fb_height;
+    g_depth_buffer = depth_buffer;
+    init_level(&g_blocks, SW_HIZ_BLOCK_SIZE);
+    init_level(&g_regions, REGION_SIZE);
+}
+
+void sw_dispose_hiz() {
+    dispose_level(&g_blocks);
+    dispose_level(&g_regions);
+    g_depth_buffer = NULL;
+}
+
+void sw_clear_hiz() {
+    if (!g_depth_buffer)
+        return;
+    memset(g_blocks.farthest, 0, g_blocks.nb_x * g_blocks.nb_y * sizeof(sw_depth_t));
+    memset(g_blocks.dirty, 0, g_blocks.nb_x * g_blocks.nb_y * sizeof(bool));
+    memset(g_regions.farthest, 0, g_regions.nb_x * g_regions.nb_y * sizeof(sw_depth_t));
+    memset(g_regions.dirty, 0, g_regions.nb_x * g_regions.nb_y * sizeof(bool));
+}
+
+void sw_set_hiz(bool enabled) {
+    if (enabled && !g_enabled && g_depth_buffer) {
+        memset(g_blocks.farthest, 0, g_blocks.nb_x * g_blocks.nb_y * sizeof(sw_depth_t));
+        memset(g_blocks.dirty, true, g_blocks.nb_x * g_blocks.nb_y * sizeof(bool));
+        memset(g_regions.farthest, 0, g_regions.nb_x * g_regions.nb_y * sizeof(sw_depth_t));
+        memset(g_regions.dirty, true, g_regions.nb_x * g_regions.nb_y * sizeof(bool));
+    }
+    g_enabled = enabled;
+}
+
+static void mark_level(level_t* level, int size, int min_x, int min_y, int max_x, int max_y, bool depth_test) {
+    for (int y = min_y / size; y <= max_y / size; ++y) {
+        for (int x = min_x / size; x <= max_x / size; ++x) {
+            int i = y * level->nb_x + x;
+            level->dirty[i] = true;
+            if (!depth_test)
+                level->farthest[i] = 0;
+        }
+    }
+}
+
+// Bounding box of the triangle in pixels, with a pixel of margin for the rounding of the edges
+static void triangle_bounds(fx32 x0, fx32 y0, fx32 x1, fx32 y1, fx32 x2, fx32 y2, int* min_x, int* min_y, int* max_x,
+                            int* max_y) {
+    fx32 x_min = x0 < x1 ? (x0 < x2 ? x0 : x2) : (x1 < x2 ? x1 : x2);
+    fx32 x_max = x0 > x1 ? (x0 > x2 ? x0 : x2) : (x1 > x2 ? x1 : x2);
+    fx32 y_min = y0 < y1 ? (y0 < y2 ? y0 : y2) : (y1 < y2 ? y1 : y2);
+    fx32 y_max = y0 > y1 ? (y0 > y2 ? y0 : y2) : (y1 > y2 ? y1 : y2);
+    *min_x = INTS(x_min, SCALE_POS) - 1;
+    *min_y = INTS(y_min, SCALE_POS) - 1;
+    *max_x = INTS(x_max, SCALE_POS) + 2;
+    *max_y = INTS(y_max, SCALE_POS) + 2;
+}
+
+void sw_hiz_update_triangle(fx32 x0, fx32 y0, fx32 x1, fx32 y1, fx32 x2, fx32 y2, bool depth_test) {
+    if (!g_depth_buffer || !g_enabled)
+        return;
+    int min_x, min_y, max_x, max_y;
+    triangle_bounds(x0, y0, x1, y1, x2, y2, &min_x, &min_y, &max_x, &max_y);
+    min_x = max(min_x, 0);
+    min_y = max(min_y, 0);
+    max_x = min(max_x, g_fb_width - 1);
+    max_y = min(max_y, g_fb_height - 1);
+    if (max_x < min_x || max_y < min_y)
+        return;
+
+    mark_level(&g_blocks, SW_HIZ_BLOCK_SIZE, min_x, min_y, max_x, max_y, depth_test);
+    mark_level(&g_regions, REGION_SIZE, min_x, min_y, max_x, max_y, depth_test);
+}
+
+// True when no pixel of the block can pass the depth test with the depth nearest. A flagged block is scanned
+// until a pixel farther than nearest, most of the blocks of the drawn triangles stop at their first pixels.
+// The farthest depth of a block is only kept once the whole block is scanned.
+static bool block_behind(int bx, int by, sw_depth_t nearest) {
+    int i = by * g_blocks.nb_x + bx;
+    if (!g_blocks.dirty[i])
+        return nearest <= g_blocks.farthest[i];
+
+    int x1 = min((bx + 1) * SW_HIZ_BLOCK_SIZE, g_fb_width);
+    int y1 = min((by + 1) * SW_HIZ_BLOCK_SIZE, g_fb_height);
+    sw_depth_t farthest = SW_DEPTH_MAX;
+    for (int y = by * SW_HIZ_BLOCK_SIZE; y < y1; ++y) {
+        const sw_depth_t* row = &g_depth_buffer[y * g_fb_width];
+        for (int x = bx * SW_HIZ_BLOCK_SIZE; x < x1; ++x)
+            farthest = row[x] < farthest ? row[x] : farthest;
+        if (nearest > farthest)
+            return false;
+    }
+    g_blocks.farthest[i] = farthest;
+    g_blocks.dirty[i] = false;
+    return true;
+}
+
+// Farthest depth of a region whose blocks are all known
+static sw_depth_t region_farthest(int rx, int ry) {
+    int bx1 = min((rx + 1) * SW_HIZ_REGION_BLOCKS, g_blocks.nb_x);
+    int by1 = min((ry + 1) * SW_HIZ_REGION_BLOCKS, g_blocks.nb_y);
+    sw_depth_t farthest = SW_DEPTH_MAX;
+    for (int by = ry * SW_HIZ_REGION_BLOCKS; by < by1; ++by) {
+        for (int bx = rx * SW_HIZ_REGION_BLOCKS; bx < bx1; ++bx) {
+            sw_depth_t d = g_blocks.farthest[by * g_blocks.nb_x + bx];
+            farthest = d < farthest ? d : farthest;
+        }
+    }
+    return farthest;
+}
+
+// True when no pixel of the rectangle can pass the depth test with the depth nearest. The known regions inside
+// the rectangle are tested first, the blocks of the others are tested one by one. A region inside the rectangle
+// whose blocks are all behind is known from then on.
+static bool occluded(int min_x, int min_y, int max_x, int max_y, sw_depth_t nearest) {
+    min_x = max(min_x, 0);
+    min_y = max(min_y, 0);
+    max_x = min(max_x, g_fb_width - 1);
+    max_y = min(max_y, g_fb_height - 1);
+    if (max_x < min_x || max_y < min_y)
+        return false;
+
+    int bx0 = min_x / SW_HIZ_BLOCK_SIZE, bx1 = max_x / SW_HIZ_BLOCK_SIZE;
+    int by0 = min_y / SW_HIZ_BLOCK_SIZE, by1 = max_y / SW_HIZ_BLOCK_SIZE;
+    for (int ry = by0 / SW_HIZ_REGION_BLOCKS; ry <= by1 / SW_HIZ_REGION_BLOCKS; ++ry) {
+        int ry0 = max(ry * SW_HIZ_REGION_BLOCKS, by0);
+        int ry1 = min((ry + 1) * SW_HIZ_REGION_BLOCKS - 1, by1);
+        for (int rx = bx0 / SW_HIZ_REGION_BLOCKS; rx <= bx1 / SW_HIZ_REGION_BLOCKS; ++rx) {
+            int rx0 = max(rx * SW_HIZ_REGION_BLOCKS, bx0);
+            int rx1 = min((rx + 1) * SW_HIZ_REGION_BLOCKS - 1, bx1);
+            bool inside = rx0 == rx * SW_HIZ_REGION_BLOCKS && ry0 == ry * SW_HIZ_REGION_BLOCKS &&
+                          rx1 == min((rx + 1) * SW_HIZ_REGION_BLOCKS, g_blocks.nb_x) - 1 &&
+                          ry1 == min((ry + 1) * SW_HIZ_REGION_BLOCKS, g_blocks.nb_y) - 1;
+            int i = ry * g_regions.nb_x + rx;
+            if (inside && !g_regions.dirty[i] && nearest <= g_regions.farthest[i])
+                continue;
+            for (int by = ry0; by <= ry1; ++by)
+                for (int bx = rx0; bx <= rx1; ++bx)
+                    if (!block_behind(bx, by, nearest))
+                        return false;
+            if (inside) {
+                g_regions.farthest[i] = region_farthest(rx, ry);
+                g_regions.dirty[i] = false;
+            }
+        }
+    }
+    return true;
+}
+
+// The interpolation of the rasterizers rounds, the depth of a pixel can pass the nearest vertex by a little
+static sw_depth_t nearest_depth(fx32 z) { return sw_depth(z + z / 1024 + FXS(1.0f / 65536.0f, SCALE_Z)); }
+
+bool sw_hiz_cull_triangle(fx32 x0, fx32 y0, fx32 z0, fx32 x1, fx32 y1, fx32 z1, fx32 x2, fx32 y2, fx32 z2) {
+    if (!g_depth_buffer || !g_enabled)
+        return false;
+
+    int min_x, min_y, max_x, max_y;
+    triangle_bounds(x0, y0, x1, y1, x2, y2, &min_x, &min_y, &max_x, &max_y);
+    fx32 z = z0 > z1 ? (z0 > z2 ? z0 : z2) : (z1 > z2 ? z1 : z2);
+
+    g_stats.nb_triangles++;
+    if (!occluded(min_x, min_y, max_x, max_y, nearest_depth(z)))
+        return false;
+    g_stats.nb_culled_triangles++;
+    return true;
+}
+
+// True when the bounds of the blocks under the rectangle are behind the depth nearest, flagged or not. Nothing is
+// recomputed: the blocks a triangle query found behind are known, and a block query that scanned the depth
+// buffer would cost more than the pixels it saves.
+static bool known_behind(int min_x, int min_y, int max_x, int max_y, sw_depth_t nearest) {
+    min_x = max(min_x, 0);
+    min_y = max(min_y, 0);
+    max_x = min(max_x, g_fb_width - 1);
+    max_y = min(max_y, g_fb_height - 1);
+    if (max_x < min_x || max_y < min_y)
+        return false;
+    for (int by = min_y / SW_HIZ_BLOCK_SIZE; by <= max_y / SW_HIZ_BLOCK_SIZE; ++by)
+        for (int bx = min_x / SW_HIZ_BLOCK_SIZE; bx <= max_x / SW_HIZ_BLOCK_SIZE; ++bx)
+            if (nearest > g_blocks.farthest[by * g_blocks.nb_x + bx])
+                return false;
+    return true;
+}
+
+bool sw_hiz_cull_block(int min_x, int min_y, int max_x, int max_y, fx32 z) {
+    if (!g_depth_buffer || !g_enabled)
+        return false;
+
+    g_stats.nb_blocks++;
+    if (!known_behind(min_x, min_y, max_x, max_y, nearest_depth(z)))
+        return false;
+    g_stats.nb_culled_blocks++;
+    return true;
+}
+
+void sw_get_stats_hiz(sw_hiz_stats_t* stats) { *stats = g_stats; }
+
+void sw_reset_stats_hiz() { memset(&g_stats, 0, sizeof(g_stats)); }
@@ -0,0 +1,167 @@
+// sw_mipmap.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+// Mip chains of the textures and the selection of their levels by the rasterizers.
+// The levels of a chain follow its base level in memory, level n halves level n - 1 in both directions until
+// a direction is TEXTURE_WIDTH or TEXTURE_HEIGHT texels, the smallest size of the texture addressing.
+// The level of a span is chosen from the screen space derivatives of the texture coordinates at one of its
+// pixels: the footprint of the pixel in texels of the base level, rounded to the nearest power of two.
+// A chain can be reordered once built into the swizzled layout of sw_texel_index(), level by level.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sw_rasterizer.h"
+
+#define TEXTURE_WIDTH   32
+#define TEXTURE_HEIGHT  32
+
+static bool g_enabled = true;
+
+static int level_scale(int scale, int level) { return scale > level ? scale - level : 0; }
+
+int sw_mip_nb_levels(int tex_scale_x, int tex_scale_y) { return 1 + (tex_scale_x > tex_scale_y ? tex_scale_x : tex_scale_y); }
+
+size_t sw_mip_chain_size(int tex_scale_x, int tex_scale_y) {
+    size_t size = 0;
+    for (int level = 0; level < sw_mip_nb_levels(tex_scale_x, tex_scale_y); ++level)
+        size += (size_t)(TEXTURE_WIDTH << level_scale(tex_scale_x, level)) * (TEXTURE_HEIGHT << level_scale(tex_scale_y, level));
+    return size;
+}
+
+const uint16_t* sw_mip_level(const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int level, int* level_scale_x,
+                             int* level_scale_y) {
+    for (int i = 0; i < level; ++i)
+        tex_addr += (TEXTURE_WIDTH << level_scale(tex_scale_x, i)) * (TEXTURE_HEIGHT << level_scale(tex_scale_y, i));
+    *level_scale_x = level_scale(tex_scale_x, level);
+    *level_scale_y = level_scale(tex_scale_y, level);
+    return tex_addr;
+}
+
+void sw_build_mip_chain(uint16_t* tex_addr, int tex_scale_x, int tex_scale_y) {
+    int nb_levels = sw_mip_nb_levels(tex_scale_x, tex_scale_y);
+    for (int level = 1; level < nb_levels; ++level) {
+        int src_scale_x, src_scale_y, dst_scale_x, dst_scale_y;
+        const uint16_t* src = sw_mip_level(tex_addr, tex_scale_x, tex_scale_y, level - 1, &src_scale_x, &src_scale_y);
+        uint16_t* dst = (uint16_t*)sw_mip_level(tex_addr, tex_scale_x, tex_scale_y, level, &dst_scale_x, &dst_scale_y);
+        int src_width = TEXTURE_WIDTH << src_scale_x;
+        int dst_width = TEXTURE_WIDTH << dst_scale_x, dst_height = TEXTURE_HEIGHT << dst_scale_y;
+
+        // Box filter of the 2x2, 2x1 or 1x2 texels of the level before, each 4-bit channel rounded
+        int fx = src_scale_x - dst_scale_x + 1, fy = src_scale_y - dst_scale_y + 1;
+        int count = fx * fy;
+        for (int y = 0; y < dst_height; ++y) {
+            for (int x = 0; x < dst_width; ++x) {
+                int sum[4] = {0, 0, 0, 0};
+                for (int j = 0; j < fy; ++j) {
+                    for (int i = 0; i < fx; ++i) {
+                        uint16_t c = src[(y * fy + j) * src_width + x * fx + i];
+                        for (int k = 0; k < 4; ++k)
+                            sum[k] += (c >> (4 * k)) & 0xF;
+                    }
+                }
+                uint16_t c = 0;
+                for (int k = 0; k < 4; ++k)
+                    c |= ((sum[k] + count / 2) / count) << (4 * k);
+                dst[y * dst_width + x] = c;
+            }
+        }
+    }
+}
+
+void sw_swizzle_mip_chain(uint16_t* tex_addr, int tex_scale_x, int tex_scale_y) {
+    int nb_levels = sw_mip_nb_levels(tex_scale_x, tex_scale_y);
+    size_t width = TEXTURE_WIDTH << tex_scale_x, height = TEXTURE_HEIGHT << tex_scale_y;
+    uint16_t* row_major = (uint16_t*)malloc(width * height * sizeof(uint16_t));
+    for (int level = 0; level < nb_levels; ++level) {
+        int level_scale_x, level_scale_y;
+        uint16_t* dst = (uint16_t*)sw_mip_level(tex_addr, tex_scale_x, tex_scale_y, level, &level_scale_x, &level_scale_y);
+        int level_width = TEXTURE_WIDTH << level_scale_x, level_height = TEXTURE_HEIGHT << level_scale_y;
+        memcpy(row_major, dst, (size_t)level_width * level_height * sizeof(uint16_t));
+        for (int y = 0; y < level_height; ++y)
+            for (int x = 0; x < level_width; ++x)
+                dst[sw_texel_index(x, y, level_scale_x, true)] = row_major[y * level_width + x];
+    }
+    free(row_major);
+}
+
+void sw_set_mipmap(bool enabled) { g_enabled = enabled; }
+
+// Level of a squared footprint of rho2 texels of the base level, log2(rho) rounded
+static int footprint_level(float rho2, int nb_levels) {
+    if (!(rho2 >= 2.0f))
+        return 0;
+    if (rho2 >= (float)(1 << (2 * nb_levels - 3)))
+        return nb_levels - 1;
+    int e;
+    frexpf(rho2, &e);
+    return e / 2;
+}
+
+void sw_init_mip(sw_mip_t* mip, fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 x1, fx32 y1, fx32 z1, fx32 u1,
+                 fx32 v1, fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, const uint16_t* tex_addr, int tex_scale_x,
+                 int tex_scale_y, int tex_nb_levels, bool persp_correct) {
+    mip->tex_addr = tex_addr;
+    mip->tex_scale_x = tex_scale_x;
+    mip->tex_scale_y = tex_scale_y;
+    mip->nb_levels = (g_enabled && tex_addr) ? tex_nb_levels : 1;
+    mip->level = 0;
+    mip->persp_correct = persp_correct;
+    if (mip->nb_levels <= 1)
+        return;
+
+    // Planes of the attributes, the texture coordinates in texels of the base level
+    float ax = FLTS(x1 - x0, SCALE_POS), ay = FLTS(y1 - y0, SCALE_POS);
+    float bx = FLTS(x2 - x0, SCALE_POS), by = FLTS(y2 - y0, SCALE_POS);
+    float area = ax * by - bx * ay;
+    if (fabsf(area) < 1.0f / 256.0f) {
+        mip->nb_levels = 1;
+        return;
+    }
+    float inv_area = 1.0f / area;
+    mip->width = (float)(TEXTURE_WIDTH << tex_scale_x);
+    mip->height = (float)(TEXTURE_HEIGHT << tex_scale_y);
+
+    float du1 = FLTS(u1 - u0, SCALE_UV) * mip->width, du2 = FLTS(u2 - u0, SCALE_UV) * mip->width;
+    float dv1 = FLTS(v1 - v0, SCALE_UV) * mip->height, dv2 = FLTS(v2 - v0, SCALE_UV) * mip->height;
+    float dz1 = FLTS(z1 - z0, SCALE_Z), dz2 = FLTS(z2 - z0, SCALE_Z);
+    mip->du_dx = (du1 * by - du2 * ay) * inv_area;
+    mip->du_dy = (du2 * ax - du1 * bx) * inv_area;
+    mip->dv_dx = (dv1 * by - dv2 * ay) * inv_area;
+    mip->dv_dy = (dv2 * ax - dv1 * bx) * inv_area;
+    mip->dz_dx = (dz1 * by - dz2 * ay) * inv_area;
+    mip->dz_dy = (dz2 * ax - dz1 * bx) * inv_area;
+
+    // Without the perspective correction the derivatives are the same at every pixel
+    if (!persp_correct) {
+        float rho2_x = mip->du_dx * mip->du_dx + mip->dv_dx * mip->dv_dx;
+        float rho2_y = mip->du_dy * mip->du_dy + mip->dv_dy * mip->dv_dy;
+        mip->level = footprint_level(rho2_x > rho2_y ? rho2_x : rho2_y, mip->nb_levels);
+    }
+}
+
+const uint16_t* sw_select_mip(const sw_mip_t* mip, fx32 z, fx32 u, fx32 v, int* tex_scale_x, int* tex_scale_y) {
+    int level = mip->level;
+    if (mip->persp_correct && mip->nb_levels > 1) {
+        // u / z is interpolated, its derivative is (du * z - u * dz) / z^2
+        float w = FLTS(z, SCALE_Z);
+        if (w > 0.0f) {
+            float uu = FLTS(u, SCALE_UV) * mip->width, vv = FLTS(v, SCALE_UV) * mip->height;
+            float s = 1.0f / (w * w);
+            float ux = (mip->du_dx * w - uu * mip->dz_dx) * s, uy = (mip->du_dy * w - uu * mip->dz_dy) * s;
+            float vx = (mip->dv_dx * w - vv * mip->dz_dx) * s, vy = (mip->dv_dy * w - vv * mip->dz_dy) * s;
+            float rho2_x = ux * ux + vx * vx, rho2_y = uy * uy + vy * vy;
+            level = footprint_level(rho2_x > rho2_y ? rho2_x : rho2_y, mip->nb_levels);
+        }
+    }
+    if (level == 0) {
+        *tex_scale_x = mip->tex_scale_x;
+        *tex_scale_y = mip->tex_scale_y;
+        return mip->tex_addr;
+    }
+    return sw_mip_level(mip->tex_addr, mip->tex_scale_x, mip->tex_scale_y, level, tex_scale_x, tex_scale_y);
+}
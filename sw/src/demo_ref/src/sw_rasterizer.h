@@ -6,8 +6,11 @@
 #define SW_RASTERIZER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+// 0: float, 1: 64-bit fixed point, 2: 32-bit fixed point of the rv32 target
 #ifndef FIXED_POINT
 #define FIXED_POINT 1
 #endif
@@ -25,64 +28,442 @@
 #define _MUL(x, y, scale) (int64_t)(((int64_t)(x) * (int64_t)(y)) >> scale)
 #define _DIV(x, y, scale) (int64_t)(((int64_t)(x) << scale) / (y))
 
-// #define _MUL(x, y, scale) ((int64_t)((x) >> (scale / 2)) * (int)((y) >> (scale / 2)))
-// #define _DIV(x, y, scale) (((int64_t)(x) << (scale / 2)) / (int)((y) >> (scale / 2)))
+// Each attribute has its own scale. MULS(x, y, s) and DIVS(x, y, s) take the scale s of y,
+// their result has the scale of x. In the 64-bit mode, all the scales are SCALE.
+#if FIXED_POINT == 2
 
-#if FIXED_POINT
+typedef int32_t fx32;
+
+#define SCALE_POS       20  // screen coordinates, guard band included
+#define SCALE_EDGE      12  // edge functions and areas, products of screen coordinates
+#define SCALE_Z         24  // depth, 1/w
+#define SCALE_W         16  // w, reciprocal of the depth
+#define SCALE_UV        20  // texture coordinates, divided by w up to the near plane
+#define SCALE_COLOR     20  // colors, divided by w up to the near plane
+
+// Number of leading zeros of y > 0, without the count instruction that rv32 lacks
+static inline int sw_leading_zeros(uint32_t y) {
+    int n = 0;
+    for (int shift = 16; shift > 0; shift /= 2) {
+        if (!(y >> (32 - shift))) {
+            y <<= shift;
+            n += shift;
+        }
+    }
+    return n;
+}
+
+// (x << s) / y like _DIV, but the rv32 M extension only divides 32 bits by 32 bits and a 64-bit dividend
+// calls a slow library routine. y is normalized to [2^31, 2^32), a 32-bit division gives 16 bits of its
+// reciprocal and a Newton step 30 bits, with 32x32->64 products. The quotient by the reciprocal is off by a
+// few units and is corrected from its remainder, the result is the truncated quotient of _DIV, saturated.
+static inline fx32 sw_div(fx32 x, fx32 y, int s) {
+    uint32_t ux = x < 0 ? -(uint32_t)x : (uint32_t)x;
+    uint32_t uy = y < 0 ? -(uint32_t)y : (uint32_t)y;
+    bool negative = (x < 0) != (y < 0);
+    if (uy == 0)
+        return negative ? INT32_MIN : INT32_MAX;
+
+    int n = sw_leading_zeros(uy);
+    uint32_t yn = uy << n;
+    uint32_t r = (0xffffffffu / (yn >> 16)) << 14;                          // 2^62 / yn, 16 bits
+    uint32_t t = (uint32_t)(((uint64_t)yn * r) >> 32);                      // yn * r / 2^62 at 2^30
+    r = (uint32_t)(((uint64_t)r * ((1u << 31) - t)) >> 30);                 // r * (2 - yn * r), 30 bits, low
+
+    uint64_t q = ((uint64_t)ux * r) >> (62 - s - n);
+    if (q > INT32_MAX)
+        return negative ? INT32_MIN : INT32_MAX;
+    int64_t remainder = (int64_t)((uint64_t)ux << s) - (int64_t)(q * uy);
+    while (remainder < 0) {
+        q--;
+        remainder += uy;
+    }
+    while (remainder >= uy) {
+        q++;
+        remainder -= uy;
+    }
+    if (q > INT32_MAX)
+        return negative ? INT32_MIN : INT32_MAX;
+    return negative ? -(fx32)q : (fx32)q;
+}
+
+#elif FIXED_POINT
 
 typedef int64_t fx32;
 
 #define SCALE 24
 
-#define FX(x) ((fx32)_FLOAT_TO_FIXED(x, SCALE))
-#define FXI(x) ((fx32)_INT_TO_FIXED(x, SCALE))
-#define INT(x) ((int)_FIXED_TO_INT(x, SCALE))
-#define FLT(x) ((float)_FIXED_TO_FLOAT(x, SCALE))
-#define DIV(x, y) _DIV(x, y, SCALE)
-#define MUL(x, y) _MUL(x, y, SCALE)
+#define SCALE_POS       SCALE
+#define SCALE_EDGE      SCALE
+#define SCALE_Z         SCALE
+#define SCALE_W         SCALE
+#define SCALE_UV        SCALE
+#define SCALE_COLOR     SCALE
+
+#endif
+
+#if FIXED_POINT
+
+#define FXS(x, s) ((fx32)_FLOAT_TO_FIXED(x, s))
+#define FXIS(x, s) ((fx32)_INT_TO_FIXED(x, s))
+#define INTS(x, s) ((int)_FIXED_TO_INT(x, s))
+#define FLTS(x, s) ((float)_FIXED_TO_FLOAT(x, s))
+#define MULS(x, y, s) ((fx32)_MUL(x, y, s))
+#if FIXED_POINT == 2
+#define DIVS(x, y, s) sw_div(x, y, s)
+#else
+#define DIVS(x, y, s) ((fx32)_DIV(x, y, s))
+#endif
+
+// Product of two screen coordinates at SCALE_EDGE
+#define MUL_WIDE(x, y) ((fx32)(((int64_t)(x) >> (SCALE_POS - SCALE_EDGE / 2)) * ((int64_t)(y) >> (SCALE_POS - SCALE_EDGE / 2))))
 
 #else
 
 typedef float fx32;
 
-#define FX(x) (x)
-#define FXI(x) ((float)(x))
-#define INT(x) ((int)(x))
-#define FLT(x) (x)
-#define MUL(x, y) ((x) * (y))
-#define DIV(x, y) ((x) / (y))
+#define FXS(x, s) (x)
+#define FXIS(x, s) ((float)(x))
+#define INTS(x, s) ((int)(x))
+#define FLTS(x, s) (x)
+#define MULS(x, y, s) ((x) * (y))
+#define DIVS(x, y, s) ((x) / (y))
+#define MUL_WIDE(x, y) ((x) * (y))
+
+#endif
+
+// Depth buffer format, 1/w quantized to DEPTH_BITS bits: 16 or 32. Beyond the near plane 1/w is below 4,
+// so 32 bits keep the fixed point depth and the bits of the floating point depth without loss.
+#ifndef DEPTH_BITS
+#define DEPTH_BITS 32
+#endif
+
+#if DEPTH_BITS == 16
+typedef uint16_t sw_depth_t;
+#elif DEPTH_BITS == 32
+typedef uint32_t sw_depth_t;
+#else
+#error "DEPTH_BITS must be 16 or 32"
+#endif
+
+#define SW_DEPTH_MAX (0xffffffffu >> (32 - DEPTH_BITS))
 
+// Stored depth of z, nearer is larger and the cleared depth 0 is the farthest
+static inline sw_depth_t sw_depth(fx32 z) {
+#if FIXED_POINT
+    if (z <= 0)
+        return 0;
+#if SCALE_Z + 2 > DEPTH_BITS
+    uint64_t d = (uint64_t)z >> (SCALE_Z + 2 - DEPTH_BITS);
+#else
+    uint64_t d = (uint64_t)z << (DEPTH_BITS - SCALE_Z - 2);
+#endif
+    return d < SW_DEPTH_MAX ? (sw_depth_t)d : SW_DEPTH_MAX;
+#elif DEPTH_BITS == 32
+    // the bits of a positive float sort like its value
+    union {
+        float f;
+        uint32_t u;
+    } bits = {z > 0.0f ? z : 0.0f};
+    return bits.u;
+#else
+    float d = z * (float)(1 << (DEPTH_BITS - 2));
+    return d > 0.0f ? (d < (float)SW_DEPTH_MAX ? (sw_depth_t)d : SW_DEPTH_MAX) : 0;
+#endif
+}
+
+// SIMD fragment kernels, floating point mode only since the fixed point mode needs 64-bit products
+#if !FIXED_POINT && !defined(SW_SCALAR_SPAN)
+#if defined(__SSE2__)
+#define SW_HAS_SSE2
+#endif
+#if defined(__AVX2__)
+#define SW_HAS_AVX2
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define SW_HAS_NEON
+#endif
 #endif
 
+// Horizontal span of fragments, the attributes of pixel i are z + i * dz, u + i * du, ...
+typedef struct {
+    fx32 z, u, v, r, g, b;
+    fx32 dz, du, dv, dr, dg, db;
+    const uint16_t* tex_addr;
+    int tex_scale_x, tex_scale_y;
+    bool tex_swizzled;
+    bool clamp_s, clamp_t, depth_test, persp_correct;
+} sw_span_t;
 
-typedef void (*draw_pixel_fn_t)(int x, int y, int color);
+// Shade the pixels first to first + count - 1 of the span. depth, colors and written are the entries of
+// pixel first, the depth and color of the pixels passing the depth test are updated and written is set.
+typedef void (*sw_span_fn_t)(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written);
 
-void sw_init_rasterizer_standard(int fb_width, int fb_height, draw_pixel_fn_t draw_pixel_fn);
-void sw_init_rasterizer_standard2(int fb_width, int fb_height, draw_pixel_fn_t draw_pixel_fn);
-void sw_dispose_rasterizer_standard();
-void sw_dispose_rasterizer_standard2();
+typedef struct {
+    const char* name;
+    sw_span_fn_t fn;
+} sw_span_kernel_t;
+
+// Render state of a triangle, the span kernels are specialized for each of its SW_NB_STATES values
+#define SW_STATE_CLAMP_S        1
+#define SW_STATE_CLAMP_T        2
+#define SW_STATE_DEPTH_TEST     4
+#define SW_STATE_PERSP_CORRECT  8
+#define SW_STATE_TEXTURED       16
+#define SW_STATE_SWIZZLED       32
+#define SW_STATE_BILINEAR       64
+#define SW_NB_STATES            128
+
+#define SW_FOR_EACH_STATE(X) \
+    X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) \
+    X(32) X(33) X(34) X(35) X(36) X(37) X(38) X(39) X(40) X(41) X(42) X(43) X(44) X(45) X(46) X(47) \
+    X(48) X(49) X(50) X(51) X(52) X(53) X(54) X(55) X(56) X(57) X(58) X(59) X(60) X(61) X(62) X(63) \
+    X(64) X(65) X(66) X(67) X(68) X(69) X(70) X(71) X(72) X(73) X(74) X(75) X(76) X(77) X(78) X(79) \
+    X(80) X(81) X(82) X(83) X(84) X(85) X(86) X(87) X(88) X(89) X(90) X(91) X(92) X(93) X(94) X(95) \
+    X(96) X(97) X(98) X(99) X(100) X(101) X(102) X(103) X(104) X(105) X(106) X(107) X(108) X(109) X(110) X(111) \
+    X(112) X(113) X(114) X(115) X(116) X(117) X(118) X(119) X(120) X(121) X(122) X(123) X(124) X(125) X(126) X(127)
+
+// Parts of the column x and of the row y of the index of a texel, sw_texel_index() is their sum
+static inline int sw_texel_column(int x, bool swizzled) {
+    return swizzled ? ((x >> 2) << 4) | ((x & 2) << 1) | (x & 1) : x;
+}
+
+static inline int sw_texel_row(int y, int tex_scale_x, bool swizzled) {
+    return swizzled ? ((y >> 2) << (7 + tex_scale_x)) | ((y & 2) << 2) | ((y & 1) << 1) : y << (5 + tex_scale_x);
+}
+
+// Index of the texel x, y of a texture of 32 << tex_scale_x texels per row. The swizzled layout stores the
+// 4x4 tiles of texels row by row and the texels of a tile in Morton order, so that a 2x2 quad aligned on even
+// coordinates is contiguous. The sides of the textures and of their mip levels are multiples of 4.
+static inline int sw_texel_index(int x, int y, int tex_scale_x, bool swizzled) {
+    return sw_texel_row(y, tex_scale_x, swizzled) + sw_texel_column(x, swizzled);
+}
+
+// The 2x2 texels of the indices i00, i10, i01 and i11 of the bilinear filtering. The texels of a quad on even
+// coordinates of the swizzled layout are contiguous and loaded at once, adjacent texels of a row in pairs.
+static inline void sw_fetch_footprint(const uint16_t* tex_addr, int i00, int i10, int i01, int i11, uint16_t t[4]) {
+    if (i10 == i00 + 1 && i01 == i00 + 2 && i11 == i00 + 3) {
+        memcpy(t, &tex_addr[i00], 4 * sizeof(uint16_t));
+        return;
+    }
+    if (i10 == i00 + 1) {
+        memcpy(&t[0], &tex_addr[i00], 2 * sizeof(uint16_t));
+    } else {
+        t[0] = tex_addr[i00];
+        t[1] = tex_addr[i10];
+    }
+    if (i11 == i01 + 1) {
+        memcpy(&t[2], &tex_addr[i01], 2 * sizeof(uint16_t));
+    } else {
+        t[2] = tex_addr[i01];
+        t[3] = tex_addr[i11];
+    }
+}
+
+// Screen tile of the tiled rasterizer, with its own depth and color storage of SW_TILE_SIZE x SW_TILE_SIZE pixels
+#define SW_TILE_SIZE 32
+
+typedef struct {
+    int min_x, min_y, max_x, max_y;     // inclusive framebuffer coordinates
+    sw_depth_t* depth_buffer;
+    uint16_t* color_buffer;
+    bool* covered;                      // pixels written since the last flush
+} sw_tile_t;
+
+// The standard, standard2 and barycentric rasterizers share the fb_width x fb_height depth buffer of the caller
+void sw_init_rasterizer_standard(int fb_width, int fb_height, uint16_t* color_buffer, sw_depth_t* depth_buffer);
+void sw_init_rasterizer_standard2(int fb_width, int fb_height, uint16_t* color_buffer, sw_depth_t* depth_buffer);
 void sw_clear_depth_buffer_standard();
 void sw_clear_depth_buffer_standard2();
 
-void sw_init_rasterizer_barycentric(int fb_width, int fb_height, draw_pixel_fn_t draw_pixel_fn);
-void sw_dispose_rasterizer_barycentric();
+void sw_init_rasterizer_barycentric(int fb_width, int fb_height, uint16_t* color_buffer, sw_depth_t* depth_buffer);
 void sw_clear_depth_buffer_barycentric();
 
-void sw_fragment_shader(int fb_width, int fb_height, int x, int y, fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, fx32* depth_buffer, bool persp_correct, draw_pixel_fn_t draw_pixel_fn);
+// Pixel counters of the barycentric rasterizer: in the bounding boxes of the triangles,
+// tested against the edges, and covered
+typedef struct {
+    uint64_t nb_bbox_pixels;
+    uint64_t nb_tested_pixels;
+    uint64_t nb_covered_pixels;
+} sw_raster_stats_t;
+
+void sw_get_stats_barycentric(sw_raster_stats_t* stats);
+void sw_reset_stats_barycentric();
+
+// Hierarchical Z of the shared depth buffer, the farthest depth of each block and of each region of blocks.
+// The standard, standard2 and barycentric rasterizers cull against it once it is initialized, the clear of
+// their depth buffer clears it. It is not used by the tiled rasterizer, whose tiles have their own depth storage.
+#define SW_HIZ_BLOCK_SIZE       8
+#define SW_HIZ_REGION_BLOCKS    4
+
+void sw_init_hiz(int fb_width, int fb_height, const sw_depth_t* depth_buffer);
+void sw_dispose_hiz();
+void sw_clear_hiz();
+
+// Culling on or off, off by default: the scenes so far have too little overdraw to pay for it. The writes are
+// not tracked while it is off, every block is recomputed once it is back on.
+void sw_set_hiz(bool enabled);
+
+// The triangle is drawn, with or without the depth test. The blocks of its bounding box are flagged once
+// rather than the pixels of each span.
+void sw_hiz_update_triangle(fx32 x0, fx32 y0, fx32 x1, fx32 y1, fx32 x2, fx32 y2, bool depth_test);
+
+// True when the depth test would reject every pixel of the triangle, or of the rectangle where the depth
+// is at most z. The caller only culls the primitives drawn with the depth test. The rectangle query only
+// reads the bounds already known, it is meant for the blocks of a triangle that passed its own query.
+bool sw_hiz_cull_triangle(fx32 x0, fx32 y0, fx32 z0, fx32 x1, fx32 y1, fx32 z1, fx32 x2, fx32 y2, fx32 z2);
+bool sw_hiz_cull_block(int min_x, int min_y, int max_x, int max_y, fx32 z);
+
+typedef struct {
+    uint64_t nb_triangles, nb_culled_triangles;
+    uint64_t nb_blocks, nb_culled_blocks;
+} sw_hiz_stats_t;
+
+void sw_get_stats_hiz(sw_hiz_stats_t* stats);
+void sw_reset_stats_hiz();
+
+// Mip chain of a texture, its levels follow the base level in memory. Level n halves level n - 1 in both
+// directions until a direction has the 32 texels of a scale of 0.
+int sw_mip_nb_levels(int tex_scale_x, int tex_scale_y);
+size_t sw_mip_chain_size(int tex_scale_x, int tex_scale_y);
+const uint16_t* sw_mip_level(const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int level, int* level_scale_x, int* level_scale_y);
+
+// Box filter the levels after the base level of the chain
+void sw_build_mip_chain(uint16_t* tex_addr, int tex_scale_x, int tex_scale_y);
+
+// Reorder each level of a row-major chain into the swizzled layout of sw_texel_index()
+void sw_swizzle_mip_chain(uint16_t* tex_addr, int tex_scale_x, int tex_scale_y);
+
+// Level selection on or off, the base level is sampled when off
+void sw_set_mipmap(bool enabled);
+
+// Texture of a triangle with the screen space derivatives of its texture coordinates in texels of the base level
+typedef struct {
+    const uint16_t* tex_addr;
+    int tex_scale_x, tex_scale_y;
+    int nb_levels;
+    int level;              // of every pixel without the perspective correction
+    bool persp_correct;
+    float width, height;
+    float du_dx, du_dy, dv_dx, dv_dy, dz_dx, dz_dy;
+} sw_mip_t;
+
+void sw_init_mip(sw_mip_t* mip, fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1,
+                 fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y,
+                 int tex_nb_levels, bool persp_correct);
+
+// Level of the pixel with the attributes z, u and v, the rasterizers select it once per span
+const uint16_t* sw_select_mip(const sw_mip_t* mip, fx32 z, fx32 u, fx32 v, int* tex_scale_x, int* tex_scale_y);
+
+void sw_init_rasterizer_tiled(int fb_width, int fb_height, uint16_t* color_buffer);
+void sw_dispose_rasterizer_tiled();
+void sw_clear_depth_buffer_tiled();
+
+// Rasterize the binned triangles and write their pixels to the color buffer
+void sw_flush_rasterizer_tiled();
+
+// Shade a fragment against the depth of its pixel, returns true and updates the depth and color when it passes the depth test
+bool sw_shade_fragment(fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool tex_swizzled, sw_depth_t* depth, bool persp_correct, uint16_t* color);
+
+// RGB565 color of r, g, b in [0, 1] modulated by an ARGB4444 texel. The 16 values of a 4-bit texel channel,
+// scaled by 31 or 63 to the 5 or 6 bits of an RGB565 channel, are in the tables of sw_get_texel_channels(5 or 6),
+// so the modulation and the packing are a product per channel without division.
+uint16_t sw_modulate_texel(fx32 r, fx32 g, fx32 b, uint16_t texel);
+const fx32* sw_get_texel_channels(int bits);
+
+// Bilinear filtering of the textures instead of the nearest texel, a render state of the triangles drawn afterwards.
+// The 4-bit channels of the 2x2 texels are blended with 1/16 texel weights into 0 to 15 * 256, rounded to
+// SW_FILTER_STEPS + 1 values and scaled to the RGB565 channels, step * 31 or 63 / SW_FILTER_STEPS. The scalar
+// kernels load the scaled steps from tables, the SIMD kernels divide them in the lanes.
+#define SW_FILTER_STEPS 240
+void sw_set_bilinear(bool enabled);
+
+// Widest SIMD kernel available
+void sw_shade_span(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written);
+void sw_shade_span_scalar(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written);
+#if defined(SW_HAS_SSE2)
+void sw_shade_span_sse2(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written);
+#endif
+#if defined(SW_HAS_AVX2)
+void sw_shade_span_avx2(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written);
+#endif
+#if defined(SW_HAS_NEON)
+void sw_shade_span_neon(const sw_span_t* span, int first, int count, sw_depth_t* depth, uint16_t* colors, bool* written);
+#endif
+const sw_span_kernel_t* sw_get_span_kernels(size_t* nb_kernels);
+
+int sw_get_render_state(const uint16_t* tex_addr, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+
+// Scalar kernel specialized for the render state
+sw_span_fn_t sw_get_span_variant_scalar(int state);
+
+// Span kernel of a triangle, chosen once before its rasterization. It is the widest kernel specialized for
+// the render state, or sw_shade_span() testing the render state on each pixel when the specialization is disabled.
+// With a perspective span length, the perspective correct triangles get the subdivided affine kernel.
+sw_span_fn_t sw_select_span_fn(const uint16_t* tex_addr, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+void sw_set_span_specialization(bool enabled);
+
+// Perspective correction of the span rasterizers exact every length pixels and linear in between,
+// 0 for the exact correction of each pixel. The length is rounded down to a power of two.
+void sw_set_persp_span_length(int length);
+int sw_get_persp_span_length();
+
+// Texture coordinate error in texels of the subdivided affine spans against the exact perspective correction
+typedef struct {
+    uint64_t nb_pixels;
+    double sum_error;
+    float max_error;
+} sw_persp_error_t;
+
+// The error is measured when enabled, at the cost of the exact correction of each pixel.
+// The counters are not shared safely between the workers of the tiled rasterizer.
+void sw_measure_persp_error(bool enabled);
+void sw_get_persp_error(sw_persp_error_t* error);
+void sw_reset_persp_error();
+
+// Number of the leading pixels first, first + 1, ... of a span of depths z + n * dz failing the depth test against
+// the entries of depth, at most count. The rasterizers skip them before stepping the other attributes.
+int sw_depth_occluded_run(fx32 z, fx32 dz, int first, int count, const sw_depth_t* depth);
+
+// The SIMD kernels test the depth of 4 or 8 pixels at once before the other attributes, a scalar scan of the
+// occluded pixels ahead of them costs more than it saves: the rasterizers only scan for the scalar kernels
+#if defined(SW_HAS_SSE2) || defined(SW_HAS_AVX2) || defined(SW_HAS_NEON)
+#define SW_SCAN_OCCLUDED_RUNS 0
+#else
+#define SW_SCAN_OCCLUDED_RUNS 1
+#endif
+
+// Shade with the kernel shade the pixels first to first + count - 1 of a span starting at column x of row y of the buffers
+void sw_fragment_shader_span(int fb_width, int fb_height, int x, int y, int first, int count, const sw_span_t* span, sw_span_fn_t shade, sw_depth_t* depth_buffer, uint16_t* color_buffer);
+
+void sw_fragment_shader(int fb_width, int fb_height, int x, int y, fx32 z, fx32 u, fx32 v, fx32 r, fx32 g, fx32 b, fx32 a, bool clamp_s, bool clamp_t, bool depth_test, const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool tex_swizzled, sw_depth_t* depth_buffer, bool persp_correct, uint16_t* color_buffer);
 
 void sw_draw_triangle_standard(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
                       fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
                       fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
-                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
 
 void sw_draw_triangle_standard2(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
                       fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
                       fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
-                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+
+// The part of the triangle inside the tile, pixel identical to sw_draw_triangle_standard2()
+void sw_draw_triangle_standard2_tile(const sw_tile_t* tile,
+                      fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
+                      fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
+                      fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+
+void sw_draw_triangle_tiled(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
+                      fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
+                      fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
 
 void sw_draw_triangle_barycentric(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
                       fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
                       fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
-                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct);
 
 #endif  // SW_RASTERIZER_H
\ No newline at end of file
@@ -9,36 +9,55 @@
 
 #include "sw_rasterizer.h"
 
-#define RECIPROCAL_NUMERATOR    256
-
 typedef struct {
     fx32 x, y, z, w;
 } sample_t;
 
 static int g_fb_width, g_fb_height;
-static draw_pixel_fn_t g_draw_pixel_fn;
+static uint16_t* g_color_buffer;
+
+static sw_depth_t* g_depth_buffer;
 
-static fx32* g_depth_buffer;
+static sw_raster_stats_t g_stats;
 
-void sw_init_rasterizer_barycentric(int fb_width, int fb_height, draw_pixel_fn_t draw_pixel_fn) {
+void sw_init_rasterizer_barycentric(int fb_width, int fb_height, uint16_t* color_buffer, sw_depth_t* depth_buffer) {
     g_fb_width = fb_width;
     g_fb_height = fb_height;
-    g_depth_buffer = (fx32*)malloc(fb_width * fb_height * sizeof(fx32));
-    g_draw_pixel_fn = draw_pixel_fn;
+    g_depth_buffer = depth_buffer;
+    g_color_buffer = color_buffer;
 }
 
-void sw_dispose_rasterizer_barycentric() { free(g_depth_buffer); }
-
-void sw_clear_depth_buffer_barycentric() { memset(g_depth_buffer, FX(0.0f), g_fb_width * g_fb_height * sizeof(fx32)); }
-
-static fx32 reciprocal(fx32 x) {
-    return x > 0 ? DIV(FX(RECIPROCAL_NUMERATOR), x) : FX(RECIPROCAL_NUMERATOR);
+void sw_clear_depth_buffer_barycentric() {
+    memset(g_depth_buffer, 0, g_fb_width * g_fb_height * sizeof(sw_depth_t));
+    sw_clear_hiz();
 }
 
+// MUL would overflow for the triangles larger than 181 pixels let through by the guard band
 static fx32 edge_function(fx32 a[2], fx32 b[2], fx32 c[2]) {
-    return MUL(c[0] - a[0], b[1] - a[1]) - MUL(c[1] - a[1], b[0] - a[0]);
+    return MUL_WIDE(c[0] - a[0], b[1] - a[1]) - MUL_WIDE(c[1] - a[1], b[0] - a[0]);
+}
+
+// Steps of edge_function(a, b, c) when c moves by one pixel. The pixel positions have no
+// fraction, so the additions give exactly the values of edge_function().
+static fx32 edge_step_x(fx32 a[2], fx32 b[2]) { return MUL_WIDE(FXIS(1, SCALE_POS), b[1] - a[1]); }
+
+static fx32 edge_step_y(fx32 a[2], fx32 b[2]) { return -MUL_WIDE(FXIS(1, SCALE_POS), b[0] - a[0]); }
+
+// Edge function from the unquantized positions, for the attribute planes. The coverage keeps
+// using the fixed point edges, but rounding them to SCALE_EDGE would skew the gradients of thin triangles.
+static double edge_function_exact(fx32 a[2], fx32 b[2], double cx, double cy) {
+    return (cx - FLTS(a[0], SCALE_POS)) * (double)FLTS(b[1] - a[1], SCALE_POS) -
+           (cy - FLTS(a[1], SCALE_POS)) * (double)FLTS(b[0] - a[0], SCALE_POS);
 }
 
+#define BLOCK_SIZE 8
+
+enum { ATTR_Z, ATTR_U, ATTR_V, ATTR_R, ATTR_G, ATTR_B, ATTR_A, NB_ATTRS };
+
+#if FIXED_POINT
+static const int g_attr_scales[NB_ATTRS] = {SCALE_Z, SCALE_UV, SCALE_UV, SCALE_COLOR, SCALE_COLOR, SCALE_COLOR, SCALE_COLOR};
+#endif
+
 static int min(int a, int b) { return (a <= b) ? a : b; }
 
 static int max(int a, int b) { return (a >= b) ? a : b; }
@@ -50,7 +69,7 @@ static int max3(int a, int b, int c) { return max(a, max(b, c)); }
 void sw_draw_triangle_barycentric(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
                       fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
                       fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
-                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
 {
     fx32 vv0[3] = {x0, y0, z0};
     fx32 vv1[3] = {x1, y1, z1};
@@ -60,14 +79,14 @@ void sw_draw_triangle_barycentric(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, f
     fx32 c1[4] = {r1, g1, b1, a1};
     fx32 c2[4] = {r2, g2, b2, a2};
 
-    fx32 t0[3] = {u0, v0, FX(0.0f)};
-    fx32 t1[3] = {u1, v1, FX(0.0f)};
-    fx32 t2[3] = {u2, v2, FX(0.0f)};
+    fx32 t0[3] = {u0, v0, FXS(0.0f, SCALE_UV)};
+    fx32 t1[3] = {u1, v1, FXS(0.0f, SCALE_UV)};
+    fx32 t2[3] = {u2, v2, FXS(0.0f, SCALE_UV)};
 
-    int min_x = min3(INT(x0), INT(x1), INT(x2));
-    int min_y = min3(INT(y0), INT(y1), INT(y2));
-    int max_x = max3(INT(x0), INT(x1), INT(x2));
-    int max_y = max3(INT(y0), INT(y1), INT(y2));
+    int min_x = min3(INTS(x0, SCALE_POS), INTS(x1, SCALE_POS), INTS(x2, SCALE_POS));
+    int min_y = min3(INTS(y0, SCALE_POS), INTS(y1, SCALE_POS), INTS(y2, SCALE_POS));
+    int max_x = max3(INTS(x0, SCALE_POS), INTS(x1, SCALE_POS), INTS(x2, SCALE_POS));
+    int max_y = max3(INTS(y0, SCALE_POS), INTS(y1, SCALE_POS), INTS(y2, SCALE_POS));
 
     min_x = max(min_x, 0);
     min_y = max(min_y, 0);
@@ -75,32 +94,148 @@ void sw_draw_triangle_barycentric(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, f
     max_y = min(max_y, g_fb_height - 1);
 
     fx32 area = edge_function(vv0, vv1, vv2);
+    if (area <= FXS(0.0f, SCALE_EDGE))
+        return;
+
+    if (depth_test && sw_hiz_cull_triangle(x0, y0, z0, x1, y1, z1, x2, y2, z2))
+        return;
+    sw_hiz_update_triangle(x0, y0, x1, y1, x2, y2, depth_test);
+
+    // Edge functions at the first pixel of the bounding box and their steps
+    fx32 origin[2] = {FXIS(min_x, SCALE_POS), FXIS(min_y, SCALE_POS)};
+    fx32 e_row[3] = {edge_function(vv1, vv2, origin), edge_function(vv2, vv0, origin), edge_function(vv0, vv1, origin)};
+    fx32 e_dx[3] = {edge_step_x(vv1, vv2), edge_step_x(vv2, vv0), edge_step_x(vv0, vv1)};
+    fx32 e_dy[3] = {edge_step_y(vv1, vv2), edge_step_y(vv2, vv0), edge_step_y(vv0, vv1)};
+
+    // Attribute planes, the weights of the vertices are the edge functions divided by the area
+    fx32 attrs[3][NB_ATTRS] = {{vv0[2], t0[0], t0[1], c0[0], c0[1], c0[2], c0[3]},
+                               {vv1[2], t1[0], t1[1], c1[0], c1[1], c1[2], c1[3]},
+                               {vv2[2], t2[0], t2[1], c2[0], c2[1], c2[2], c2[3]}};
+    fx32* v[3] = {vv0, vv1, vv2};
+    double inv_area = 1.0 / edge_function_exact(vv0, vv1, FLTS(vv2[0], SCALE_POS), FLTS(vv2[1], SCALE_POS));
+    double w_row[3], w_dx[3], w_dy[3];
+    for (int j = 0; j < 3; ++j) {
+        fx32* a = v[(j + 1) % 3];
+        fx32* b = v[(j + 2) % 3];
+        w_row[j] = edge_function_exact(a, b, min_x, min_y);
+        w_dx[j] = FLTS(b[1] - a[1], SCALE_POS);
+        w_dy[j] = -FLTS(b[0] - a[0], SCALE_POS);
+    }
+    fx32 a_row[NB_ATTRS], a_dx[NB_ATTRS], a_dy[NB_ATTRS];
+    for (int i = 0; i < NB_ATTRS; ++i) {
+        double value = 0.0, dx = 0.0, dy = 0.0;
+        for (int j = 0; j < 3; ++j) {
+            value += FLTS(attrs[j][i], g_attr_scales[i]) * w_row[j];
+            dx += FLTS(attrs[j][i], g_attr_scales[i]) * w_dx[j];
+            dy += FLTS(attrs[j][i], g_attr_scales[i]) * w_dy[j];
+        }
+        a_row[i] = FXS(value * inv_area, g_attr_scales[i]);
+        a_dx[i] = FXS(dx * inv_area, g_attr_scales[i]);
+        a_dy[i] = FXS(dy * inv_area, g_attr_scales[i]);
+    }
+
+    g_stats.nb_bbox_pixels += (uint64_t)(max_x - min_x + 1) * (max_y - min_y + 1);
+
+    sw_span_fn_t shade = sw_select_span_fn(tex_addr, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct);
+
+    sw_mip_t mip;
+    sw_init_mip(&mip, x0, y0, z0, u0, v0, x1, y1, z1, u1, v1, x2, y2, z2, u2, v2, tex_addr, tex_scale_x, tex_scale_y,
+                tex_nb_levels, persp_correct);
+
+    // Walk the bounding box by blocks. An edge function is linear, so its extremes over a block
+    // are at the corners: the blocks outside an edge are skipped, the blocks inside the three
+    // edges are drawn without testing them. The values at a block are N steps from the first
+    // pixel, which is exact in fixed point, so the output does not depend on the traversal.
+    for (int by = min_y; by <= max_y; by += BLOCK_SIZE) {
+        int bh = min(BLOCK_SIZE, max_y - by + 1);
+        for (int bx = min_x; bx <= max_x; bx += BLOCK_SIZE) {
+            int bw = min(BLOCK_SIZE, max_x - bx + 1);
+
+            fx32 e_block[3];
+            bool outside = false, inside = true;
+            for (int i = 0; i < 3; ++i) {
+                e_block[i] = e_row[i] + e_dx[i] * (bx - min_x) + e_dy[i] * (by - min_y);
+                fx32 ex = e_dx[i] * (bw - 1);
+                fx32 ey = e_dy[i] * (bh - 1);
+                fx32 zero = FXS(0.0f, SCALE_EDGE);
+                fx32 e_min = e_block[i] + (ex < zero ? ex : zero) + (ey < zero ? ey : zero);
+                fx32 e_max = e_block[i] + (ex > zero ? ex : zero) + (ey > zero ? ey : zero);
+                if (e_max < FXS(0.0f, SCALE_EDGE))
+                    outside = true;
+                if (e_min < FXS(0.0f, SCALE_EDGE))
+                    inside = false;
+            }
+            if (outside)
+                continue;
+
+            fx32 a_block[NB_ATTRS];
+            for (int i = 0; i < NB_ATTRS; ++i)
+                a_block[i] = a_row[i] + a_dx[i] * (bx - min_x) + a_dy[i] * (by - min_y);
+
+            // The depth is linear too, it is nearest at a corner of the block
+            if (depth_test) {
+                fx32 zx = a_dx[ATTR_Z] * (bw - 1);
+                fx32 zy = a_dy[ATTR_Z] * (bh - 1);
+                fx32 zero = FXS(0.0f, SCALE_Z);
+                fx32 z_max = a_block[ATTR_Z] + (zx > zero ? zx : zero) + (zy > zero ? zy : zero);
+                if (sw_hiz_cull_block(bx, by, bx + bw - 1, by + bh - 1, z_max))
+                    continue;
+            }
 
-    for (int y = min_y; y <= max_y; ++y)
-        for (int x = min_x; x <= max_x; ++x) {
-            fx32 pixel_sample[2] = {FXI(x), FXI(y)};
-            fx32 w0 = edge_function(vv1, vv2, pixel_sample);
-            fx32 w1 = edge_function(vv2, vv0, pixel_sample);
-            fx32 w2 = edge_function(vv0, vv1, pixel_sample);
-            if (w0 >= FX(0.0f) && w1 >= FX(0.0f) && w2 >= FX(0.0f)) {
-                fx32 inv_area = reciprocal(area);
-                w0 = MUL(w0, inv_area);
-                w0 = DIV(w0, FX(RECIPROCAL_NUMERATOR));
-                w1 = MUL(w1, inv_area);
-                w1 = DIV(w1, FX(RECIPROCAL_NUMERATOR));
-                w2 = MUL(w2, inv_area);
-                w2 = DIV(w2, FX(RECIPROCAL_NUMERATOR));
-                fx32 u = MUL(w0, t0[0]) + MUL(w1, t1[0]) + MUL(w2, t2[0]);
-                fx32 v = MUL(w0, t0[1]) + MUL(w1, t1[1]) + MUL(w2, t2[1]);
-                fx32 r = MUL(w0, c0[0]) + MUL(w1, c1[0]) + MUL(w2, c2[0]);
-                fx32 g = MUL(w0, c0[1]) + MUL(w1, c1[1]) + MUL(w2, c2[1]);
-                fx32 b = MUL(w0, c0[2]) + MUL(w1, c1[2]) + MUL(w2, c2[2]);
-                fx32 a = MUL(w0, c0[3]) + MUL(w1, c1[3]) + MUL(w2, c2[3]);
-
-                // Perspective correction
-                fx32 z = MUL(w0, vv0[2]) + MUL(w1, vv1[2]) + MUL(w2, vv2[2]);
-
-                sw_fragment_shader(g_fb_width, g_fb_height, x, y, z, u, v, r, g, b, a, clamp_s, clamp_t, depth_test, tex_addr, tex_scale_x, tex_scale_y, g_depth_buffer, persp_correct, g_draw_pixel_fn);
+            if (!inside)
+                g_stats.nb_tested_pixels += bw * bh;
+
+            // Mip level of the block at its middle pixel
+            int mx = bw / 2, my = bh / 2;
+            int block_scale_x, block_scale_y;
+            const uint16_t* block_addr = sw_select_mip(&mip, a_block[ATTR_Z] + a_dx[ATTR_Z] * mx + a_dy[ATTR_Z] * my,
+                                                       a_block[ATTR_U] + a_dx[ATTR_U] * mx + a_dy[ATTR_U] * my,
+                                                       a_block[ATTR_V] + a_dx[ATTR_V] * mx + a_dy[ATTR_V] * my,
+                                                       &block_scale_x, &block_scale_y);
+
+            for (int y = by; y < by + bh; ++y) {
+                // A triangle is convex, the covered pixels of a row are contiguous
+                int first = 0, last = bw - 1;
+                if (!inside) {
+                    fx32 w0 = e_block[0], w1 = e_block[1], w2 = e_block[2];
+                    first = bw;
+                    last = -1;
+                    for (int x = 0; x < bw; ++x) {
+                        if (w0 >= FXS(0.0f, SCALE_EDGE) && w1 >= FXS(0.0f, SCALE_EDGE) && w2 >= FXS(0.0f, SCALE_EDGE)) {
+                            if (first == bw)
+                                first = x;
+                            last = x;
+                        }
+                        w0 += e_dx[0];
+                        w1 += e_dx[1];
+                        w2 += e_dx[2];
+                    }
+                    for (int i = 0; i < 3; ++i)
+                        e_block[i] += e_dy[i];
+                }
+
+                if (first <= last) {
+                    g_stats.nb_covered_pixels += last - first + 1;
+
+                    // Fast forward over the pixels behind the depth buffer before the other attributes are stepped
+                    if (SW_SCAN_OCCLUDED_RUNS && depth_test)
+                        first += sw_depth_occluded_run(a_block[ATTR_Z], a_dx[ATTR_Z], first, last - first + 1, &g_depth_buffer[y * g_fb_width + bx + first]);
+                }
+
+                if (first <= last) {
+                    sw_span_t span = {a_block[ATTR_Z], a_block[ATTR_U], a_block[ATTR_V], a_block[ATTR_R], a_block[ATTR_G], a_block[ATTR_B],
+                                      a_dx[ATTR_Z], a_dx[ATTR_U], a_dx[ATTR_V], a_dx[ATTR_R], a_dx[ATTR_G], a_dx[ATTR_B],
+                                      block_addr, block_scale_x, block_scale_y, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct};
+                    sw_fragment_shader_span(g_fb_width, g_fb_height, bx, y, first, last - first + 1, &span, shade, g_depth_buffer, g_color_buffer);
+                }
+
+                for (int i = 0; i < NB_ATTRS; ++i)
+                    a_block[i] += a_dy[i];
             }
         }
+    }
 }
+
+void sw_get_stats_barycentric(sw_raster_stats_t* stats) { *stats = g_stats; }
+
+void sw_reset_stats_barycentric() { memset(&g_stats, 0, sizeof(g_stats)); }
@@ -9,9 +9,9 @@
 #include "sw_rasterizer.h"
 
 static int g_fb_width, g_fb_height;
-static draw_pixel_fn_t g_draw_pixel_fn;
+static uint16_t* g_color_buffer;
 
-static fx32* g_depth_buffer;
+static sw_depth_t* g_depth_buffer;
 
 typedef struct {
     int y0, y1, y2;
@@ -26,23 +26,24 @@ typedef struct {
     fx32 dr0_step, dg0_step, db0_step, da0_step;
     fx32 dr1_step, dg1_step, db1_step, da1_step;
     bool bottom_half;
-    const uint16_t* tex_addr;
-    int tex_scale_x, tex_scale_y;
+    sw_mip_t mip;
+    bool tex_swizzled;
     bool persp_correct;
     bool clamp_s, clamp_t;
     bool depth_test;
 } rasterize_triangle_half_params_t;
 
-void sw_init_rasterizer_standard(int fb_width, int fb_height, draw_pixel_fn_t draw_pixel_fn) {
+void sw_init_rasterizer_standard(int fb_width, int fb_height, uint16_t* color_buffer, sw_depth_t* depth_buffer) {
     g_fb_width = fb_width;
     g_fb_height = fb_height;
-    g_depth_buffer = (fx32*)malloc(fb_width * fb_height * sizeof(fx32));
-    g_draw_pixel_fn = draw_pixel_fn;
+    g_depth_buffer = depth_buffer;
+    g_color_buffer = color_buffer;
 }
 
-void sw_dispose_rasterizer_standard() { free(g_depth_buffer); }
-
-void sw_clear_depth_buffer_standard() { memset(g_depth_buffer, FX(0.0f), g_fb_width * g_fb_height * sizeof(fx32)); }
+void sw_clear_depth_buffer_standard() {
+    memset(g_depth_buffer, 0, g_fb_width * g_fb_height * sizeof(sw_depth_t));
+    sw_clear_hiz();
+}
 
 static void swapi(int* a, int* b) {
     int t = *a;
@@ -85,27 +86,31 @@ static void rasterize_triangle_half(bool bottom_half, rasterize_triangle_half_pa
         sa = p->a0;
     }
 
-    for (int y = sy; y <= ey; y++) {
-        int ax = INT(FXI(sx) + MUL(FXI(y - sy), p->dax_step));
-        int bx = INT(FXI(p->x0) + MUL(FXI(y - p->y0), p->dbx_step));
+    // scissor to the framebuffer, the triangles are only clipped to the guard band
+    int min_y = sy < 0 ? 0 : sy;
+    int max_y = ey > g_fb_height - 1 ? g_fb_height - 1 : ey;
+
+    for (int y = min_y; y <= max_y; y++) {
+        int ax = INTS(FXIS(sx, SCALE_POS) + MULS(p->dax_step, FXIS(y - sy, SCALE_POS), SCALE_POS), SCALE_POS);
+        int bx = INTS(FXIS(p->x0, SCALE_POS) + MULS(p->dbx_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS), SCALE_POS);
 
-        fx32 tex_ss = ss + MUL(FXI(y - sy), p->ds0_step);
-        fx32 tex_st = st + MUL(FXI(y - sy), p->dt0_step);
-        fx32 tex_sw = sw + MUL(FXI(y - sy), p->dw0_step);
+        fx32 tex_ss = ss + MULS(p->ds0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
+        fx32 tex_st = st + MULS(p->dt0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
+        fx32 tex_sw = sw + MULS(p->dw0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
 
-        fx32 tex_es = p->s0 + MUL(FXI(y - p->y0), p->ds1_step);
-        fx32 tex_et = p->t0 + MUL(FXI(y - p->y0), p->dt1_step);
-        fx32 tex_ew = p->w0 + MUL(FXI(y - p->y0), p->dw1_step);
+        fx32 tex_es = p->s0 + MULS(p->ds1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
+        fx32 tex_et = p->t0 + MULS(p->dt1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
+        fx32 tex_ew = p->w0 + MULS(p->dw1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
 
-        fx32 col_sr = sr + MUL(FXI(y - sy), p->dr0_step);
-        fx32 col_sg = sg + MUL(FXI(y - sy), p->dg0_step);
-        fx32 col_sb = sb + MUL(FXI(y - sy), p->db0_step);
-        fx32 col_sa = sa + MUL(FXI(y - sy), p->da0_step);
+        fx32 col_sr = sr + MULS(p->dr0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
+        fx32 col_sg = sg + MULS(p->dg0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
+        fx32 col_sb = sb + MULS(p->db0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
+        fx32 col_sa = sa + MULS(p->da0_step, FXIS(y - sy, SCALE_POS), SCALE_POS);
 
-        fx32 col_er = p->r0 + MUL(FXI(y - p->y0), p->dr1_step);
-        fx32 col_eg = p->g0 + MUL(FXI(y - p->y0), p->dg1_step);
-        fx32 col_eb = p->b0 + MUL(FXI(y - p->y0), p->db1_step);
-        fx32 col_ea = p->a0 + MUL(FXI(y - p->y0), p->da1_step);
+        fx32 col_er = p->r0 + MULS(p->dr1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
+        fx32 col_eg = p->g0 + MULS(p->dg1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
+        fx32 col_eb = p->b0 + MULS(p->db1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
+        fx32 col_ea = p->a0 + MULS(p->da1_step, FXIS(y - p->y0, SCALE_POS), SCALE_POS);
 
         if (ax > bx) {
             swapi(&ax, &bx);
@@ -128,22 +133,39 @@ static void rasterize_triangle_half(bool bottom_half, rasterize_triangle_half_pa
         fx32 b = col_sb;
         fx32 a = col_sa;
 
-        fx32 tstep = FXI(bx - ax) > 0 ? DIV(FX(1.0f), FXI(bx - ax)) : 0;
-        fx32 tt = FX(0.0f);
+        fx32 tstep = FXIS(bx - ax, SCALE_POS) > 0 ? DIVS(FXS(1.0f, SCALE_POS), FXIS(bx - ax, SCALE_POS), SCALE_POS) : 0;
+        int min_x = ax < 0 ? 0 : ax;
+        int max_x = bx > g_fb_width ? g_fb_width : bx;
+        fx32 tt = tstep * (min_x - ax);
+
+        // Mip level of the row at its middle pixel
+        const uint16_t* tex_addr = NULL;
+        int tex_scale_x = 0, tex_scale_y = 0;
+        if (min_x < max_x) {
+            fx32 tm = tstep * ((min_x + max_x) / 2 - ax);
+            tex_addr = sw_select_mip(&p->mip, MULS(tex_sw, FXS(1.0f, SCALE_POS) - tm, SCALE_POS) + MULS(tex_ew, tm, SCALE_POS),
+                                     MULS(tex_ss, FXS(1.0f, SCALE_POS) - tm, SCALE_POS) + MULS(tex_es, tm, SCALE_POS),
+                                     MULS(tex_st, FXS(1.0f, SCALE_POS) - tm, SCALE_POS) + MULS(tex_et, tm, SCALE_POS),
+                                     &tex_scale_x, &tex_scale_y);
+        }
 
-        for (int x = ax; x < bx; x++) {
-            s = MUL(FX(1.0f) - tt, tex_ss) + MUL(tt, tex_es);
-            t = MUL(FX(1.0f) - tt, tex_st) + MUL(tt, tex_et);
-            z = MUL(FX(1.0f) - tt, tex_sw) + MUL(tt, tex_ew);
+        // The pixels are inside the framebuffer, the depth is interpolated and tested first so that the
+        // occluded pixels skip the other attributes, which only depend on tt
+        for (int x = min_x; x < max_x; x++, tt += tstep) {
+            int i = y * g_fb_width + x;
+            z = MULS(tex_sw, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(tex_ew, tt, SCALE_POS);
+            if (p->depth_test && !(sw_depth(z) > g_depth_buffer[i]))
+                continue;
 
-            r = MUL(FX(1.0f) - tt, col_sr) + MUL(tt, col_er);
-            g = MUL(FX(1.0f) - tt, col_sg) + MUL(tt, col_eg);
-            b = MUL(FX(1.0f) - tt, col_sb) + MUL(tt, col_eb);
-            a = MUL(FX(1.0f) - tt, col_sa) + MUL(tt, col_ea);
+            s = MULS(tex_ss, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(tex_es, tt, SCALE_POS);
+            t = MULS(tex_st, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(tex_et, tt, SCALE_POS);
 
-            sw_fragment_shader(g_fb_width, g_fb_height, x, y, z, s, t, r, g, b, a, p->clamp_s, p->clamp_t, p->depth_test, p->tex_addr, p->tex_scale_x, p->tex_scale_y, g_depth_buffer, p->persp_correct, g_draw_pixel_fn);
+            r = MULS(col_sr, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(col_er, tt, SCALE_POS);
+            g = MULS(col_sg, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(col_eg, tt, SCALE_POS);
+            b = MULS(col_sb, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(col_eb, tt, SCALE_POS);
+            a = MULS(col_sa, FXS(1.0f, SCALE_POS) - tt, SCALE_POS) + MULS(col_ea, tt, SCALE_POS);
 
-            tt += tstep;
+            sw_shade_fragment(z, s, t, r, g, b, a, p->clamp_s, p->clamp_t, false, tex_addr, tex_scale_x, tex_scale_y, p->tex_swizzled, &g_depth_buffer[i], p->persp_correct, &g_color_buffer[i]);
         }
     }
 }
@@ -151,13 +173,21 @@ static void rasterize_triangle_half(bool bottom_half, rasterize_triangle_half_pa
 void sw_draw_triangle_standard(fx32 x0, fx32 y0, fx32 w0, fx32 s0, fx32 t0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
                       fx32 x1, fx32 y1, fx32 w1, fx32 s1, fx32 t1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
                       fx32 x2, fx32 y2, fx32 w2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
-                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct) {
-    int xx0 = INT(x0);
-    int yy0 = INT(y0);
-    int xx1 = INT(x1);
-    int yy1 = INT(y1);
-    int xx2 = INT(x2);
-    int yy2 = INT(y2);
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct) {
+    if (depth_test && sw_hiz_cull_triangle(x0, y0, w0, x1, y1, w1, x2, y2, w2))
+        return;
+    sw_hiz_update_triangle(x0, y0, x1, y1, x2, y2, depth_test);
+
+    rasterize_triangle_half_params_t p;
+    sw_init_mip(&p.mip, x0, y0, w0, s0, t0, x1, y1, w1, s1, t1, x2, y2, w2, u2, v2, tex_addr, tex_scale_x, tex_scale_y,
+                tex_nb_levels, persp_correct);
+
+    int xx0 = INTS(x0, SCALE_POS);
+    int yy0 = INTS(y0, SCALE_POS);
+    int xx1 = INTS(x1, SCALE_POS);
+    int yy1 = INTS(y1, SCALE_POS);
+    int xx2 = INTS(x2, SCALE_POS);
+    int yy2 = INTS(y2, SCALE_POS);
 
     if (yy1 < yy0) {
         swapi(&yy0, &yy1);
@@ -195,8 +225,6 @@ void sw_draw_triangle_standard(fx32 x0, fx32 y0, fx32 w0, fx32 s0, fx32 t0, fx32
         swapf(&a1, &a2);
     }
 
-    rasterize_triangle_half_params_t p;
-
     p.y0 = yy0;
     p.y1 = yy1;
     p.y2 = yy2;
@@ -217,9 +245,7 @@ void sw_draw_triangle_standard(fx32 x0, fx32 y0, fx32 w0, fx32 s0, fx32 t0, fx32
     p.b1 = b1;
     p.a1 = a1;
 
-    p.tex_addr = tex_addr;
-    p.tex_scale_x = tex_scale_x;
-    p.tex_scale_y = tex_scale_y;
+    p.tex_swizzled = tex_swizzled;
     p.persp_correct = persp_correct;
     p.clamp_s = clamp_s;
     p.clamp_t = clamp_t;
@@ -249,26 +275,26 @@ void sw_draw_triangle_standard(fx32 x0, fx32 y0, fx32 w0, fx32 s0, fx32 t0, fx32
     fx32 db1 = b2 - b0;
     fx32 da1 = a2 - a0;
 
-    if (dy0) p.dax_step = DIV(FXI(dx0), FXI(abs(dy0)));
-    if (dy1) p.dbx_step = DIV(FXI(dx1), FXI(abs(dy1)));
+    if (dy0) p.dax_step = DIVS(FXIS(dx0, SCALE_POS), FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy1) p.dbx_step = DIVS(FXIS(dx1, SCALE_POS), FXIS(abs(dy1), SCALE_POS), SCALE_POS);
 
-    if (dy0) p.ds0_step = DIV(ds0, FXI(abs(dy0)));
-    if (dy0) p.dt0_step = DIV(dt0, FXI(abs(dy0)));
-    if (dy0) p.dw0_step = DIV(dw0, FXI(abs(dy0)));
+    if (dy0) p.ds0_step = DIVS(ds0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.dt0_step = DIVS(dt0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.dw0_step = DIVS(dw0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
 
-    if (dy1) p.ds1_step = DIV(ds1, FXI(abs(dy1)));
-    if (dy1) p.dt1_step = DIV(dt1, FXI(abs(dy1)));
-    if (dy1) p.dw1_step = DIV(dw1, FXI(abs(dy1)));
+    if (dy1) p.ds1_step = DIVS(ds1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
+    if (dy1) p.dt1_step = DIVS(dt1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
+    if (dy1) p.dw1_step = DIVS(dw1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
 
-    if (dy0) p.dr0_step = DIV(dr0, FXI(abs(dy0)));
-    if (dy0) p.dg0_step = DIV(dg0, FXI(abs(dy0)));
-    if (dy0) p.db0_step = DIV(db0, FXI(abs(dy0)));
-    if (dy0) p.da0_step = DIV(da0, FXI(abs(dy0)));
+    if (dy0) p.dr0_step = DIVS(dr0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.dg0_step = DIVS(dg0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.db0_step = DIVS(db0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.da0_step = DIVS(da0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
 
-    if (dy1) p.dr1_step = DIV(dr1, FXI(abs(dy1)));
-    if (dy1) p.dg1_step = DIV(dg1, FXI(abs(dy1)));
-    if (dy1) p.db1_step = DIV(db1, FXI(abs(dy1)));
-    if (dy1) p.da1_step = DIV(da1, FXI(abs(dy1)));
+    if (dy1) p.dr1_step = DIVS(dr1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
+    if (dy1) p.dg1_step = DIVS(dg1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
+    if (dy1) p.db1_step = DIVS(db1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
+    if (dy1) p.da1_step = DIVS(da1, FXIS(abs(dy1), SCALE_POS), SCALE_POS);
 
     if (dy0) rasterize_triangle_half(false, &p);
 
@@ -285,19 +311,19 @@ void sw_draw_triangle_standard(fx32 x0, fx32 y0, fx32 w0, fx32 s0, fx32 t0, fx32
     db0 = b2 - b1;
     da0 = a2 - a1;
 
-    if (dy0) p.dax_step = DIV(FXI(dx0), FXI(abs(dy0)));
-    if (dy1) p.dbx_step = DIV(FXI(dx1), FXI(abs(dy1)));
+    if (dy0) p.dax_step = DIVS(FXIS(dx0, SCALE_POS), FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy1) p.dbx_step = DIVS(FXIS(dx1, SCALE_POS), FXIS(abs(dy1), SCALE_POS), SCALE_POS);
 
-    p.ds0_step = FX(0.0f), p.dt0_step = FX(0.0f);
-    if (dy0) p.ds0_step = DIV(ds0, FXI(abs(dy0)));
-    if (dy0) p.dt0_step = DIV(dt0, FXI(abs(dy0)));
-    if (dy0) p.dw0_step = DIV(dw0, FXI(abs(dy0)));
+    p.ds0_step = FXS(0.0f, SCALE_UV), p.dt0_step = FXS(0.0f, SCALE_UV);
+    if (dy0) p.ds0_step = DIVS(ds0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.dt0_step = DIVS(dt0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.dw0_step = DIVS(dw0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
 
-    p.dr0_step = FX(0.0f), p.dg0_step = FX(0.0f), p.db0_step = FX(0.0f), p.da0_step = FX(0.0f);
-    if (dy0) p.dr0_step = DIV(dr0, FXI(abs(dy0)));
-    if (dy0) p.dg0_step = DIV(dg0, FXI(abs(dy0)));
-    if (dy0) p.db0_step = DIV(db0, FXI(abs(dy0)));
-    if (dy0) p.da0_step = DIV(da0, FXI(abs(dy0)));
+    p.dr0_step = FXS(0.0f, SCALE_COLOR), p.dg0_step = FXS(0.0f, SCALE_COLOR), p.db0_step = FXS(0.0f, SCALE_COLOR), p.da0_step = FXS(0.0f, SCALE_COLOR);
+    if (dy0) p.dr0_step = DIVS(dr0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.dg0_step = DIVS(dg0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.db0_step = DIVS(db0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
+    if (dy0) p.da0_step = DIVS(da0, FXIS(abs(dy0), SCALE_POS), SCALE_POS);
 
     if (dy0) rasterize_triangle_half(true, &p);
 }
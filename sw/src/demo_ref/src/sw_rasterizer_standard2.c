@@ -18,20 +18,21 @@ typedef struct {
 } vertex8;
 
 static int g_fb_width, g_fb_height;
-static draw_pixel_fn_t g_draw_pixel_fn;
+static uint16_t* g_color_buffer;
 
-static fx32* g_depth_buffer;
+static sw_depth_t* g_depth_buffer;
 
-void sw_init_rasterizer_standard2(int fb_width, int fb_height, draw_pixel_fn_t draw_pixel_fn) {
+void sw_init_rasterizer_standard2(int fb_width, int fb_height, uint16_t* color_buffer, sw_depth_t* depth_buffer) {
     g_fb_width = fb_width;
     g_fb_height = fb_height;
-    g_depth_buffer = (fx32*)malloc(fb_width * fb_height * sizeof(fx32));
-    g_draw_pixel_fn = draw_pixel_fn;
+    g_depth_buffer = depth_buffer;
+    g_color_buffer = color_buffer;
 }
 
-void sw_dispose_rasterizer_standard2() { free(g_depth_buffer); }
-
-void sw_clear_depth_buffer_standard2() { memset(g_depth_buffer, FX(0.0f), g_fb_width * g_fb_height * sizeof(fx32)); }
+void sw_clear_depth_buffer_standard2() {
+    memset(g_depth_buffer, 0, g_fb_width * g_fb_height * sizeof(sw_depth_t));
+    sw_clear_hiz();
+}
 
 static void swapv8(vertex8* a, vertex8* b) {
     vertex8 t = *a;
@@ -39,11 +40,13 @@ static void swapv8(vertex8* a, vertex8* b) {
     *b = t;
 }
 
-void sw_draw_triangle_standard2(
-    fx32 x0, fx32 y0, fx32 w0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
-    fx32 x1, fx32 y1, fx32 w1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
-    fx32 x2, fx32 y2, fx32 w2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
-    const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
+// Draw the triangle to the framebuffer, or only its part inside the tile when tile is not NULL.
+// The tile walks the same rows and columns as the full triangle, so its pixels are identical.
+static void draw_triangle(const sw_tile_t* tile,
+    fx32 x0, fx32 y0, fx32 w0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0,
+    fx32 x1, fx32 y1, fx32 w1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1,
+    fx32 x2, fx32 y2, fx32 w2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2,
+    const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
 {
     vertex8 a = {x0, y0, w0, u0, v0, r0, g0, b0};
     vertex8 b = {x1, y1, w1, u1, v1, r1, g1, b1};
@@ -61,15 +64,23 @@ void sw_draw_triangle_standard2(
     int draw_min_y, draw_max_y;
 
     // Integer window clipping
-    draw_min_y = ceilf(FLT(a.y));
+    draw_min_y = ceilf(FLTS(a.y, SCALE_POS));
     if (draw_min_y < 0)
         draw_min_y = 0;
-    draw_max_y = ceilf(FLT(c.y)) - 1;
+    draw_max_y = ceilf(FLTS(c.y, SCALE_POS)) - 1;
     if (draw_max_y > g_fb_height - 1)
         draw_max_y = g_fb_height - 1;
+    if (tile && draw_max_y > tile->max_y)
+        draw_max_y = tile->max_y;
     if (draw_max_y - draw_min_y < 0)
         return;
 
+    // The tiles have their own depth storage
+    if (!tile && depth_test && sw_hiz_cull_triangle(a.x, a.y, a.w, b.x, b.y, b.w, c.x, c.y, c.w))
+        return;
+    if (!tile)
+        sw_hiz_update_triangle(a.x, a.y, b.x, b.y, c.x, c.y, depth_test);
+
     vertex8 delta1, delta2;
 
     // Determine the deltas (length)
@@ -85,7 +96,7 @@ void sw_draw_triangle_standard2(
 
     // Avoid div by 0
     // Entire Y height less than 1/256 would not have meaningful pixel color change
-    if (delta2.y <= FX(1.0 / 256.0f))
+    if (delta2.y <= FXS(1.0 / 256.0f, SCALE_POS))
         return;
 
     // Determine vertical Y steps for DDA style math
@@ -101,19 +112,19 @@ void sw_draw_triangle_standard2(
     fx32 legr2_step, legg2_step, legb2_step;
 
     // Leg 2 steps from A to C (the full triangle height)
-    legx2_step = DIV(delta2.x, delta2.y);
-    legw2_step = DIV(delta2.w, delta2.y);
-    legu2_step = DIV(delta2.u, delta2.y);
-    legv2_step = DIV(delta2.v, delta2.y);
-    legr2_step = DIV(delta2.r, delta2.y);
-    legg2_step = DIV(delta2.g, delta2.y);
-    legb2_step = DIV(delta2.b, delta2.y);
+    legx2_step = DIVS(delta2.x, delta2.y, SCALE_POS);
+    legw2_step = DIVS(delta2.w, delta2.y, SCALE_POS);
+    legu2_step = DIVS(delta2.u, delta2.y, SCALE_POS);
+    legv2_step = DIVS(delta2.v, delta2.y, SCALE_POS);
+    legr2_step = DIVS(delta2.r, delta2.y, SCALE_POS);
+    legg2_step = DIVS(delta2.g, delta2.y, SCALE_POS);
+    legb2_step = DIVS(delta2.b, delta2.y, SCALE_POS);
 
     // Leg 1, Draw top to middle
     // For most triangles, draw downward from the apex A to a knee B.
     // That knee could be on either the left or right side, but that is handled much later.
     int draw_middle_y;
-    draw_middle_y = ceilf(FLT(b.y));
+    draw_middle_y = ceilf(FLTS(b.y, SCALE_POS));
     // Do not clip B to max_y. Let the y count expire before reaching the knee if it is past bottom of screen.
     if (draw_middle_y < 0)
         draw_middle_y = 0;
@@ -130,15 +141,15 @@ void sw_draw_triangle_standard2(
 
     // If the triangle has no knee, this section gets skipped to avoid divide by 0.
     // That is okay, because the recalculate Leg 1 from B to C triggers before actually drawing.
-    if (delta1.y > FX(1.0f / 256.0f)) {
+    if (delta1.y > FXS(1.0f / 256.0f, SCALE_POS)) {
         // Find Leg 1 steps in the y direction from A to B
-        legx1_step = DIV(delta1.x, delta1.y);
-        legw1_step = DIV(delta1.w, delta1.y);
-        legu1_step = DIV(delta1.u, delta1.y);
-        legv1_step = DIV(delta1.v, delta1.y);
-        legr1_step = DIV(delta1.r, delta1.y);
-        legg1_step = DIV(delta1.g, delta1.y);
-        legb1_step = DIV(delta1.b, delta1.y);
+        legx1_step = DIVS(delta1.x, delta1.y, SCALE_POS);
+        legw1_step = DIVS(delta1.w, delta1.y, SCALE_POS);
+        legu1_step = DIVS(delta1.u, delta1.y, SCALE_POS);
+        legv1_step = DIVS(delta1.v, delta1.y, SCALE_POS);
+        legr1_step = DIVS(delta1.r, delta1.y, SCALE_POS);
+        legg1_step = DIVS(delta1.g, delta1.y, SCALE_POS);
+        legb1_step = DIVS(delta1.b, delta1.y, SCALE_POS);
     }
 
     // Y accumulators
@@ -154,23 +165,23 @@ void sw_draw_triangle_standard2(
     // Basically we are sampling pixels on integer exact rows.
     // But we only are able to know the next row by way of forward interpolation. So always round up.
     // To get to that next row, we have to prestep by the fractional forward distance from A. _Ceil(A.y) - A.y
-    prestep_y1 = FXI(draw_min_y) - a.y;
-
-    leg_x1 = a.x + MUL(prestep_y1, legx1_step);
-    leg_w1 = a.w + MUL(prestep_y1, legw1_step);
-    leg_u1 = a.u + MUL(prestep_y1, legu1_step);
-    leg_v1 = a.v + MUL(prestep_y1, legv1_step);
-    leg_r1 = a.r + MUL(prestep_y1, legr1_step);
-    leg_g1 = a.g + MUL(prestep_y1, legg1_step);
-    leg_b1 = a.b + MUL(prestep_y1, legb1_step);
-
-    leg_x2 = a.x + MUL(prestep_y1, legx2_step);
-    leg_w2 = a.w + MUL(prestep_y1, legw2_step);
-    leg_u2 = a.u + MUL(prestep_y1, legu2_step);
-    leg_v2 = a.v + MUL(prestep_y1, legv2_step);
-    leg_r2 = a.r + MUL(prestep_y1, legr2_step);
-    leg_g2 = a.g + MUL(prestep_y1, legg2_step);
-    leg_b2 = a.b + MUL(prestep_y1, legb2_step);
+    prestep_y1 = FXIS(draw_min_y, SCALE_POS) - a.y;
+
+    leg_x1 = a.x + MULS(legx1_step, prestep_y1, SCALE_POS);
+    leg_w1 = a.w + MULS(legw1_step, prestep_y1, SCALE_POS);
+    leg_u1 = a.u + MULS(legu1_step, prestep_y1, SCALE_POS);
+    leg_v1 = a.v + MULS(legv1_step, prestep_y1, SCALE_POS);
+    leg_r1 = a.r + MULS(legr1_step, prestep_y1, SCALE_POS);
+    leg_g1 = a.g + MULS(legg1_step, prestep_y1, SCALE_POS);
+    leg_b1 = a.b + MULS(legb1_step, prestep_y1, SCALE_POS);
+
+    leg_x2 = a.x + MULS(legx2_step, prestep_y1, SCALE_POS);
+    leg_w2 = a.w + MULS(legw2_step, prestep_y1, SCALE_POS);
+    leg_u2 = a.u + MULS(legu2_step, prestep_y1, SCALE_POS);
+    leg_v2 = a.v + MULS(legv2_step, prestep_y1, SCALE_POS);
+    leg_r2 = a.r + MULS(legr2_step, prestep_y1, SCALE_POS);
+    leg_g2 = a.g + MULS(legg2_step, prestep_y1, SCALE_POS);
+    leg_b2 = a.b + MULS(legb2_step, prestep_y1, SCALE_POS);
     
     // Inner loop vars
     int row;
@@ -188,6 +199,12 @@ void sw_draw_triangle_standard2(
     fx32 tex_w, tex_u, tex_v;
     fx32 tex_r, tex_g, tex_b;
 
+    sw_span_fn_t shade = sw_select_span_fn(tex_addr, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct);
+
+    sw_mip_t mip;
+    sw_init_mip(&mip, a.x, a.y, a.w, a.u, a.v, b.x, b.y, b.w, b.u, b.v, c.x, c.y, c.w, c.u, c.v, tex_addr, tex_scale_x,
+                tex_scale_y, tex_nb_levels, persp_correct);
+
     row = draw_min_y;
     while (row <= draw_max_y) {
         if (row == draw_middle_y) {
@@ -202,105 +219,132 @@ void sw_draw_triangle_standard2(
             delta1.g = c.g - b.g;
             delta1.b = c.b - b.b;
 
-            if (delta1.y == FX(0.0f))
+            if (delta1.y == FXS(0.0f, SCALE_POS))
                 return;
             
             // Full steps in the y direction from B to C
-            legx1_step = DIV(delta1.x, delta1.y);
-            legw1_step = DIV(delta1.w, delta1.y);
-            legu1_step = DIV(delta1.u, delta1.y);
-            legv1_step = DIV(delta1.v, delta1.y);
-            legr1_step = DIV(delta1.r, delta1.y);
-            legg1_step = DIV(delta1.g, delta1.y);
-            legb1_step = DIV(delta1.b, delta1.y);
+            legx1_step = DIVS(delta1.x, delta1.y, SCALE_POS);
+            legw1_step = DIVS(delta1.w, delta1.y, SCALE_POS);
+            legu1_step = DIVS(delta1.u, delta1.y, SCALE_POS);
+            legv1_step = DIVS(delta1.v, delta1.y, SCALE_POS);
+            legr1_step = DIVS(delta1.r, delta1.y, SCALE_POS);
+            legg1_step = DIVS(delta1.g, delta1.y, SCALE_POS);
+            legb1_step = DIVS(delta1.b, delta1.y, SCALE_POS);
 
             // Most cases has B lower downscreen than A.
             // B > A usually. Only one case where B = A.
-            prestep_y1 = FXI(draw_middle_y) - b.y;
+            prestep_y1 = FXIS(draw_middle_y, SCALE_POS) - b.y;
 
             // Re-Initialize DDA start values
-            leg_x1 = b.x + MUL(prestep_y1, legx1_step);
-            leg_w1 = b.w + MUL(prestep_y1, legw1_step);
-            leg_u1 = b.u + MUL(prestep_y1, legu1_step);
-            leg_v1 = b.v + MUL(prestep_y1, legv1_step);
-            leg_r1 = b.r + MUL(prestep_y1, legr1_step);
-            leg_g1 = b.g + MUL(prestep_y1, legg1_step);
-            leg_b1 = b.b + MUL(prestep_y1, legb1_step);
+            leg_x1 = b.x + MULS(legx1_step, prestep_y1, SCALE_POS);
+            leg_w1 = b.w + MULS(legw1_step, prestep_y1, SCALE_POS);
+            leg_u1 = b.u + MULS(legu1_step, prestep_y1, SCALE_POS);
+            leg_v1 = b.v + MULS(legv1_step, prestep_y1, SCALE_POS);
+            leg_r1 = b.r + MULS(legr1_step, prestep_y1, SCALE_POS);
+            leg_g1 = b.g + MULS(legg1_step, prestep_y1, SCALE_POS);
+            leg_b1 = b.b + MULS(legb1_step, prestep_y1, SCALE_POS);
         }
 
         // Horizontal Scanline
-        delta_x = FX(fabs(FLT(leg_x2 - leg_x1)));
+        delta_x = FXS(fabs(FLTS(leg_x2 - leg_x1, SCALE_POS)), SCALE_POS);
         // Avoid div/0, this gets tiring.
-        if (delta_x >= FX(1.0f / 2048.0f)) {
+        // Rows above the tile only step the DDA
+        if (delta_x >= FXS(1.0f / 2048.0f, SCALE_POS) && (!tile || row >= tile->min_y)) {
             // Calculate step, start, and end values.
             // Drawing left to right, as in incrementing from a lower to higher memory address, is usually fastest.
-            if (leg_x1 < leg_x2) {
+            // The depth is stepped first, the other attributes only for the rows with a pixel in front.
+            bool leg1_left = leg_x1 < leg_x2;
+            if (leg1_left) {
                 // leg 1 is on the left
-                tex_w_step = DIV((leg_w2 - leg_w1), delta_x);
-                tex_u_step = DIV((leg_u2 - leg_u1), delta_x);
-                tex_v_step = DIV((leg_v2 - leg_v1), delta_x);
-                tex_r_step = DIV((leg_r2 - leg_r1), delta_x);
-                tex_g_step = DIV((leg_g2 - leg_g1), delta_x);
-                tex_b_step = DIV((leg_b2 - leg_b1), delta_x);
+                tex_w_step = DIVS((leg_w2 - leg_w1), delta_x, SCALE_POS);
 
                 // Set the horizontal starting point to (1)
-                col = ceilf(FLT(leg_x1));
+                col = ceilf(FLTS(leg_x1, SCALE_POS));
                 if (col < 0)
                     col = 0;
 
                 // Prestep to find pixel starting point
-                prestep_x = FXI(col) - leg_x1;
-                tex_w = leg_w1 + MUL(prestep_x, tex_w_step);
-                tex_u = leg_u1 + MUL(prestep_x, tex_u_step);
-                tex_v = leg_v1 + MUL(prestep_x, tex_v_step);
-                tex_r = leg_r1 + MUL(prestep_x, tex_r_step);
-                tex_g = leg_g1 + MUL(prestep_x, tex_g_step);
-                tex_b = leg_b1 + MUL(prestep_x, tex_b_step);
+                prestep_x = FXIS(col, SCALE_POS) - leg_x1;
+                tex_w = leg_w1 + MULS(tex_w_step, prestep_x, SCALE_POS);
 
                 // ending point is (2)
-                draw_max_x = ceilf(FLT(leg_x2));
+                draw_max_x = ceilf(FLTS(leg_x2, SCALE_POS));
                 if (draw_max_x > g_fb_width - 1)
                     draw_max_x = g_fb_width - 1;
             } else {
                 // Things are flipped. leg 1 is on the right.
-                tex_w_step = DIV((leg_w1 - leg_w2), delta_x);
-                tex_u_step = DIV((leg_u1 - leg_u2), delta_x);
-                tex_v_step = DIV((leg_v1 - leg_v2), delta_x);
-                tex_r_step = DIV((leg_r1 - leg_r2), delta_x);
-                tex_g_step = DIV((leg_g1 - leg_g2), delta_x);
-                tex_b_step = DIV((leg_b1 - leg_b2), delta_x);
+                tex_w_step = DIVS((leg_w1 - leg_w2), delta_x, SCALE_POS);
 
                 // Set the horizontal starting point to (2)
-                col = ceilf(FLT(leg_x2));
+                col = ceilf(FLTS(leg_x2, SCALE_POS));
                 if (col < 0)
                     col = 0;
 
                 // Prestep to find pixel starting point
-                prestep_x = FXI(col) - leg_x2;
-                tex_w = leg_w2 + MUL(prestep_x, tex_w_step);
-                tex_u = leg_u2 + MUL(prestep_x, tex_u_step);
-                tex_v = leg_v2 + MUL(prestep_x, tex_v_step);
-                tex_r = leg_r2 + MUL(prestep_x, tex_r_step);
-                tex_g = leg_g2 + MUL(prestep_x, tex_g_step);
-                tex_b = leg_b2 + MUL(prestep_x, tex_b_step);
+                prestep_x = FXIS(col, SCALE_POS) - leg_x2;
+                tex_w = leg_w2 + MULS(tex_w_step, prestep_x, SCALE_POS);
 
                 // ending point is (1)
-                draw_max_x = ceilf(FLT(leg_x1));
+                draw_max_x = ceilf(FLTS(leg_x1, SCALE_POS));
                 if (draw_max_x > g_fb_width)
                     draw_max_x = g_fb_width - 1;
             }
 
-            // Draw the Horizontal Scanline
-            while (col < draw_max_x) {
-                sw_fragment_shader(g_fb_width, g_fb_height, col, row, tex_w, tex_u, tex_v, tex_r, tex_g, tex_b, FX(1.0f), clamp_s, clamp_t, depth_test, tex_addr, tex_scale_x, tex_scale_y, g_depth_buffer, persp_correct, g_draw_pixel_fn);
-                tex_w = tex_w + tex_w_step;
-                tex_u = tex_u + tex_u_step;
-                tex_v = tex_v + tex_v_step;
-                tex_r = tex_r + tex_r_step;
-                tex_g = tex_g + tex_g_step;
-                tex_b = tex_b + tex_b_step;
-                col = col + 1;
-            } // col
+            // The mip level is selected at the middle of the whole span, a tile selects the same level
+            int middle = (draw_max_x - col) / 2;
+
+            // Pixels first to first + count - 1 of the span starting at the prestepped column
+            int first = 0;
+            int offset;
+            sw_depth_t* depth_buffer;
+            if (tile) {
+                // Skip to the tile, the span starts N steps further which is exact in fixed point
+                if (col < tile->min_x) {
+                    first = tile->min_x - col;
+                    col = tile->min_x;
+                }
+                if (draw_max_x > tile->max_x + 1)
+                    draw_max_x = tile->max_x + 1;
+                offset = (row - tile->min_y) * SW_TILE_SIZE + col - tile->min_x;
+                depth_buffer = tile->depth_buffer;
+            } else {
+                offset = row * g_fb_width + col;
+                depth_buffer = g_depth_buffer;
+            }
+            int count = draw_max_x - col;
+
+            // Fast forward over the pixels behind the depth buffer, the span is N steps further
+            int skip = 0;
+            if (SW_SCAN_OCCLUDED_RUNS && depth_test && count > 0)
+                skip = sw_depth_occluded_run(tex_w, tex_w_step, first, count, &depth_buffer[offset]);
+
+            if (skip < count) {
+                fx32 leg_u = leg1_left ? leg_u1 : leg_u2, leg_v = leg1_left ? leg_v1 : leg_v2;
+                fx32 leg_r = leg1_left ? leg_r1 : leg_r2, leg_g = leg1_left ? leg_g1 : leg_g2, leg_b = leg1_left ? leg_b1 : leg_b2;
+                tex_u_step = DIVS((leg1_left ? leg_u2 - leg_u1 : leg_u1 - leg_u2), delta_x, SCALE_POS);
+                tex_v_step = DIVS((leg1_left ? leg_v2 - leg_v1 : leg_v1 - leg_v2), delta_x, SCALE_POS);
+                tex_r_step = DIVS((leg1_left ? leg_r2 - leg_r1 : leg_r1 - leg_r2), delta_x, SCALE_POS);
+                tex_g_step = DIVS((leg1_left ? leg_g2 - leg_g1 : leg_g1 - leg_g2), delta_x, SCALE_POS);
+                tex_b_step = DIVS((leg1_left ? leg_b2 - leg_b1 : leg_b1 - leg_b2), delta_x, SCALE_POS);
+                tex_u = leg_u + MULS(tex_u_step, prestep_x, SCALE_POS);
+                tex_v = leg_v + MULS(tex_v_step, prestep_x, SCALE_POS);
+                tex_r = leg_r + MULS(tex_r_step, prestep_x, SCALE_POS);
+                tex_g = leg_g + MULS(tex_g_step, prestep_x, SCALE_POS);
+                tex_b = leg_b + MULS(tex_b_step, prestep_x, SCALE_POS);
+
+                sw_span_t span = {tex_w, tex_u, tex_v, tex_r, tex_g, tex_b,
+                                  tex_w_step, tex_u_step, tex_v_step, tex_r_step, tex_g_step, tex_b_step,
+                                  tex_addr, tex_scale_x, tex_scale_y, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct};
+                span.tex_addr = sw_select_mip(&mip, tex_w + tex_w_step * middle, tex_u + tex_u_step * middle,
+                                              tex_v + tex_v_step * middle, &span.tex_scale_x, &span.tex_scale_y);
+
+                if (tile) {
+                    shade(&span, first + skip, count - skip, &tile->depth_buffer[offset + skip], &tile->color_buffer[offset + skip], &tile->covered[offset + skip]);
+                } else {
+                    // Draw the Horizontal Scanline
+                    sw_fragment_shader_span(g_fb_width, g_fb_height, col, row, skip, count - skip, &span, shade, g_depth_buffer, g_color_buffer);
+                }
+            }
 
         } // end div/0 avoidance
 
@@ -324,3 +368,23 @@ void sw_draw_triangle_standard2(
         row = row + 1;
     }
 }
+
+void sw_draw_triangle_standard2(
+    fx32 x0, fx32 y0, fx32 w0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
+    fx32 x1, fx32 y1, fx32 w1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
+    fx32 x2, fx32 y2, fx32 w2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
+    const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
+{
+    draw_triangle(NULL, x0, y0, w0, u0, v0, r0, g0, b0, x1, y1, w1, u1, v1, r1, g1, b1, x2, y2, w2, u2, v2, r2, g2, b2,
+                  tex_addr, tex_scale_x, tex_scale_y, tex_nb_levels, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct);
+}
+
+void sw_draw_triangle_standard2_tile(const sw_tile_t* tile,
+    fx32 x0, fx32 y0, fx32 w0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
+    fx32 x1, fx32 y1, fx32 w1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
+    fx32 x2, fx32 y2, fx32 w2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
+    const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
+{
+    draw_triangle(tile, x0, y0, w0, u0, v0, r0, g0, b0, x1, y1, w1, u1, v1, r1, g1, b1, x2, y2, w2, u2, v2, r2, g2, b2,
+                  tex_addr, tex_scale_x, tex_scale_y, tex_nb_levels, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct);
+}
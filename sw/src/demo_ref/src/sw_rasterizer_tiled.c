@@ -0,0 +1,182 @@
+// sw_rasterizer_tiled.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+// Tile-binned rasterizer. The triangles of the frame are binned by bounding box into
+// SW_TILE_SIZE x SW_TILE_SIZE screen tiles. On flush, the tiles are rasterized in parallel,
+// each one with the standard2 rasterizer against its own depth and color storage, then
+// the covered pixels are copied to the color buffer. A tile keeps the submission order of its triangles,
+// so the output is identical to the standard2 rasterizer.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sw_rasterizer.h"
+#include "worker_pool.h"
+
+typedef struct {
+    fx32 x0, y0, z0, u0, v0, r0, g0, b0, a0;
+    fx32 x1, y1, z1, u1, v1, r1, g1, b1, a1;
+    fx32 x2, y2, z2, u2, v2, r2, g2, b2, a2;
+    const uint16_t* tex_addr;
+    int tex_scale_x, tex_scale_y, tex_nb_levels;
+    bool tex_swizzled;
+    bool clamp_s, clamp_t, depth_test, persp_correct;
+} bin_triangle_t;
+
+typedef struct {
+    sw_tile_t tile;
+    int* triangles;     // indices into g_triangles, in submission order
+    int nb_triangles;
+    int capacity;
+} bin_t;
+
+static int g_fb_width, g_fb_height;
+static uint16_t* g_color_buffer;
+
+static int g_nb_tiles_x, g_nb_tiles_y;
+static bin_t* g_bins;
+
+static bin_triangle_t* g_triangles;
+static int g_nb_triangles;
+static int g_triangles_capacity;
+
+void sw_init_rasterizer_tiled(int fb_width, int fb_height, uint16_t* color_buffer) {
+    g_fb_width = fb_width;
+    g_fb_height = fb_height;
+    g_color_buffer = color_buffer;
+
+    g_nb_tiles_x = (fb_width + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+    g_nb_tiles_y = (fb_height + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+    g_bins = (bin_t*)calloc(g_nb_tiles_x * g_nb_tiles_y, sizeof(bin_t));
+
+    for (int ty = 0; ty < g_nb_tiles_y; ++ty) {
+        for (int tx = 0; tx < g_nb_tiles_x; ++tx) {
+            sw_tile_t* tile = &g_bins[ty * g_nb_tiles_x + tx].tile;
+            tile->min_x = tx * SW_TILE_SIZE;
+            tile->min_y = ty * SW_TILE_SIZE;
+            tile->max_x = tile->min_x + SW_TILE_SIZE - 1;
+            tile->max_y = tile->min_y + SW_TILE_SIZE - 1;
+            if (tile->max_x > fb_width - 1)
+                tile->max_x = fb_width - 1;
+            if (tile->max_y > fb_height - 1)
+                tile->max_y = fb_height - 1;
+
+            // each tile has its own storage so that a worker does not share cache lines with another
+            tile->depth_buffer = (sw_depth_t*)malloc(SW_TILE_SIZE * SW_TILE_SIZE * sizeof(sw_depth_t));
+            tile->color_buffer = (uint16_t*)malloc(SW_TILE_SIZE * SW_TILE_SIZE * sizeof(uint16_t));
+            tile->covered = (bool*)calloc(SW_TILE_SIZE * SW_TILE_SIZE, sizeof(bool));
+        }
+    }
+
+    g_triangles = NULL;
+    g_nb_triangles = 0;
+    g_triangles_capacity = 0;
+}
+
+void sw_dispose_rasterizer_tiled() {
+    for (int i = 0; i < g_nb_tiles_x * g_nb_tiles_y; ++i) {
+        free(g_bins[i].tile.depth_buffer);
+        free(g_bins[i].tile.color_buffer);
+        free(g_bins[i].tile.covered);
+        free(g_bins[i].triangles);
+    }
+    free(g_bins);
+    free(g_triangles);
+}
+
+void sw_clear_depth_buffer_tiled() {
+    for (int i = 0; i < g_nb_tiles_x * g_nb_tiles_y; ++i)
+        memset(g_bins[i].tile.depth_buffer, 0, SW_TILE_SIZE * SW_TILE_SIZE * sizeof(sw_depth_t));
+}
+
+static void bin_push(bin_t* bin, int triangle) {
+    if (bin->nb_triangles == bin->capacity) {
+        bin->capacity = bin->capacity ? 2 * bin->capacity : 64;
+        bin->triangles = (int*)realloc(bin->triangles, bin->capacity * sizeof(int));
+    }
+    bin->triangles[bin->nb_triangles++] = triangle;
+}
+
+void sw_draw_triangle_tiled(fx32 x0, fx32 y0, fx32 z0, fx32 u0, fx32 v0, fx32 r0, fx32 g0, fx32 b0, fx32 a0,
+                      fx32 x1, fx32 y1, fx32 z1, fx32 u1, fx32 v1, fx32 r1, fx32 g1, fx32 b1, fx32 a1,
+                      fx32 x2, fx32 y2, fx32 z2, fx32 u2, fx32 v2, fx32 r2, fx32 g2, fx32 b2, fx32 a2,
+                      const uint16_t* tex_addr, int tex_scale_x, int tex_scale_y, int tex_nb_levels, bool tex_swizzled, bool clamp_s, bool clamp_t, bool depth_test, bool persp_correct)
+{
+    // Conservative bounding box, the rasterizer only touches the pixels in [floor(min), ceil(max)]
+    fx32 min_x = x0 < x1 ? (x0 < x2 ? x0 : x2) : (x1 < x2 ? x1 : x2);
+    fx32 max_x = x0 > x1 ? (x0 > x2 ? x0 : x2) : (x1 > x2 ? x1 : x2);
+    fx32 min_y = y0 < y1 ? (y0 < y2 ? y0 : y2) : (y1 < y2 ? y1 : y2);
+    fx32 max_y = y0 > y1 ? (y0 > y2 ? y0 : y2) : (y1 > y2 ? y1 : y2);
+
+    int bx0 = floorf(FLTS(min_x, SCALE_POS));
+    int bx1 = ceilf(FLTS(max_x, SCALE_POS));
+    int by0 = floorf(FLTS(min_y, SCALE_POS));
+    int by1 = ceilf(FLTS(max_y, SCALE_POS));
+    if (bx0 < 0)
+        bx0 = 0;
+    if (by0 < 0)
+        by0 = 0;
+    if (bx1 > g_fb_width - 1)
+        bx1 = g_fb_width - 1;
+    if (by1 > g_fb_height - 1)
+        by1 = g_fb_height - 1;
+    if (bx1 < bx0 || by1 < by0)
+        return;
+
+    if (g_nb_triangles == g_triangles_capacity) {
+        g_triangles_capacity = g_triangles_capacity ? 2 * g_triangles_capacity : 1024;
+        g_triangles = (bin_triangle_t*)realloc(g_triangles, g_triangles_capacity * sizeof(bin_triangle_t));
+    }
+    int index = g_nb_triangles++;
+    g_triangles[index] = (bin_triangle_t){x0, y0, z0, u0, v0, r0, g0, b0, a0,
+                                      x1, y1, z1, u1, v1, r1, g1, b1, a1,
+                                      x2, y2, z2, u2, v2, r2, g2, b2, a2,
+                                      tex_addr, tex_scale_x, tex_scale_y, tex_nb_levels, tex_swizzled, clamp_s, clamp_t, depth_test, persp_correct};
+
+    for (int ty = by0 / SW_TILE_SIZE; ty <= by1 / SW_TILE_SIZE; ++ty)
+        for (int tx = bx0 / SW_TILE_SIZE; tx <= bx1 / SW_TILE_SIZE; ++tx)
+            bin_push(&g_bins[ty * g_nb_tiles_x + tx], index);
+}
+
+// One slice per tile, the worker pool interleaves the tiles between the threads
+static void rasterize_tile(void* context, int slice, int nb_slices) {
+    (void)context;
+    (void)nb_slices;
+
+    bin_t* bin = &g_bins[slice];
+    for (int i = 0; i < bin->nb_triangles; ++i) {
+        const bin_triangle_t* t = &g_triangles[bin->triangles[i]];
+        sw_draw_triangle_standard2_tile(&bin->tile,
+                                        t->x0, t->y0, t->z0, t->u0, t->v0, t->r0, t->g0, t->b0, t->a0,
+                                        t->x1, t->y1, t->z1, t->u1, t->v1, t->r1, t->g1, t->b1, t->a1,
+                                        t->x2, t->y2, t->z2, t->u2, t->v2, t->r2, t->g2, t->b2, t->a2,
+                                        t->tex_addr, t->tex_scale_x, t->tex_scale_y, t->tex_nb_levels, t->tex_swizzled, t->clamp_s, t->clamp_t, t->depth_test, t->persp_correct);
+    }
+
+    // The tiles do not overlap, each one is copied by its worker
+    sw_tile_t* tile = &bin->tile;
+    if (bin->nb_triangles > 0) {
+        for (int y = tile->min_y; y <= tile->max_y; ++y) {
+            int offset = (y - tile->min_y) * SW_TILE_SIZE - tile->min_x;
+            uint16_t* row = &g_color_buffer[y * g_fb_width];
+            for (int x = tile->min_x; x <= tile->max_x; ++x) {
+                if (tile->covered[offset + x]) {
+                    row[x] = tile->color_buffer[offset + x];
+                    tile->covered[offset + x] = false;
+                }
+            }
+        }
+    }
+    bin->nb_triangles = 0;
+}
+
+void sw_flush_rasterizer_tiled() {
+    if (g_nb_triangles == 0)
+        return;
+
+    worker_pool_run(rasterize_tile, NULL, g_nb_tiles_x * g_nb_tiles_y);
+    g_nb_triangles = 0;
+}
@@ -0,0 +1,93 @@
+// worker_pool.c
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+#include "worker_pool.h"
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_sem* start;
+    int index;
+} worker_t;
+
+static worker_t g_workers[MAX_NB_SLICES];
+static int g_nb_threads = 1;
+static SDL_sem* g_done;
+static bool g_quit;
+
+// current job
+static parallel_task_fn_t g_task;
+static void* g_context;
+static int g_nb_slices;
+
+// Thread i runs the slices i, i + nb_threads, ...
+static void run_slices(int index) {
+    for (int slice = index; slice < g_nb_slices; slice += g_nb_threads)
+        g_task(g_context, slice, g_nb_slices);
+}
+
+static int worker_main(void* data) {
+    worker_t* worker = (worker_t*)data;
+    for (;;) {
+        SDL_SemWait(worker->start);
+        if (g_quit)
+            break;
+        run_slices(worker->index);
+        SDL_SemPost(g_done);
+    }
+    return 0;
+}
+
+void worker_pool_init(int nb_threads) {
+    if (nb_threads < 1)
+        nb_threads = 1;
+    if (nb_threads > MAX_NB_SLICES)
+        nb_threads = MAX_NB_SLICES;
+
+    g_nb_threads = nb_threads;
+    g_quit = false;
+    g_done = SDL_CreateSemaphore(0);
+
+    // the calling thread is the first one
+    for (int i = 1; i < g_nb_threads; ++i) {
+        worker_t* worker = &g_workers[i];
+        worker->index = i;
+        worker->start = SDL_CreateSemaphore(0);
+        worker->thread = SDL_CreateThread(worker_main, "geometry", worker);
+    }
+}
+
+void worker_pool_dispose(void) {
+    g_quit = true;
+    for (int i = 1; i < g_nb_threads; ++i) {
+        SDL_SemPost(g_workers[i].start);
+        SDL_WaitThread(g_workers[i].thread, NULL);
+        SDL_DestroySemaphore(g_workers[i].start);
+    }
+    SDL_DestroySemaphore(g_done);
+    g_done = NULL;
+    g_nb_threads = 1;
+}
+
+int worker_pool_get_nb_threads(void) {
+    return g_nb_threads;
+}
+
+void worker_pool_run(parallel_task_fn_t task, void* context, int nb_slices) {
+    g_task = task;
+    g_context = context;
+    g_nb_slices = nb_slices;
+
+    int nb_workers = (nb_slices < g_nb_threads ? nb_slices : g_nb_threads) - 1;
+    for (int i = 1; i <= nb_workers; ++i)
+        SDL_SemPost(g_workers[i].start);
+
+    run_slices(0);
+
+    for (int i = 0; i < nb_workers; ++i)
+        SDL_SemWait(g_done);
+}
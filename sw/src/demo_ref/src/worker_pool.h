@@ -0,0 +1,19 @@
+// worker_pool.h
+// Copyright (c) 2025 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <glib.h>
+
+// Start the pool, nb_threads includes the calling thread which also runs slices
+void worker_pool_init(int nb_threads);
+void worker_pool_dispose(void);
+
+int worker_pool_get_nb_threads(void);
+
+// Run the slices on the pool, this is a parallel_run_fn_t for set_parallel_run()
+void worker_pool_run(parallel_task_fn_t task, void* context, int nb_slices);
+
+#endif